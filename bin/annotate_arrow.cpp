@@ -1,72 +1,158 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iterator>
+#include <thread>
+#include <vector>
 
-#include <onnxruntime_cxx_api.h>
+#include <argparse/argparse.hpp>
 #include <opencv4/opencv2/opencv.hpp>
 #include <opencv4/opencv2/dnn.hpp>
 #include <opencv4/opencv2/video.hpp>
 #include <opencv4/opencv2/videoio.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
 
-#include "mobilenet_arrow.hpp"
 #include "classification_model.hpp"
+#include "model_registry.hpp"
+#include "pipeline_queue.hpp"
 
-int main(int argc, char** argv) {
-  if (argc < 2) {
-    return -1;
+using namespace std::chrono;
+
+// Time a stage spent doing work, as opposed to waiting on its queues
+struct StageStats {
+  const char* name;
+  int threads;
+  std::atomic<int64_t> busy_ns = 0;
+
+  template <typename F>
+  auto time(F&& f) {
+    auto start = steady_clock::now();
+    struct Add {
+      StageStats& stats;
+      steady_clock::time_point start;
+      ~Add() { stats.busy_ns += duration_cast<nanoseconds>(steady_clock::now() - start).count(); }
+    } add{ *this, start };
+    return f();
   }
-  std::string vidf(argv[1]);
-    // Open the video stream
-    cv::VideoCapture cap(vidf);
-    
-    // Check if the video opened successfully
-    if (!cap.isOpened()) {
-        std::cerr << "Error opening video file." << std::endl;
-        return -1;
-    }
+  double utilization(nanoseconds wall) const {
+    return double(busy_ns) / (double(wall.count()) * threads);
+  }
+};
 
-    // Get the video's frames per second (fps) and frame size
-    double fps = cap.get(cv::CAP_PROP_FPS);
-    cv::Size frame_size(640, 480);  // Set the desired frame size
+struct Frame {
+  size_t seq;
+  cv::Mat image;
+};
 
-    // Create a VideoWriter object to write the output video
-  cv::VideoWriter video_writer("output_video.avi", cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, frame_size, true);
+void annotate(cv::Mat& frame, ClassificationModel::Detection d, const cv::Rect& bounding_box, float confidence) {
+  cv::rectangle(frame, bounding_box, cv::Scalar(0, 255, 0), 2);
+  std::string text = fmt::format("{} {:.2f}", to_string(d), confidence);
+  int font = cv::FONT_HERSHEY_SIMPLEX;
+  double font_scale = 0.5;
+  int thickness = 1;
+  int baseline = 0;
+  cv::Size text_size = cv::getTextSize(text, font, font_scale, thickness, &baseline);
+  cv::Point text_org(bounding_box.x + (bounding_box.width - text_size.width) / 2, bounding_box.y + bounding_box.height + text_size.height + 5);
+  cv::putText(frame, text, text_org, font, font_scale, cv::Scalar(255, 255, 255), thickness);
+}
 
-    // Check if the VideoWriter opened successfully
-    if (!video_writer.isOpened()) {
-        std::cerr << "Error opening video writer." << std::endl;
-        return -1;
-    }
+int main(int argc, char** argv) {
+  argparse::ArgumentParser args("annotate_arrow");
+  args.add_argument("video").help("Video to annotate");
+  args.add_argument("-m", "--model").default_value(std::string("yolov8"))
+    .help(fmt::format("detector to run: {}", fmt::join(model_names(), ", ")));
+  args.add_argument("-p", "--model-path").default_value(std::string("lib/model7.onnx")).help("Path to the model's ONNX file");
+  args.add_argument("-t", "--threshold").help("Detection threshold, defaults to the model's").scan<'g', float>();
+  args.add_argument("-o", "--output").default_value(std::string("output_video.avi")).help("Annotated MJPG video");
+  args.add_argument("-j", "--workers").default_value(int(std::max(1u, std::thread::hardware_concurrency() / 2)))
+    .help("Inference threads, each with its own model instance").scan<'i', int>();
+  args.add_argument("--queue").default_value(16).help("Frames buffered between stages").scan<'i', int>();
+  try {
+    args.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n';
+    std::cerr << args;
+    return 1;
+  }
+  auto entry = model_registry().find(args.get("--model"));
+  if (entry == model_registry().end()) {
+    spdlog::error("Unknown model {}, choose one of {}", args.get("--model"), fmt::join(model_names(), ", "));
+    return 1;
+  }
+  const float threshold = args.present<float>("--threshold").value_or(entry->second.threshold);
+  const int workers = std::max(1, args.get<int>("--workers"));
+  const size_t queue_depth = std::max(1, args.get<int>("--queue"));
+
+  cv::VideoCapture cap(args.get("video"));
+  if (!cap.isOpened()) {
+    spdlog::error("Error opening video file {}", args.get("video"));
+    return -1;
+  }
+  double fps = cap.get(cv::CAP_PROP_FPS);
+  cv::Size frame_size(640, 480); // What the models are trained on
+  cv::VideoWriter video_writer(args.get("--output"), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, frame_size, true);
+  if (!video_writer.isOpened()) {
+    spdlog::error("Error opening video writer {}", args.get("--output"));
+    return -1;
+  }
 
-  auto mac = ClassificationModel(MobilenetArrowClassifier::make_waseem2_model("lib/w_model2.onnx"));
-    // Process each frame
-    cv::Mat frame;
-    while (cap.read(frame)) {
-        // Resize the frame to 640x480
-        cv::resize(frame, frame, frame_size);
+  // Load models up front so their start-up does not count against the workers
+  std::vector<ClassificationModel> models = entry->second.make_replicas(args.get("--model-path"), workers);
 
-        // Apply bounding box
-        if (cv::Mat copy_frame = frame.clone(); classify(mac, copy_frame, 0.6) != ClassificationModel::Detection::NONE)
-        {
-          std::cout << "Rectangle" << '\n';
-          auto bounding_box = get_bounding_box(mac);
-          cv::rectangle(frame, bounding_box, cv::Scalar(0, 255, 0), 2);
-          std::string text = "LEFT";
-          int font = cv::FONT_HERSHEY_SIMPLEX;
-          double font_scale = 0.5;
-          int thickness = 1;
-          int baseline = 0;
-          cv::Size text_size = cv::getTextSize(text, font, font_scale, thickness, &baseline);
-          cv::Point text_org(bounding_box.x + (bounding_box.width - text_size.width) / 2, bounding_box.y + bounding_box.height + text_size.height + 5);
-          cv::putText(frame, text, text_org, font, font_scale, cv::Scalar(255, 255, 255), thickness);
-        }
+  StageStats decode_stats{ "decode", 1 }, infer_stats{ "infer", workers }, encode_stats{ "encode", 1 };
+  BoundedQueue<Frame> decoded(queue_depth);
+  OrderedQueue<cv::Mat> annotated(queue_depth);
+  std::atomic<size_t> detections = 0;
+  size_t frames = 0;
+  auto start = steady_clock::now();
 
-        // Write the frame to the output video
-        video_writer.write(frame);
+  std::jthread decoder([&] {
+    for (size_t seq = 0;; seq++) {
+      Frame frame{ seq, {} };
+      bool ok = decode_stats.time([&] {
+        if (not cap.read(frame.image)) return false;
+        cv::resize(frame.image, frame.image, frame_size);
+        return true;
+      });
+      if (not ok or not decoded.push(std::move(frame))) break;
     }
+    decoded.close();
+  });
+  std::vector<std::jthread> inference;
+  for (int w = 0; w < workers; w++) {
+    inference.emplace_back([&, w] {
+      auto& model = models[w];
+      while (auto frame = decoded.pop()) {
+        infer_stats.time([&] {
+          // Models preprocess in place
+          cv::Mat input = frame->image.clone();
+          if (auto d = classify(model, input, threshold); d != ClassificationModel::Detection::NONE) {
+            annotate(frame->image, d, get_bounding_box(model), get_confidence(model));
+            detections++;
+          }
+        });
+        annotated.push(frame->seq, std::move(frame->image));
+      }
+    });
+  }
+  std::jthread closer([&] {
+    for (auto& t : inference) t.join();
+    annotated.close();
+  });
+  while (auto image = annotated.pop()) {
+    encode_stats.time([&] { video_writer.write(*image); });
+    frames++;
+  }
+  video_writer.release();
+  auto wall = duration_cast<nanoseconds>(steady_clock::now() - start);
 
-    // Release the VideoCapture and VideoWriter
-    cap.release();
-    video_writer.release();
-
-    return 0;
+  spdlog::info("{} frames ({} with detections) in {:.1f}s: {:.1f} fps with {} {} workers",
+               frames, detections.load(), wall.count() * 1e-9, frames / (wall.count() * 1e-9),
+               workers, args.get("--model"));
+  for (auto* stage : { &decode_stats, &infer_stats, &encode_stats }) {
+    spdlog::info("  {:>6}: {:5.1f}% busy over {} thread(s)", stage->name, 100.0 * stage->utilization(wall), stage->threads);
+  }
+  return 0;
 }
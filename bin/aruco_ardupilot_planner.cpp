@@ -3,13 +3,23 @@
 
 #include "ardupilot_interface.hpp"
 #include <cstdint>
+#include <thread>
 #include <opencv4/opencv2/opencv.hpp>
 #include "common.hpp"
 #include "opencv2/core.hpp"
 #include "realsense_generator.hpp"
+#include "gz_frame_source.hpp"
 #include "classification_model.hpp"
+#include "model_registry.hpp"
 #include "mobilenet_arrow.hpp"
 #include "arrow_state_machine.hpp"
+#include "metrics_server.hpp"
+#include "mission_checkpoint.hpp"
+#include "obstacle_pipeline.hpp"
+#include "planner_config.hpp"
+#include "realtime.hpp"
+#include "tick_scheduler.hpp"
+#include "visual_servo.hpp"
 #include "yolov8_arrow.hpp"
 #include "aruco_detector.hpp"
 #include <asio/detached.hpp>
@@ -19,19 +29,6 @@
 #include <spdlog/fmt/fmt.h>
 #include <memory>
 
-#include <pcl/common/angles.h>
-#include <pcl/point_types.h>
-#include <pcl/filters/passthrough.h>
-#include <pcl/sample_consensus/sac_model_plane.h>
-#include <pcl/sample_consensus/method_types.h>
-#include <pcl/sample_consensus/model_types.h>
-#include <pcl/segmentation/sac_segmentation.h>
-#include <pcl/ModelCoefficients.h>
-#include <pcl/filters/extract_indices.h>
-#include <pcl/filters/statistical_outlier_removal.h>
-#include <pcl/filters/voxel_grid.h>
-#include <pcl/range_image/range_image.h>
-
 const char* banner = R"Banner(
       >>                     >>               >======>    >=>
      >>=>                   >>=>              >=>    >=>  >=>
@@ -44,209 +41,93 @@ const char* banner = R"Banner(
 const char* GIT_SHA1_HASH = "01234569abcdef7afa1d2683a099c7af48a523c1";
 
 using fmt::print;
-using tPclPtr = pcl::PointCloud<pcl::PointXYZ>::Ptr;
 
 static argparse::ArgumentParser args("ArrowArdupilotPlanner");
 
-void
-calculate_obstacle_distances(tPclPtr pc,
-                             std::array<uint16_t, 72>& distances,
-                             std::span<float, 2> fov)
-{
-  Eigen::Affine3f rs_pose =
-    static_cast<Eigen::Affine3f>(Eigen::Translation3f(0.0f, 0.0f, 0.0f));
-  float angular_res = (float)(1.0f * (M_PI / 180.0f));
-  pcl::RangeImage::CoordinateFrame coord_frame = pcl::RangeImage::CAMERA_FRAME;
-  float noise_lvl = 0.0f;
-  float min_range = 0.0f;
-  int border = 0;
-  pcl::RangeImage rg_img;
-  rg_img.createFromPointCloud(*pc,
-                              angular_res,
-                              fov[0],
-                              fov[1],
-                              rs_pose,
-                              coord_frame,
-                              noise_lvl,
-                              min_range,
-                              border);
+RealtimeConfig realtime_config() {
+  RealtimeConfig config;
+  config.cpus = parse_cpu_list(args.get("--rt-cpus"));
+  config.priority = args.get<int>("--rt-priority");
+  config.heap_reserve = size_t(args.get<int>("--rt-heap-mb")) << 20;
+  return config;
+}
 
-  float hfov_deg = (fov[0] * 180.0f) / M_PI;
-  int rays = distances.size();
-  for (int i = 1; i <= rays; i++) {
-    int idx = i * (hfov_deg / 72.0f);
-    uint16_t depth = UINT16_MAX;
-    for (int j = idx; j < i * (hfov_deg / 72.0f); j++) {
-      pcl::PointWithRange ray;
-      rg_img.get1dPointAverage(j, 1, 0, 58, 58, ray);
-      if (std::isinf(ray.range)) {
-        continue;
-      }
-      else {
-        depth = std::min(depth, uint16_t(ray.range*100));
-      }
-    }
-    distances[i - 1] = depth ? depth : 1;
+// Obstacles fall back to unconstrained ground fitting without an IMU
+std::shared_ptr<ImuGravity> start_imu(const std::string& serial = {}) {
+  auto imu = ImuGravity::start(serial);
+  if (not imu) {
+    spdlog::error("Ground fitting without the IMU: {}", imu.error().message());
+    return nullptr;
   }
-  spdlog::debug("Distances: {}", distances);
+  return *imu;
 }
 
-tPclPtr points_to_pcl(const rs2::points& points)
-{
-    tPclPtr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-    auto sp = points.get_profile().as<rs2::video_stream_profile>();
-    cloud->width = sp.width();
-    cloud->height = sp.height();
-    cloud->is_dense = false;
-    cloud->points.resize(points.size());
-    auto ptr = points.get_vertices();
-    for (auto& p : cloud->points)
-    {
-        p.x = ptr->x;
-        p.y = ptr->y;
-        p.z = ptr->z;
-        ptr++;
-    }
-
-    return cloud;
+// The flags are the defaults a --config file overrides
+PlannerConfig config_from_args() {
+  PlannerConfig config;
+  // Each model was validated at its own threshold
+  config.perception.detection_threshold =
+    args.present<float>("-t").value_or(model_registry().at(args.get("--model")).threshold);
+  config.perception.ground_threshold = args.get<float>("-g");
+  config.perception.cone_direct_score = args.get<float>("--cone-direct-score");
+  config.perception.bins.bins = args.get<int>("--bins");
+  config.perception.bins.reducer = parse_bin_reducer(args.get("--bin-reducer")).value_or(BinReducer::PERCENTILE);
+  config.perception.bins.band_low_deg = args.get<float>("--bin-band-low");
+  config.perception.bins.band_high_deg = args.get<float>("--bin-band-high");
+  config.motion.velocity = args.get<float>("--velocity");
+  config.motion.turning_speed = args.get<float>("--turning-spd");
+  config.motion.waypoint_threshold = args.get<float>("-w");
+  config.motion.waypoint_distance = args.get<float>("-d");
+  config.motion.servo_stop_range = args.get<float>("--servo-stop-range");
+  config.motion.servo_max_speed = args.get<float>("--servo-max-speed");
+  config.pipeline.model = args.get("--model");
+  config.pipeline.provider = args.get("--provider");
+  config.pipeline.tick_budget_ms = args.get<int>("--tick-budget");
+  config.pipeline.track_obstacles = args.get<bool>("--track-obstacles");
+  config.pipeline.intra_op_threads = args.get<int>("--intra-threads");
+  config.pipeline.inter_op_threads = args.get<int>("--inter-threads");
+  config.pipeline.parallel_execution = args.get<bool>("--parallel");
+  return config;
 }
 
-void
-selectOutsideGroundPlane(const tPclPtr input_cloud,
-                         Eigen::Vector4f& plane_coefficients,
-                         float threshold,
-                         std::vector<int>& inliers)
-{
-    int nr_p = 0;
-    inliers.resize(input_cloud->size());
-
-    float threshold_close = threshold;
-    float threshold_far = 0.1;
-    float threshold_boundary = 1.5 * 1.5; // pre-squared
-
-    // Iterate through the 3d points and calculate the distances from them to
-    // the plane
-    for (size_t i = 0; i < input_cloud->size(); ++i) {
-        // Calculate the distance from the point to the plane normal as the dot
-        // product D = (P-A).N/|N|
-        Eigen::Vector4f pt(input_cloud->points[i].x,
-                           input_cloud->points[i].y,
-                           input_cloud->points[i].z,
-                           1);
-
-        float distance = fabsf(plane_coefficients.dot(pt));
-
-        // check to see whether the point is near or far from us
-        float source_distance = std::pow(input_cloud->points[i].x, 2) +
-                                std::pow(input_cloud->points[i].y, 2);
-        bool near = source_distance < threshold_boundary;
-
-        if ((near && distance < threshold_close) ||
-            (!near &&
-             distance <
-               threshold_far)) // (near ? threshold_close : threshold_far))
-        {
-      // Returns the indices of the points whose distances are smaller than the
-      // threshold
-      inliers[nr_p] = i;
-      ++nr_p;
-        }
-    }
-    inliers.resize(nr_p);
+SessionConfig session_config(const PlannerConfig& planner) {
+  SessionConfig config;
+  config.provider = parse_execution_provider(planner.pipeline.provider).value_or(ExecutionProvider::CPU);
+  config.intra_op_threads = planner.pipeline.intra_op_threads;
+  config.inter_op_threads = planner.pipeline.inter_op_threads;
+  config.parallel_execution = planner.pipeline.parallel_execution;
+  return config;
 }
-bool
-remove_groundplane(Eigen::Vector4f& groundplane_model_,
-                   const tPclPtr input_cloud,
-                   tPclPtr output_cloud, float ground_plane_threshold)
-{
-    // pcl::copyPointCloud(*input_cloud, *output_cloud);
-    pcl::SampleConsensusModelPlane<pcl::PointXYZ> plane_model =
-      pcl::SampleConsensusModelPlane<pcl::PointXYZ>(input_cloud);
-
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    //   selectWithinDistance (const Eigen::VectorXf &model_coefficients,
-    //                const double threshold,
-    //                std::vector<int> &inliers) override;
-    // plane_model.selectWithinDistance(groundplane_model_,
-    // groundplane_threshold_, inliers->indices);
-    selectOutsideGroundPlane(input_cloud,
-                             groundplane_model_,
-                             ground_plane_threshold,
-                             inliers->indices);
-
-    // pcl::copyPointCloud<pcl::PointXYZ>(*input_cloud, inliers, *output_cloud);
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    extract.setInputCloud(input_cloud);
-    extract.setIndices(inliers);
-    extract.setNegative(true); // points not matching the ground plane
 
-    extract.filter(*output_cloud);
-
-    return true;
-}
-auto
-locate_obstacles(rs2::points& points,
-                 auto& mi,
-                 std::span<float, 2> fov,
-                 float distance_threshold) -> asio::awaitable<void>
-{
-    spdlog::debug("Inside locate_obstacles");
-    asio::steady_timer timer(co_await asio::this_coro::executor);
-
-    tPclPtr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>),
-      obstacle_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::PassThrough<pcl::PointXYZ> pass_filter;
-    pcl::VoxelGrid<pcl::PointXYZ> voxel_filter;
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    std::array<uint16_t, 72> distances;
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    // for (;;) {
-    spdlog::debug("Got points");
-    auto pcl_points = points_to_pcl(points);
-    voxel_filter.setInputCloud(pcl_points);
-    voxel_filter.setLeafSize(0.01f,0.01f,0.01f);
-    voxel_filter.filter(*cloud_filtered);
-
-    seg.setOptimizeCoefficients(true);
-    seg.setModelType(pcl::SACMODEL_PLANE);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setDistanceThreshold(distance_threshold);
-    seg.setInputCloud(cloud_filtered);
-    seg.segment(*inliers, *coefficients);
-
-    Eigen::Vector4f ground_coeff(coefficients->values[0], coefficients->values[1], coefficients->values[2], coefficients->values[3]);
-    remove_groundplane(ground_coeff, cloud_filtered, obstacle_cloud, distance_threshold);
-
-    calculate_obstacle_distances(obstacle_cloud, distances, fov);
-
-    float hfov_deg = (fov[0] * 180.0f) / M_PI;
-    co_await mi->set_obstacle_distance(
-      std::span(distances), hfov_deg / 72.0f, 17.5f, 300.0f, -0.5f * hfov_deg);
-  //   timer.expires_after(1s);
-  //   co_await timer.async_wait(use_nothrow_awaitable);
-  // }
+ServoParams servo_params(const PlannerConfig& planner) {
+  ServoParams params;
+  params.stop_range = planner.motion.servo_stop_range;
+  params.max_speed = planner.motion.servo_max_speed;
+  return params;
 }
 
 auto
 mission2(auto& mi,
          std::shared_ptr<RealsenseDevice> rs_dev,
-         std::span<float, 2> fov) -> asio::awaitable<void>
+         std::span<float, 2> fov,
+         std::span<ObstacleCamera> cameras,
+         std::shared_ptr<ImuGravity> imu,
+         ConfigReloader& config) -> asio::awaitable<void>
 {
   auto this_exec = co_await asio::this_coro::executor;
-
-  std::optional<ClassificationModel> uninit_classifier;
-  if (args.get("--model") == "mohnish4") {
-    uninit_classifier.emplace(ClassificationModel(MobilenetArrowClassifier::make_mohnish4_model(args.get("model_path"))));
-  } else if (args.get("--model") == "waseem2") {
-    uninit_classifier.emplace(ClassificationModel(MobilenetArrowClassifier::make_waseem2_model(args.get("model_path"))));
-  } else {
-    uninit_classifier.emplace(ClassificationModel(ArucoDetector::make_akash5_model(args.get("model_path"))));
+  PlannerConfig cfg = config.current();
+
+  ClassificationModel classifier = model_registry().at(cfg.pipeline.model).make(args.get("model_path"), session_config(cfg));
+  // The inference pools exist by now, so they keep their own affinity and
+  // only this thread, which runs the mission and MAVLink, gets pinned
+  std::optional<RusageSampler> rusage;
+  if (args.get<bool>("--realtime")) {
+    pin_current_thread(realtime_config()).map_error([](std::error_code e) {
+      spdlog::error("Running without realtime scheduling: {}", e.message());
+    });
+    rusage.emplace();
   }
-  ClassificationModel classifier(std::move(uninit_classifier.value()));
-  co_await mi->init();
+  co_await mi->init(cfg.mavlink.position_rate_hz);
   co_await mi->set_guided_mode();
   co_await mi->set_armed();
   asio::steady_timer timer(this_exec);
@@ -255,42 +136,121 @@ mission2(auto& mi,
   timer.expires_after(5s);
   co_await timer.async_wait(use_nothrow_awaitable);
 
-  const float turning_vel = args.get<float>("--turning-spd");
-  const float initial_forward_vel_x = args.get<float>("--velocity");
-  const float ground_detection_threshold = args.get<float>("-g");
-  ArrowStateMachine sm(classifier, args.get<float>("-t"), 5, args.get<float>("-w"), args.get<float>("-d"));
+  ArrowStateMachine sm(classifier, cfg.perception.detection_threshold, cfg.perception.vote_window,
+                       cfg.motion.waypoint_threshold, cfg.motion.waypoint_distance);
+  if (args.get<bool>("--cone-color")) {
+    ConeColorParams cone_params;
+    cone_params.direct_score = cfg.perception.cone_direct_score;
+    sm.set_cone_detector(cone_params);
+  }
   Vector3f last_target(0.0f, 0.0f, 0.0f);
+  std::optional<tLatLonAlt> last_target_lla; // Set when last_target was sent as a global target
+
+  // Visual servoing steers the approach from the detection in each frame
+  std::optional<VisualServo> servo;
+  if (args.get<bool>("--servo")) {
+    servo.emplace(servo_params(cfg));
+    sm.set_objective_tracking(true);
+  }
+
+  std::optional<MissionCheckpoint> checkpoint;
+  if (auto ckpt = MissionCheckpoint::open(args.get("--checkpoint")); ckpt.has_value()) {
+    checkpoint.emplace(std::move(*ckpt));
+  } else {
+    spdlog::error("Mission checkpointing disabled: {}", ckpt.error().message());
+  }
+  if (checkpoint and args.get<bool>("--resume")) {
+    if (auto snapshot = checkpoint->load(); snapshot.has_value()) {
+      sm.restore(*snapshot);
+      spdlog::critical("Resuming mission from {}", args.get("--checkpoint"));
+    } else {
+      spdlog::warn("Cannot resume, starting afresh: {}", snapshot.error().message());
+    }
+  }
+  std::optional<ObstacleDebugDump> obstacle_dump;
+  if (args.is_used("--dump-range")) {
+    if (auto dump = RangeImageDump::open(args.get("--dump-range")); dump.has_value()) {
+      obstacle_dump.emplace(RangeDumpSampler(args.get<int>("--dump-every")), std::move(*dump));
+      RangeDumpSampler::install_trigger();
+      spdlog::info("Dumping range images to {}, send SIGUSR1 for a burst", args.get("--dump-range"));
+    } else {
+      spdlog::error("Range image dump disabled: {}", dump.error().message());
+    }
+  }
+  // When a tick runs late, obstacles get coarser and the model is skipped
+  // before obstacle distances and setpoints are allowed to slip
+  TickScheduler scheduler(std::chrono::milliseconds(cfg.pipeline.tick_budget_ms));
+  const int obstacles_stage = scheduler.add_stage("obstacles", 40ms, { 1.0f, 0.5f, 0.25f });
+  const int inference_stage = scheduler.add_stage("inference", 40ms, { 1.0f, 0.05f });
+  const int setpoints_stage = scheduler.add_stage("setpoints", 2ms);
+  ObstacleBinner binner(cfg.perception.bins);
+  std::optional<ObstacleObjects> obstacle_objects;
+  if (cfg.pipeline.track_obstacles) obstacle_objects.emplace();
+  Counter& ticks_total = metrics().counter("michi_ticks_total", "Mission ticks run");
+  Counter& overruns_total = metrics().counter("michi_tick_overruns_total", "Mission ticks over the tick budget");
+  Histogram& obstacle_seconds = metrics().histogram("michi_obstacle_stage_seconds", "Obstacle stage time per tick");
+  Histogram& inference_seconds = metrics().histogram("michi_inference_seconds", "Inference stage time on ticks that ran the model");
+  Gauge& dump_queue = metrics().gauge("michi_range_dump_queue_depth", "Range image frames waiting to be written");
+  // One pipeline thread per camera. A single camera has the pool to itself
+  // for the ground fit, next to the mission thread
+  asio::thread_pool obstacle_pool(cameras.empty() ? std::max(2u, std::thread::hardware_concurrency()) - 1 : cameras.size());
   spdlog::info("Starting mission2");
   while (true) {
     auto rgb_frame = co_await rs_dev->async_get_rgb_frame();
     auto depth_frame = co_await rs_dev->async_get_depth_frame();
-    cv::Mat image(cv::Size(640, 480), CV_8UC3, const_cast<void*>(rgb_frame.get_data()));
+    cv::Mat image = color_view(rgb_frame.as<rs2::video_frame>()).mat();
     // cv::imwrite("/tmp/im"+std::to_string(i)+".jpg", depth_frame_mat);
-    auto points = co_await rs_dev->async_get_points();
+    // With --camera the first one is rs_dev, captured with the rest
+    std::vector<rs2::points> clouds;
+    if (not cameras.empty()) {
+      clouds = co_await capture_points(cameras);
+    } else {
+      clouds.push_back(co_await rs_dev->async_get_points());
+    }
+    // A SIGHUP lands between ticks, with every knob at once
+    if (auto reloaded = config.poll()) {
+      cfg = *reloaded;
+      sm.set_thresholds(cfg.perception.detection_threshold, cfg.motion.waypoint_threshold, cfg.motion.waypoint_distance);
+      scheduler.set_budget(std::chrono::milliseconds(cfg.pipeline.tick_budget_ms));
+      if (servo) servo->set_params(servo_params(cfg));
+      binner = ObstacleBinner(cfg.perception.bins);
+      for (auto& camera : cameras) camera.binner = ObstacleBinner(cfg.perception.bins);
+    }
+    scheduler.begin_tick();
 
     // TODO: add a constexpr if to disable obstacle avoidance
-    if (not args.get<bool>("--no-avoid"))
-    co_await locate_obstacles(points, mi, fov, ground_detection_threshold);
+    const int obstacle_level = scheduler.plan(obstacles_stage);
+    if (not args.get<bool>("--no-avoid") and not cameras.empty()) {
+      co_await locate_obstacles(cameras, clouds, mi, obstacle_pool, cfg.perception.ground_threshold,
+                                obstacle_dump ? &*obstacle_dump : nullptr,
+                                OBSTACLE_QUALITY_LEVELS[obstacle_level],
+                                obstacle_objects ? &*obstacle_objects : nullptr);
+    } else if (not args.get<bool>("--no-avoid"))
+    co_await locate_obstacles(clouds.front(), mi, fov, cfg.perception.ground_threshold, binner,
+                              obstacle_dump ? &*obstacle_dump : nullptr,
+                              OBSTACLE_QUALITY_LEVELS[obstacle_level], imu.get(),
+                              obstacle_objects ? &*obstacle_objects : nullptr, &obstacle_pool);
+    scheduler.finish(obstacles_stage);
+    obstacle_seconds.observe(scheduler.stats(obstacles_stage).last);
 
     float current_yaw_deg = mi->heading();
     // Initialize the monadic interface for the SM
-    ImpureInterface sm_monad(mi->local_position(), current_yaw_deg);
+    ImpureInterface sm_monad(mi->local_position(), current_yaw_deg, mi->global_position(), mi->ekf_origin());
     spdlog::info("YAW: {}", current_yaw_deg);
-    if (sm.next(sm_monad, image, depth_frame)) {
+    const bool run_model = scheduler.plan(inference_stage) == 0;
+    bool mission_done = sm.next(sm_monad, image, depth_view(depth_frame), run_model);
+    scheduler.finish(inference_stage);
+    if (run_model) inference_seconds.observe(scheduler.stats(inference_stage).last);
+    if (checkpoint) checkpoint->save(sm.snapshot());
+    if (mission_done) {
+      if (checkpoint) checkpoint->clear(); // Nothing left to resume
       co_await mi->set_disarmed(); // disarm
       co_return;
     }
-    if (sm_monad.output.delay_sec) {
-      spdlog::critical("Arrived at target, HOLD for {} seconds",
-                       sm_monad.output.delay_sec);
-      co_await mi->set_hold_mode();
-      timer.expires_after(std::chrono::seconds(sm_monad.output.delay_sec));
-      co_await timer.async_wait(use_nothrow_awaitable);
-      co_await mi->set_guided_mode();
-    }
+    scheduler.plan(setpoints_stage);
     spdlog::debug("Monad O/P target: {}, heading: {}",
                   sm_monad.output.target_xyz_pos_local,
-                  sm_monad.output.yaw);
+                  sm_monad.output.yaw.value_or(NAN));
     if (sm_monad.output.target_xyz_pos_local != Vector3f(0.0f, 0.0f, 0.0f) and
         sm_monad.output.target_xyz_pos_local != last_target) {
       spdlog::critical("Changing target# {}, new: {}", targets,
@@ -302,18 +262,71 @@ mission2(auto& mi,
       };
       last_target = sm_monad.output.target_xyz_pos_local;
       targets++;
-      co_await mi->set_target_position_local(target_xyz);
+      last_target_lla.reset();
+      if (sm_monad.output.target_lat_lon_alt and not args.get<bool>("--local-targets")) {
+        tLatLonAlt target_lla = *sm_monad.output.target_lat_lon_alt;
+        last_target_lla = target_lla;
+        co_await mi->set_target_position_global(target_lla);
+      } else {
+        co_await mi->set_target_position_local(target_xyz);
+      }
     }
-    if (sm_monad.output.yaw != 0) {
+    if (servo and (sm_monad.output.yaw or sm_monad.output.delay_sec)) {
+      servo->reset(); // Objective reached, the turn takes over
+    } else if (servo) {
+      std::optional<VisualServo::Sighting> seen;
+      if (const auto& s = sm_monad.output.sighting) {
+        seen = VisualServo::Sighting{ pixel_bearing(s->box.x + s->box.width / 2.0f, image.cols, fov[0]), s->range };
+      }
+      bool was_engaged = servo->engaged();
+      if (auto command = servo->update(seen, VisualServo::clock::now())) {
+        spdlog::debug("Servo: {} m/s, {} rad/s", command->forward, command->yaw_rate);
+        std::array<float, 3> velocity{ command->forward, 0.0f, 0.0f };
+        co_await mi->set_target_velocity_yaw_rate(velocity, command->yaw_rate);
+      } else if (was_engaged) {
+        spdlog::warn("Lost sight of the objective, back to the position target");
+        if (last_target_lla) {
+          co_await mi->set_target_position_global(*last_target_lla);
+        } else {
+          std::array<float, 3> target_xyz{ last_target[0], last_target[1], last_target[2] };
+          co_await mi->set_target_position_local(target_xyz);
+        }
+      }
+    }
+    scheduler.finish(setpoints_stage);
+    ticks_total.inc();
+    if (scheduler.end_tick()) {
+      overruns_total.inc();
+      spdlog::debug("Tick over budget");
+    }
+    if (obstacle_dump) dump_queue.set(obstacle_dump->dump->queued());
+    if (scheduler.ticks() % 100 == 0) {
+      spdlog::info("Tick scheduler: {}", scheduler.summary());
+      if (rusage) {
+        auto r = rusage->sample();
+        spdlog::info("Faults/s: {:.1f} minor {:.1f} major, mission thread switches/s: {:.1f} voluntary {:.1f} involuntary",
+                     r.minor_faults, r.major_faults, r.voluntary_switches, r.involuntary_switches);
+      }
+    }
+    // Holding has nothing to send, so it waits after the tick
+    if (sm_monad.output.delay_sec) {
+      spdlog::critical("Arrived at target, HOLD for {} seconds",
+                       sm_monad.output.delay_sec);
+      co_await mi->set_hold_mode();
+      timer.expires_after(std::chrono::seconds(sm_monad.output.delay_sec));
+      co_await timer.async_wait(use_nothrow_awaitable);
+      co_await mi->set_guided_mode();
+    }
+    if (sm_monad.output.yaw) {
       // set target yaw here
-      float yaw_radian = (sm_monad.output.yaw* M_PI)/180.0f;
+      float yaw_radian = (*sm_monad.output.yaw * M_PI)/180.0f;
       Eigen::Quaternionf rot(Eigen::AngleAxis<float>(yaw_radian, Eigen::Vector3f::UnitZ()));
       std::array<float, 4> quaternion_parameters { rot.w(), rot.x(), rot.y(), rot.z() };
-      co_await mi->set_target_attitude(quaternion_parameters, turning_vel);
+      co_await mi->set_target_attitude(quaternion_parameters, cfg.motion.turning_speed);
 
       // if (int(sm_monad.output.yaw) != int(current_yaw_deg)) {
       spdlog::critical(
-        "Turning to {}°: {}", sm_monad.output.yaw, quaternion_parameters);
+        "Turning to {}°: {}", *sm_monad.output.yaw, quaternion_parameters);
         // Wait for turning to complete
         timer.expires_after(4s);
         co_await timer.async_wait(use_nothrow_awaitable);
@@ -321,26 +334,74 @@ mission2(auto& mi,
     }
     if (targets == 0) {
       // Move the rover forward initially
-      std::array<float, 3> target_vel_xyz{ initial_forward_vel_x, 0.0f, 0.0f };
+      std::array<float, 3> target_vel_xyz{ cfg.motion.velocity, 0.0f, 0.0f };
       co_await mi->set_target_velocity(target_vel_xyz);
     }
-    timer.expires_after(80ms);
+    timer.expires_after(std::chrono::milliseconds(cfg.mavlink.setpoint_period_ms));
     co_await timer.async_wait(use_nothrow_awaitable);
   }
 }
 
 int main(int argc, char* argv[]) {
   args.add_argument("model_path").help("Path to arrow classification model (eg. w_model2.onnx)");
-  args.add_argument("ardupilot").help("Serial port (eg. /dev/ttyUSB0) connected to Pixhawk's TELEMETRY2");
-  args.add_argument("-m", "--model").default_value(std::string("yolov8")).action([](const std::string& value) {
-    static const std::vector<std::string> choices = { "waseem2", "mohnish4", "yolov8"};
-    if (std::find(choices.begin(), choices.end(), value) != choices.end()) {
+  args.add_argument("ardupilot").help("Serial port (eg. /dev/ttyUSB0) connected to Pixhawk's TELEMETRY2, or tcp:host:port for SITL");
+  args.add_argument("-m", "--model").default_value(std::string("akash5")).action([](const std::string& value) {
+    if (model_registry().contains(value)) {
+      return value;
+    }
+    return std::string{ "akash5" };
+  }).help(fmt::format("model to use for arrow classification: {}", fmt::join(model_names(), ", ")));
+  args.add_argument("--provider").default_value(std::string("cpu")).action([](const std::string& value) {
+    if (parse_execution_provider(value)) {
       return value;
     }
-    return std::string{ "yolov8" };
-  }).help("model to use for arrow classification");
+    spdlog::warn("Unknown execution provider {}, using cpu", value);
+    return std::string{ "cpu" };
+  }).help("ONNX Runtime execution provider: cpu, xnnpack, openvino, dnnl");
+  args.add_argument("--intra-threads").default_value(0).help("ONNX Runtime intra-op threads (0: one per core)").scan<'i', int>();
+  args.add_argument("--inter-threads").default_value(0).help("ONNX Runtime inter-op threads (0: default)").scan<'i', int>();
+  args.add_argument("--parallel").default_value(false).implicit_value(true).help("Use ONNX Runtime's parallel executor");
+  args.add_argument("--config").default_value(std::string("")).help("JSON file of tuning knobs that override these flags, re-read on SIGHUP (see planner_config.hpp)");
+  args.add_argument("--metrics").default_value(std::string("")).help("Serve Prometheus metrics on host:port, eg. 0.0.0.0:9464");
+  args.add_argument("--local-targets").default_value(false).implicit_value(true).help("Send position targets in local NED even when a GPS fix is available");
+  args.add_argument("--checkpoint").default_value(std::string("michi_mission.ckpt")).help("File mirroring the mission state for crash recovery");
+  args.add_argument("--resume").default_value(false).implicit_value(true).help("Resume objectives and target from the checkpoint file");
+  args.add_argument("--camera").append().help("Realsense camera as SERIAL[:yaw_deg[:x[:y]]] in the body frame, repeat for more; the first also feeds detection and obstacles from all of them are merged around the rover");
+  args.add_argument("--imu").default_value(false).implicit_value(true).help("Level ground fitting with the up vector from the cameras' IMU (D435i, D455)");
+  args.add_argument("--gazebo").default_value(false).implicit_value(true).help("Take camera frames from Gazebo instead of a realsense device");
+  args.add_argument("--gz-color-topic").default_value(GzCameraParams{}.color_topic).help("Gazebo colour image topic");
+  args.add_argument("--gz-depth-topic").default_value(GzCameraParams{}.depth_topic).help("Gazebo depth image topic");
+  args.add_argument("--gz-hfov").default_value(GzCameraParams{}.hfov).help("Horizontal FOV of the Gazebo camera in radians").scan<'g', float>();
+  args.add_argument("--dump-range").help("Write range images, obstacle bins and ground plane to this file (see range_image_visualize.jl)");
+  args.add_argument("--dump-every").default_value(0).help("Dump every nth obstacle frame, 0 to dump only on SIGUSR1").scan<'i', int>();
+  args.add_argument("--cone-color").default_value(false).implicit_value(true).help("Pre-detect cones by colour and track them by colour during the final approach");
+  args.add_argument("--cone-direct-score").default_value(ConeColorParams{}.direct_score).help("Colour blobs scoring this or more are taken as cones without the model (above 1 disables)").scan<'g', float>();
+  args.add_argument("--servo").default_value(false).implicit_value(true).help("Steer the approach with velocity and yaw rate from the detection in every frame");
+  args.add_argument("--servo-stop-range").default_value(ServoParams{}.stop_range).help("Range in metres visual servoing closes to").scan<'g', float>();
+  args.add_argument("--servo-max-speed").default_value(ServoParams{}.max_speed).help("Speed limit in m/s while visual servoing").scan<'g', float>();
+  args.add_argument("--tick-budget").default_value(100).help("Milliseconds for obstacles, inference and setpoints per frame; late frames get coarser obstacles and skip the model").scan<'i', int>();
+  args.add_argument("--realtime").default_value(false).implicit_value(true).help("Lock memory, reserve heap and stack, and run the mission thread SCHED_FIFO");
+  args.add_argument("--rt-cpus").default_value(std::string("")).help("Cpus to pin the mission thread to with --realtime, eg. 2,3 or 2-3");
+  args.add_argument("--rt-priority").default_value(50).help("SCHED_FIFO priority of the mission thread with --realtime, 0 to keep the default scheduler").scan<'i', int>();
+  args.add_argument("--rt-heap-mb").default_value(64).help("Heap faulted in and kept at startup with --realtime").scan<'i', int>();
+  args.add_argument("--bins").default_value(72).action([](const std::string& value) {
+    int bins = std::stoi(value);
+    if (bins >= 1 and bins <= 72) return bins;
+    spdlog::warn("OBSTACLE_DISTANCE holds 1 to 72 bins, using 72");
+    return 72;
+  }).help("Obstacle bins across each camera");
+  args.add_argument("--bin-reducer").default_value(std::string("percentile")).action([](const std::string& value) {
+    if (parse_bin_reducer(value)) {
+      return value;
+    }
+    spdlog::warn("Unknown bin reducer {}, using percentile", value);
+    return std::string{ "percentile" };
+  }).help("How the returns in an obstacle bin become its distance: min, kth, percentile, clusters");
+  args.add_argument("--bin-band-low").default_value(-90.0f).help("Lowest elevation in degrees off the camera axis that obstacle bins look at").scan<'g', float>();
+  args.add_argument("--bin-band-high").default_value(90.0f).help("Highest elevation in degrees off the camera axis that obstacle bins look at").scan<'g', float>();
+  args.add_argument("--track-obstacles").default_value(false).implicit_value(true).help("Cluster obstacle points into objects and track their velocity");
   args.add_argument("--no-avoid").default_value(false).implicit_value(true).help("Disable obstacle avoidance behaviour");
-  args.add_argument("-t", "--threshold").default_value(0.5f).help("Threshold for arrow detections (confidence > threshold => arrow detected)").scan<'g', float>();
+  args.add_argument("-t", "--threshold").help("Threshold for arrow detections (confidence > threshold => arrow detected), defaults to the model's").scan<'g', float>();
   args.add_argument("-w", "--wp-threshold").default_value(2.0f).help("Distance threshold marking a waypoint as reached").scan<'g', float>();
   args.add_argument("-d", "--waypoint-dist").default_value(5.0f).help("Distance between consecutive waypoints").scan<'g', float>();
   args.add_argument("--turning-spd").default_value(0.1f).help("Throttle when turning").scan<'g', float>();
@@ -379,55 +440,140 @@ int main(int argc, char* argv[]) {
     spdlog::set_level(spdlog::level::trace);
   }
 
-  asio::io_context io_ctx;
-  spdlog::trace("asio io_context setup");
+  // Before any camera or inference threads, so their stacks get locked too
+  if (args.get<bool>("--realtime")) {
+    auto config = realtime_config();
+    if (args.is_used("--rt-cpus") and config.cpus.empty()) spdlog::warn("Ignoring malformed --rt-cpus {}", args.get("--rt-cpus"));
+    if (auto locked = lock_memory(config); not locked.has_value()) {
+      spdlog::error("Running without locked memory: {}", locked.error().message());
+    }
+    // Reports the fault and switch rates either way, unlocked is worth knowing
+    realtime_self_check(config);
+  }
 
-  tcp::socket ap_socket(io_ctx);
-  // ap_socket.connect(*tcp::resolver(io_ctx).resolve("0.0.0.0", "5762", tcp::resolver::passive));
-  // auto mi = std::make_shared<MavlinkInterface<tcp::socket>>((std::move(ap_socket)));
-  asio::serial_port ap_serial(io_ctx, args.get("ardupilot"));
-  ap_serial.set_option(asio::serial_port_base::baud_rate(921600));
-  auto mi = std::make_shared<MavlinkInterface<asio::serial_port>>(std::move(ap_serial));
+  auto config = ConfigReloader::open(args.get("--config"), config_from_args());
+  if (not config) {
+    spdlog::critical("Couldn't load config {}: {}", args.get("--config"), config.error().message());
+    return 1;
+  }
+  if (const auto& pipeline = config->current().pipeline;
+      not model_registry().contains(pipeline.model) or not parse_execution_provider(pipeline.provider)) {
+    spdlog::critical("Unknown model {} or execution provider {}", pipeline.model, pipeline.provider);
+    return 1;
+  }
 
+  // Scrapes are served from a thread of their own
+  register_process_metrics();
+  std::unique_ptr<MetricsServer> metrics_server;
+  if (const auto address = args.get("--metrics"); not address.empty()) {
+    if (auto server = MetricsServer::start(address); server.has_value()) {
+      metrics_server = std::move(*server);
+      spdlog::info("Serving metrics on {}", address);
+    } else {
+      spdlog::error("Metrics disabled: {}", server.error().message());
+    }
+  }
 
-  auto [rs_pipe, fovh, fovv] = *setup_device().or_else([] (std::error_code e) {
-    spdlog::error("Couldn't setup realsense device: {}", e.message());
-  });
-  std::array<float, 2> fov = {fovh, fovv};
-  auto rs_dev = std::make_shared<RealsenseDevice>(rs_pipe, io_ctx);
+  asio::io_context io_ctx;
+  spdlog::trace("asio io_context setup");
 
-  asio::co_spawn(
-    io_ctx,
-    mission2(mi, rs_dev, std::span(fov)),
-    [](std::exception_ptr p) {
-      if (p) {
-        try {
-          std::rethrow_exception(p);
-        } catch (const std::exception& e) {
-          spdlog::error("Mission coroutine threw exception: {}",
-                        e.what());
-        }
+  std::shared_ptr<RealsenseDevice> rs_dev;
+  std::array<float, 2> fov;
+  std::vector<ObstacleCamera> obstacle_cameras; // Empty without --camera
+  std::shared_ptr<ImuGravity> imu; // Of the single camera, with --camera each has its own
+  if (args.get<bool>("--gazebo")) {
+    GzCameraParams params;
+    params.color_topic = args.get("--gz-color-topic");
+    params.depth_topic = args.get("--gz-depth-topic");
+    params.hfov = args.get<float>("--gz-hfov");
+    auto [gz_source, fovh, fovv] = *setup_gz_device(params).or_else([] (std::error_code e) {
+      spdlog::error("Couldn't setup gazebo camera: {}", e.message());
+    });
+    fov = {fovh, fovv};
+    rs_dev = std::make_shared<RealsenseDevice>(
+      [source = gz_source](rs2::frameset* f) { return source->poll_for_frames(f); }, io_ctx);
+  } else if (args.is_used("--camera")) {
+    for (const auto& spec : args.get<std::vector<std::string>>("--camera")) {
+      auto camera = parse_camera_spec(spec);
+      if (not camera) {
+        spdlog::error("Malformed --camera {}, expected SERIAL[:yaw_deg[:x[:y]]]", spec);
+        return 1;
       }
-  });
-  asio::co_spawn(
-    io_ctx,
-    mi->loop(),
-    [](std::exception_ptr p, tResult<void> r) {
-      if (p) {
-        try {
-          std::rethrow_exception(p);
-        } catch (const std::exception& e) {
-          spdlog::error("Mavlink loop coroutine threw exception: {}",
-                        e.what());
-        }
+      auto device = setup_device(camera->serial);
+      if (not device) {
+        spdlog::error("Couldn't setup realsense device {}: {}", camera->serial, device.error().message());
+        return 1;
       }
-      r.map_error([](std::error_code e) {
-        spdlog::error("Mavlink loop coroutine faced error: {}: {}",
-                      e.category().name(),
-                      e.message());
-      });
-  });
+      auto [rs_pipe, fovh, fovv] = *device;
+      obstacle_cameras.push_back({ std::make_shared<RealsenseDevice>(rs_pipe, io_ctx), { fovh, fovv }, camera->extrinsics });
+      if (args.get<bool>("--imu")) obstacle_cameras.back().imu = start_imu(camera->serial);
+      obstacle_cameras.back().binner = ObstacleBinner(config->current().perception.bins);
+      spdlog::info("Camera {} at {}° ({}, {})m", camera->serial, camera->extrinsics.yaw_deg, camera->extrinsics.x, camera->extrinsics.y);
+    }
+    rs_dev = obstacle_cameras.front().device;
+    fov = obstacle_cameras.front().fov;
+  } else {
+    auto [rs_pipe, fovh, fovv] = *setup_device().or_else([] (std::error_code e) {
+      spdlog::error("Couldn't setup realsense device: {}", e.message());
+    });
+    fov = {fovh, fovv};
+    rs_dev = std::make_shared<RealsenseDevice>(rs_pipe, io_ctx);
+    if (args.get<bool>("--imu")) imu = start_imu();
+  }
 
+  // mission2 holds on to mi by reference, so both live until io_ctx stops
+  std::shared_ptr<MavlinkInterface<tcp::socket>> sitl_mi;
+  std::shared_ptr<MavlinkInterface<asio::serial_port>> serial_mi;
+  auto spawn_mission = [&](auto& mi) {
+    asio::co_spawn(
+      io_ctx,
+      mission2(mi, rs_dev, std::span(fov), std::span(obstacle_cameras), imu, *config),
+      [](std::exception_ptr p) {
+        if (p) {
+          try {
+            std::rethrow_exception(p);
+          } catch (const std::exception& e) {
+            spdlog::error("Mission coroutine threw exception: {}",
+                          e.what());
+          }
+        }
+    });
+    asio::co_spawn(
+      io_ctx,
+      mi->loop(),
+      [](std::exception_ptr p, tResult<void> r) {
+        if (p) {
+          try {
+            std::rethrow_exception(p);
+          } catch (const std::exception& e) {
+            spdlog::error("Mavlink loop coroutine threw exception: {}",
+                          e.what());
+          }
+        }
+        r.map_error([](std::error_code e) {
+          spdlog::error("Mavlink loop coroutine faced error: {}: {}",
+                        e.category().name(),
+                        e.message());
+        });
+    });
+  };
+
+  // SITL serves MAVLink over TCP, eg. tcp:127.0.0.1:5762 for SERIAL2
+  const std::string ardupilot = args.get("ardupilot");
+  if (ardupilot.starts_with("tcp:")) {
+    auto host_port = ardupilot.substr(4);
+    auto sep = host_port.rfind(':');
+    tcp::socket ap_socket(io_ctx);
+    asio::connect(ap_socket, tcp::resolver(io_ctx).resolve(host_port.substr(0, sep), host_port.substr(sep + 1)));
+    spdlog::info("Connected to SITL at {}", host_port);
+    sitl_mi = std::make_shared<MavlinkInterface<tcp::socket>>(std::move(ap_socket));
+    spawn_mission(sitl_mi);
+  } else {
+    asio::serial_port ap_serial(io_ctx, ardupilot);
+    ap_serial.set_option(asio::serial_port_base::baud_rate(921600));
+    serial_mi = std::make_shared<MavlinkInterface<asio::serial_port>>(std::move(ap_serial));
+    spawn_mission(serial_mi);
+  }
 
   spdlog::trace("running asio io_context");
   io_ctx.run();
@@ -0,0 +1,90 @@
+#include <argparse/argparse.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <asio/detached.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+#include "ardupilot_interface.hpp"
+#include "fake_autopilot.hpp"
+
+using fmt::print;
+using namespace std::chrono;
+
+static argparse::ArgumentParser args("michi_frame_alloc_bench");
+
+// Every heap allocation in the process, coroutine frames included
+static std::atomic<size_t> g_allocations = 0;
+static std::atomic<size_t> g_allocated_bytes = 0;
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new(size_t size, std::align_val_t align) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  const size_t a = static_cast<size_t>(align);
+  if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// The MAVLink side of one mission2 tick: read the vehicle state, send
+// obstacle distances and a setpoint, then wait for the next frame
+auto control_ticks(auto& mi, int warmup, int ticks, asio::io_context& io_ctx) -> asio::awaitable<void> {
+  asio::steady_timer timer(co_await asio::this_coro::executor);
+  std::array<uint16_t, 72> distances;
+  distances.fill(300);
+  size_t allocations = 0, bytes = 0;
+  for (int i = 0; i < warmup + ticks; i++) {
+    if (i == warmup) {
+      allocations = g_allocations;
+      bytes = g_allocated_bytes;
+    }
+    spdlog::debug("At {} heading {}", mi.local_position(), mi.heading());
+    co_await mi.set_obstacle_distance(std::span(distances), 1.2f, 17.5f, 300.0f, -43.0f);
+    std::array<float, 3> velocity{ 0.1f, 0.0f, 0.0f };
+    co_await mi.set_target_velocity(velocity);
+    if (i % 10 == 0) co_await mi.set_target_velocity_yaw_rate(velocity, 0.1f);
+    timer.expires_after(33ms);
+    co_await timer.async_wait(use_nothrow_awaitable);
+  }
+  allocations = g_allocations - allocations;
+  bytes = g_allocated_bytes - bytes;
+  print("asio frame cache {}: {:.2f} allocations, {:.0f} bytes per tick over {} ticks\n",
+        ASIO_RECYCLING_ALLOCATOR_CACHE_SIZE, double(allocations) / ticks, double(bytes) / ticks, ticks);
+  io_ctx.stop();
+}
+
+int main(int argc, char* argv[]) {
+  args.add_description("Counts heap allocations per control tick in the MAVLink path, against a fake autopilot on loopback");
+  args.add_argument("--ticks").default_value(300).help("Ticks to measure").scan<'i', int>();
+  args.add_argument("--warmup").default_value(30).help("Ticks before measuring, while caches fill").scan<'i', int>();
+  args.add_argument("--telemetry-hz").default_value(50).help("Rate the fake autopilot streams telemetry at").scan<'i', int>();
+  try {
+    args.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n' << args;
+    return 1;
+  }
+  spdlog::set_level(spdlog::level::warn);
+
+  asio::io_context io_ctx(1);
+  auto mi = loopback_autopilot(io_ctx, args.get<int>("--telemetry-hz"));
+  asio::co_spawn(io_ctx, mi.loop(), asio::detached);
+  asio::co_spawn(io_ctx, control_ticks(mi, args.get<int>("--warmup"), args.get<int>("--ticks"), io_ctx), asio::detached);
+  io_ctx.run();
+}
@@ -0,0 +1,103 @@
+#include <argparse/argparse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+
+#include "mission_simulator.hpp"
+
+using fmt::print;
+
+static argparse::ArgumentParser args("MissionSim");
+
+float percentile(std::vector<float> v, float p) {
+  if (v.empty()) return NAN;
+  size_t k = std::min(v.size() - 1, size_t(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+int main(int argc, char* argv[]) {
+  args.add_argument("-n", "--courses").default_value(1000).help("Number of randomized courses to run").scan<'i', int>();
+  args.add_argument("-j", "--threads").default_value(int(std::thread::hardware_concurrency())).help("Worker threads").scan<'i', int>();
+  args.add_argument("--seed").default_value(1).help("Seed of the first course, course i uses seed + i").scan<'i', int>();
+  args.add_argument("--arrows").default_value(4).help("Arrows per course before the cone").scan<'i', int>();
+  args.add_argument("--obstacles").default_value(3).help("Obstacles per course").scan<'i', int>();
+  args.add_argument("--timeout").default_value(900.0f).help("Simulated seconds before a course is abandoned").scan<'g', float>();
+  args.add_argument("-t", "--threshold").default_value(0.5f).help("Threshold for arrow detections").scan<'g', float>();
+  args.add_argument("--votes").default_value(5).help("Detection vote window of the state machine").scan<'i', int>();
+  args.add_argument("-w", "--wp-threshold").default_value(2.0f).help("Distance threshold marking a waypoint as reached").scan<'g', float>();
+  args.add_argument("-d", "--waypoint-dist").default_value(5.0f).help("Distance between consecutive waypoints").scan<'g', float>();
+  args.add_argument("--detection-prob").default_value(0.9f).help("Probability of detecting an object in view").scan<'g', float>();
+  args.add_argument("--depth-dropout").default_value(0.1f).help("Fraction of invalid pixels in depth ROIs").scan<'g', float>();
+  args.add_argument("--speed").default_value(1.0f).help("Autopilot cruise speed (m/s)").scan<'g', float>();
+  args.add_argument("--tick").default_value(0.13f).help("Simulated duration of one mission2 iteration (s)").scan<'g', float>();
+  args.add_argument("--servo").default_value(false).implicit_value(true).help("Approach objectives with visual servoing, as the planners' --servo");
+  args.add_argument("-V", "--verbose").default_value(false).implicit_value(true).help("Log state machine decisions (use with -j 1)");
+
+  try {
+    args.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n';
+    std::cerr << args;
+    return 1;
+  }
+  spdlog::set_level(args.get<bool>("--verbose") ? spdlog::level::info : spdlog::level::off);
+
+  SimParams p;
+  p.arrows = args.get<int>("--arrows");
+  p.obstacles = args.get<int>("--obstacles");
+  p.timeout_s = args.get<float>("--timeout");
+  p.detector_threshold = args.get<float>("-t");
+  p.vote_window = args.get<int>("--votes");
+  p.wp_threshold = args.get<float>("-w");
+  p.wp_distance = args.get<float>("-d");
+  p.detection_prob = args.get<float>("--detection-prob");
+  p.depth_dropout = args.get<float>("--depth-dropout");
+  p.cruise_speed_ms = args.get<float>("--speed");
+  p.tick_s = args.get<float>("--tick");
+  p.servo = args.get<bool>("--servo");
+
+  const int courses = args.get<int>("--courses");
+  const int threads = args.get<int>("--threads");
+  auto start = std::chrono::steady_clock::now();
+  auto results = run_missions(p, courses, args.get<int>("--seed"), threads);
+  std::chrono::duration<float> wall = std::chrono::steady_clock::now() - start;
+
+  int successes = 0, short_stops = 0, timeouts = 0, collisions = 0;
+  float simulated_s = 0.0f;
+  std::vector<float> finish_times, cone_distances;
+  for (const auto& r : results) {
+    switch (r.outcome) {
+      case SimResult::Outcome::SUCCESS:
+        successes++;
+        finish_times.push_back(r.mission_time_s);
+        break;
+      case SimResult::Outcome::STOPPED_SHORT:
+        short_stops++;
+        break;
+      case SimResult::Outcome::TIMEOUT:
+        timeouts++;
+        break;
+    }
+    if (r.outcome != SimResult::Outcome::TIMEOUT) cone_distances.push_back(r.cone_distance_m);
+    collisions += r.collisions;
+    simulated_s += r.mission_time_s;
+  }
+  auto pct = [&](int n) { return 100.0f * n / std::max(1, courses); };
+  print("Courses: {} ({} arrows, {} obstacles) on {} threads\n", courses, p.arrows, p.obstacles, threads);
+  print("Success: {} ({:.1f}%), stopped short: {} ({:.1f}%), timed out: {} ({:.1f}%)\n",
+        successes, pct(successes), short_stops, pct(short_stops), timeouts, pct(timeouts));
+  print("Time to finish: p50 {:.1f}s, p90 {:.1f}s, p99 {:.1f}s\n",
+        percentile(finish_times, 0.5f), percentile(finish_times, 0.9f), percentile(finish_times, 0.99f));
+  print("Stop distance from cone: p50 {:.2f}m, p90 {:.2f}m\n",
+        percentile(cone_distances, 0.5f), percentile(cone_distances, 0.9f));
+  print("Obstacle contacts: {:.2f} per course\n", float(collisions) / std::max(1, courses));
+  print("Simulated {:.1f}h in {:.2f}s ({:.0f}x real time)\n",
+        simulated_s / 3600.0f, wall.count(), simulated_s / wall.count());
+}
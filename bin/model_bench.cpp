@@ -0,0 +1,264 @@
+#include <argparse/argparse.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <opencv4/opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ranges.h>
+
+#include "classification_model.hpp"
+#include "detector_pool.hpp"
+#include "model_registry.hpp"
+#include "ort_session.hpp"
+
+using fmt::print;
+using namespace std::chrono;
+
+static argparse::ArgumentParser args("michi_model_bench");
+
+float percentile(std::vector<float> v, float p) {
+  if (v.empty()) return NAN;
+  size_t k = std::min(v.size() - 1, size_t(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+long peak_rss_kb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+int thread_count() {
+  std::ifstream status("/proc/self/status");
+  for (std::string line; std::getline(status, line);) {
+    if (line.starts_with("Threads:")) return std::stoi(line.substr(8));
+  }
+  return 0;
+}
+
+// Frames are decoded and resized up front so only the model is measured
+std::vector<cv::Mat> load_frames(const std::string& input, size_t max_frames) {
+  namespace fs = std::filesystem;
+  const cv::Size frame_size(640, 480);
+  std::vector<cv::Mat> frames;
+  auto add = [&](cv::Mat image) {
+    if (image.empty()) return;
+    cv::resize(image, image, frame_size);
+    frames.push_back(image);
+  };
+  if (fs::is_directory(input)) {
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(input)) {
+      auto ext = entry.path().extension().string();
+      if (ext == ".jpg" or ext == ".jpeg" or ext == ".png") paths.push_back(entry.path());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths) {
+      if (frames.size() >= max_frames) break;
+      add(cv::imread(path.string()));
+    }
+  } else if (cv::Mat image = cv::imread(input); not image.empty()) {
+    add(image);
+  } else {
+    cv::VideoCapture cap(input);
+    cv::Mat frame;
+    while (frames.size() < max_frames and cap.read(frame)) add(frame.clone());
+  }
+  return frames;
+}
+
+struct Series {
+  const char* name;
+  std::vector<float> ms;
+};
+struct BenchResult {
+  SessionConfig config;
+  float load_ms;
+  float fps;
+  float detection_rate;
+  long rss_model_kb; // Peak before the model was loaded
+  long rss_peak_kb;
+  int threads; // With all instances loaded
+  float pool_fps = 0.0f;
+  std::array<Series, 4> series{ { { "pre" }, { "infer" }, { "post" }, { "total" } } };
+};
+
+BenchResult bench(const ModelEntry& entry, const SessionConfig& config, std::vector<cv::Mat>& frames,
+                  int warmup, int iterations, float threshold, int instances, int pool_size) {
+  BenchResult r{ config };
+  r.rss_model_kb = peak_rss_kb();
+  auto load_start = steady_clock::now();
+  // Extra instances are only loaded, to see what each one costs in memory and threads
+  std::vector<ClassificationModel> models;
+  for (int i = 0; i < instances; i++) models.push_back(entry.make(args.get("--model-path"), config));
+  r.load_ms = duration<float, std::milli>(steady_clock::now() - load_start).count() / instances;
+  r.threads = thread_count();
+  ClassificationModel& model = models.front();
+
+  auto& [pre, infer, post, total] = r.series;
+  int detections = 0;
+  cv::Mat input;
+  nanoseconds timed{ 0 };
+  for (int i = 0; i < warmup + iterations; i++) {
+    // Models preprocess in place
+    frames[i % frames.size()].copyTo(input);
+    auto start = steady_clock::now();
+    auto d = classify(model, input, threshold);
+    auto elapsed = steady_clock::now() - start;
+    if (i < warmup) continue;
+    auto stages = get_timings(model);
+    if (stages.pre + stages.infer + stages.post == nanoseconds(0)) stages.infer = elapsed;
+    auto ms = [](auto t) { return duration<float, std::milli>(t).count(); };
+    pre.ms.push_back(ms(stages.pre));
+    infer.ms.push_back(ms(stages.infer));
+    post.ms.push_back(ms(stages.post));
+    total.ms.push_back(ms(elapsed));
+    timed += elapsed;
+    detections += d != ClassificationModel::Detection::NONE;
+  }
+  r.fps = iterations / duration<float>(timed).count();
+  r.detection_rate = float(detections) / iterations;
+
+  if (pool_size > 1) {
+    // Every replica kept busy, as when frames arrive faster than one inference
+    DetectorPool pool(std::move(models.front()), pool_size);
+    std::vector<std::future<DetectionResult>> results;
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; i++) results.push_back(pool.submit(frames[i % frames.size()].clone(), threshold));
+    for (auto& f : results) f.get();
+    r.pool_fps = iterations / duration<float>(steady_clock::now() - start).count();
+  }
+  r.rss_peak_kb = peak_rss_kb();
+  return r;
+}
+
+int main(int argc, char* argv[]) {
+  args.add_argument("input").help("Image, directory of images or video to run the model on");
+  args.add_argument("-m", "--model").default_value(std::string("yolov8"))
+    .help(fmt::format("model to benchmark: {}", fmt::join(model_names(), ", ")));
+  args.add_argument("-p", "--model-path").default_value(std::string("lib/model7.onnx")).help("Path to the model's ONNX file");
+  args.add_argument("-t", "--threshold").help("Detection threshold, defaults to the model's").scan<'g', float>();
+  args.add_argument("--warmup").default_value(10).help("Untimed iterations before measuring").scan<'i', int>();
+  args.add_argument("-n", "--iterations").default_value(200).help("Timed iterations, cycling over the frames").scan<'i', int>();
+  args.add_argument("--max-frames").default_value(300).help("Frames to load from the input").scan<'i', int>();
+  args.add_argument("--intra-threads").default_value(0).help("ONNX Runtime intra-op threads (0: one per core)").scan<'i', int>();
+  args.add_argument("--inter-threads").default_value(0).help("ONNX Runtime inter-op threads (0: default)").scan<'i', int>();
+  args.add_argument("--parallel").default_value(false).implicit_value(true).help("Use ONNX Runtime's parallel executor");
+  args.add_argument("--provider").default_value(std::string("cpu"))
+    .help("Comma separated execution providers to compare: cpu, xnnpack, openvino, dnnl");
+  args.add_argument("--instances").default_value(1).help("Model instances to load, the first one is timed").scan<'i', int>();
+  args.add_argument("--pool").default_value(0).help("Also measure throughput of a detector pool of this many replicas").scan<'i', int>();
+  args.add_argument("--private-runtime").default_value(false).implicit_value(true)
+    .help("Give each session its own threads and arena instead of the process-wide ones");
+  args.add_argument("--log-placement").default_value(false).implicit_value(true).help("Log which provider runs each node");
+  args.add_argument("--json").help("Also write the results to this file, one JSON object per provider");
+
+  try {
+    args.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n';
+    std::cerr << args;
+    return 1;
+  }
+  auto entry = model_registry().find(args.get("--model"));
+  if (entry == model_registry().end()) {
+    spdlog::error("Unknown model {}, choose one of {}", args.get("--model"), fmt::join(model_names(), ", "));
+    return 1;
+  }
+  std::vector<SessionConfig> configs;
+  {
+    std::istringstream names(args.get("--provider"));
+    for (std::string name; std::getline(names, name, ',');) {
+      auto provider = parse_execution_provider(name);
+      if (not provider) {
+        spdlog::error("Unknown execution provider {}", name);
+        return 1;
+      }
+      SessionConfig config;
+      config.intra_op_threads = args.get<int>("--intra-threads");
+      config.inter_op_threads = args.get<int>("--inter-threads");
+      config.parallel_execution = args.get<bool>("--parallel");
+      config.provider = *provider;
+      config.log_placement = args.get<bool>("--log-placement");
+      config.shared_runtime = not args.get<bool>("--private-runtime");
+      configs.push_back(config);
+    }
+  }
+  const float threshold = args.present<float>("--threshold").value_or(entry->second.threshold);
+  const int warmup = args.get<int>("--warmup");
+  const int iterations = std::max(1, args.get<int>("--iterations"));
+  const int instances = std::max(1, args.get<int>("--instances"));
+
+  auto frames = load_frames(args.get("input"), args.get<int>("--max-frames"));
+  if (frames.empty()) {
+    spdlog::error("No frames could be read from {}", args.get("input"));
+    return 1;
+  }
+  const long rss_frames_kb = peak_rss_kb();
+
+  std::vector<BenchResult> results;
+  for (const auto& config : configs) {
+    if (config.provider != ExecutionProvider::CPU and not provider_available(config.provider)) {
+      spdlog::warn("Skipping {}: not available in this onnxruntime", to_string(config.provider));
+      continue;
+    }
+    auto r = bench(entry->second, config, frames, warmup, iterations, threshold, instances, args.get<int>("--pool"));
+    print("\n{} ({}) on {}, {} frames, {} iterations after {} warm-up, intra {} inter {}{}\n",
+          args.get("--model"), entry->second.description, to_string(config.provider), frames.size(),
+          iterations, warmup, config.intra_op_threads, config.inter_op_threads,
+          config.parallel_execution ? " parallel" : "");
+    print("Load {:.0f} ms per instance, detections in {:.1f}% of frames\n", r.load_ms, 100.0f * r.detection_rate);
+    print("{:>6} {:>8} {:>8} {:>8} {:>8} (ms)\n", "", "p50", "p90", "p99", "max");
+    for (const auto& s : r.series) {
+      print("{:>6} {:8.2f} {:8.2f} {:8.2f} {:8.2f}\n", s.name,
+            percentile(s.ms, 0.5f), percentile(s.ms, 0.9f), percentile(s.ms, 0.99f),
+            *std::max_element(s.ms.begin(), s.ms.end()));
+    }
+    print("Throughput {:.1f} fps\n", r.fps);
+    if (r.pool_fps > 0.0f) {
+      print("Pool of {} replicas {:.1f} fps ({:.2f}x)\n", args.get<int>("--pool"), r.pool_fps, r.pool_fps / r.fps);
+    }
+    // Peak RSS only grows, so later providers are charged from the highest mark so far
+    print("Peak RSS {:.1f} MB (frames {:.1f} MB, {} model instance(s) and inference +{:.1f} MB), {} threads\n",
+          r.rss_peak_kb / 1024.0, rss_frames_kb / 1024.0, instances, (r.rss_peak_kb - r.rss_model_kb) / 1024.0,
+          r.threads);
+    results.push_back(std::move(r));
+  }
+
+  if (results.size() > 1) {
+    const float base = percentile(results.front().series[3].ms, 0.5f);
+    print("\n{:>9} {:>9} {:>9} {:>8}\n", "provider", "p50 ms", "fps", "speedup");
+    for (const auto& r : results) {
+      float p50 = percentile(r.series[3].ms, 0.5f);
+      print("{:>9} {:9.2f} {:9.1f} {:7.2f}x\n", to_string(r.config.provider), p50, r.fps, base / p50);
+    }
+  }
+
+  if (args.is_used("--json")) {
+    std::ofstream out(args.get("--json"));
+    for (const auto& r : results) {
+      out << fmt::format(R"({{"model": "{}", "provider": "{}", "frames": {}, "iterations": {}, "intra_threads": {}, "inter_threads": {}, )",
+                         args.get("--model"), to_string(r.config.provider), frames.size(), iterations,
+                         r.config.intra_op_threads, r.config.inter_op_threads);
+      out << fmt::format(R"("load_ms": {:.3f}, "throughput_fps": {:.3f}, "peak_rss_kb": {}, "instances": {}, "threads": {}, "pool_fps": {:.3f}, )",
+                         r.load_ms, r.fps, r.rss_peak_kb, instances, r.threads, r.pool_fps);
+      for (const auto& s : r.series) {
+        out << fmt::format(R"("{}_ms": {{"p50": {:.4f}, "p90": {:.4f}, "p99": {:.4f}}}{})", s.name,
+                           percentile(s.ms, 0.5f), percentile(s.ms, 0.9f), percentile(s.ms, 0.99f),
+                           &s == &r.series.back() ? "}\n" : ", ");
+      }
+    }
+  }
+  return 0;
+}
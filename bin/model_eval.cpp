@@ -0,0 +1,234 @@
+#include <argparse/argparse.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <opencv4/opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ranges.h>
+
+#include "classification_model.hpp"
+#include "detection_metrics.hpp"
+#include "model_registry.hpp"
+#include "pipeline_queue.hpp"
+
+using fmt::print;
+using namespace std::chrono;
+namespace fs = std::filesystem;
+namespace pt = boost::property_tree;
+
+static argparse::ArgumentParser args("michi_model_eval");
+
+float percentile(std::vector<float> v, float p) {
+  if (v.empty()) return NAN;
+  size_t k = std::min(v.size() - 1, size_t(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+struct Sample {
+  size_t index;
+  cv::Mat image;
+  std::vector<LabeledBox> truths;
+};
+
+// Labels of a frame, a missing file is a frame without objects
+std::vector<LabeledBox> read_labels(const fs::path& path, cv::Size size) {
+  std::ifstream in(path);
+  return in ? parse_yolo_labels(in, size.width, size.height) : std::vector<LabeledBox>{};
+}
+
+int main(int argc, char* argv[]) {
+  args.add_argument("dataset").help("Directory of images, or a video, labelled in YOLO txt format");
+  args.add_argument("-m", "--model").default_value(std::string("yolov8"))
+    .help(fmt::format("model to evaluate: {}", fmt::join(model_names(), ", ")));
+  args.add_argument("-p", "--model-path").default_value(std::string("lib/model7.onnx")).help("Path to the model's ONNX file");
+  args.add_argument("-t", "--threshold").help("Detection threshold, defaults to the model's").scan<'g', float>();
+  args.add_argument("-l", "--labels").help("Label directory: <image stem>.txt per image, frame_<6 digit index>.txt per video frame. "
+                                           "Defaults to <dataset>/labels, or the image directory itself");
+  args.add_argument("--classes").default_value(std::string("RIGHT,LEFT,CONE")).help("Detections named by label class id, in order");
+  args.add_argument("--iou").default_value(0.5f).help("IoU for a prediction to count as a match").scan<'g', float>();
+  args.add_argument("-j", "--workers").default_value(int(std::max(1u, std::thread::hardware_concurrency() / 2)))
+    .help("Inference threads, each with its own model instance").scan<'i', int>();
+  args.add_argument("-o", "--report").help("Write the results as JSON");
+  args.add_argument("--baseline").help("Report of a reference run to compare against");
+  args.add_argument("--max-map-drop").default_value(0.01f).help("mAP loss against the baseline that fails the run").scan<'g', float>();
+
+  try {
+    args.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n';
+    std::cerr << args;
+    return 1;
+  }
+  auto entry = model_registry().find(args.get("--model"));
+  if (entry == model_registry().end()) {
+    spdlog::error("Unknown model {}, choose one of {}", args.get("--model"), fmt::join(model_names(), ", "));
+    return 1;
+  }
+  const float threshold = args.present<float>("--threshold").value_or(entry->second.threshold);
+  const int workers = std::max(1, args.get<int>("--workers"));
+
+  std::vector<std::string> class_names;
+  std::map<ClassificationModel::Detection, int> class_ids;
+  {
+    std::istringstream names(args.get("--classes"));
+    for (std::string name; std::getline(names, name, ',');) class_names.push_back(name);
+    for (auto d : { ClassificationModel::Detection::ARROW_LEFT, ClassificationModel::Detection::ARROW_RIGHT,
+                    ClassificationModel::Detection::CONE, ClassificationModel::Detection::ARUCO }) {
+      auto it = std::find(class_names.begin(), class_names.end(), to_string(d));
+      if (it != class_names.end()) class_ids[d] = it - class_names.begin();
+    }
+  }
+
+  const fs::path dataset(args.get("dataset"));
+  const cv::Size frame_size(640, 480); // What the models are trained on
+  fs::path label_dir = fs::is_directory(dataset / "labels") ? dataset / "labels" : dataset;
+  if (auto labels = args.present("--labels")) label_dir = *labels;
+
+  std::vector<ClassificationModel> models = entry->second.make_replicas(args.get("--model-path"), workers);
+
+  BoundedQueue<Sample> samples(4 * workers);
+  DetectionEvaluator evaluator(class_names.size(), args.get<float>("--iou"));
+  std::mutex latency_mutex;
+  std::vector<float> latency_ms;
+  std::atomic<size_t> unmapped = 0;
+
+  std::jthread loader([&] {
+    // Labels are normalized, so resizing the frame keeps them valid
+    auto load = [&](size_t index, cv::Mat image, const fs::path& label) {
+      cv::resize(image, image, frame_size);
+      return samples.push({ index, image, read_labels(label, frame_size) });
+    };
+    size_t index = 0;
+    if (fs::is_directory(dataset)) {
+      fs::path image_dir = fs::is_directory(dataset / "images") ? dataset / "images" : dataset;
+      std::vector<fs::path> paths;
+      for (const auto& e : fs::directory_iterator(image_dir)) {
+        auto ext = e.path().extension().string();
+        if (ext == ".jpg" or ext == ".jpeg" or ext == ".png") paths.push_back(e.path());
+      }
+      std::sort(paths.begin(), paths.end());
+      for (const auto& path : paths) {
+        cv::Mat image = cv::imread(path.string());
+        if (image.empty()) continue;
+        if (not load(index++, image, label_dir / path.stem().concat(".txt"))) break;
+      }
+    } else {
+      cv::VideoCapture cap(dataset.string());
+      for (cv::Mat frame; cap.read(frame); index++) {
+        if (not load(index, frame.clone(), label_dir / fmt::format("frame_{:06}.txt", index))) break;
+      }
+    }
+    samples.close();
+  });
+
+  auto start = steady_clock::now();
+  {
+    std::vector<std::jthread> inference;
+    for (int w = 0; w < workers; w++) {
+      inference.emplace_back([&, w] {
+        auto& model = models[w];
+        cv::Mat input;
+        while (auto sample = samples.pop()) {
+          // Models preprocess in place
+          sample->image.copyTo(input);
+          auto t0 = steady_clock::now();
+          auto d = classify(model, input, threshold);
+          duration<float, std::milli> elapsed = steady_clock::now() - t0;
+          std::vector<ScoredBox> predictions;
+          if (d != ClassificationModel::Detection::NONE) {
+            if (auto id = class_ids.find(d); id != class_ids.end()) {
+              cv::Rect r = get_bounding_box(model);
+              predictions.push_back({ id->second, get_confidence(model),
+                                      { float(r.x), float(r.y), float(r.width), float(r.height) } });
+            } else {
+              unmapped++;
+            }
+          }
+          evaluator.add_image(sample->index, sample->truths, predictions);
+          std::lock_guard lock(latency_mutex);
+          latency_ms.push_back(elapsed.count());
+        }
+      });
+    }
+  }
+  duration<float> wall = steady_clock::now() - start;
+
+  auto metrics = evaluator.evaluate();
+  const float map = DetectionEvaluator::mean_average_precision(metrics);
+  const size_t images = evaluator.images();
+  print("{} at threshold {} on {} frames, {} workers\n", args.get("--model"), threshold, images, workers);
+  print("{:>8} {:>6} {:>6} {:>6} {:>9} {:>7} {:>7}\n", "class", "truth", "AP", "prec", "recall", "IoU", "FP");
+  for (size_t c = 0; c < metrics.size(); c++) {
+    const auto& m = metrics[c];
+    print("{:>8} {:>6} {:6.3f} {:6.3f} {:9.3f} {:7.3f} {:>7}\n", class_names[c], m.ground_truths,
+          m.average_precision, m.precision, m.recall, m.mean_iou, m.false_positives);
+  }
+  if (unmapped) print("{} detections of classes not in --classes were ignored\n", unmapped.load());
+  const float p50 = percentile(latency_ms, 0.5f), p90 = percentile(latency_ms, 0.9f), p99 = percentile(latency_ms, 0.99f);
+  print("mAP@{:.2f} {:.3f}, latency p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, {:.1f} fps overall\n",
+        args.get<float>("--iou"), map, p50, p90, p99, images / wall.count());
+
+  pt::ptree report;
+  report.put("model", args.get("--model"));
+  report.put("model_path", args.get("--model-path"));
+  report.put("threshold", threshold);
+  report.put("frames", images);
+  report.put("map", map);
+  report.put("latency_ms.p50", p50);
+  report.put("latency_ms.p90", p90);
+  report.put("latency_ms.p99", p99);
+  for (size_t c = 0; c < metrics.size(); c++) {
+    pt::ptree& cls = report.put_child("classes." + class_names[c], {});
+    cls.put("ground_truths", metrics[c].ground_truths);
+    cls.put("ap", metrics[c].average_precision);
+    cls.put("precision", metrics[c].precision);
+    cls.put("recall", metrics[c].recall);
+    cls.put("mean_iou", metrics[c].mean_iou);
+  }
+  if (args.is_used("--report")) pt::write_json(args.get("--report"), report);
+
+  if (not args.is_used("--baseline")) return 0;
+  pt::ptree baseline;
+  try {
+    pt::read_json(args.get("--baseline"), baseline);
+  }
+  catch (const pt::json_parser_error& e) {
+    spdlog::error("Could not read baseline: {}", e.what());
+    return 1;
+  }
+  auto delta = [](float now, float before) { return fmt::format("{:+.3f}", now - before); };
+  auto baseline_map = baseline.get_optional<float>("map");
+  if (not baseline_map) {
+    spdlog::error("Baseline {} has no mAP", args.get("--baseline"));
+    return 1;
+  }
+  const float base_map = *baseline_map;
+  print("\nAgainst {} ({}):\n", args.get("--baseline"), baseline.get<std::string>("model", "?"));
+  print("  mAP {:.3f} -> {:.3f} ({})\n", base_map, map, delta(map, base_map));
+  for (size_t c = 0; c < metrics.size(); c++) {
+    auto ap = baseline.get_optional<float>("classes." + class_names[c] + ".ap");
+    if (ap) print("  {:>8} AP {:.3f} -> {:.3f} ({})\n", class_names[c], *ap, metrics[c].average_precision,
+                  delta(metrics[c].average_precision, *ap));
+  }
+  for (auto [name, now] : std::array<std::pair<const char*, float>, 3>{ { { "p50", p50 }, { "p90", p90 }, { "p99", p99 } } }) {
+    float before = baseline.get<float>(std::string("latency_ms.") + name, NAN);
+    print("  latency {} {:.2f} ms -> {:.2f} ms ({:+.1f}%)\n", name, before, now, 100.0f * (now - before) / before);
+  }
+  if (base_map - map > args.get<float>("--max-map-drop")) {
+    print("FAIL: mAP dropped by more than {}\n", args.get<float>("--max-map-drop"));
+    return 2;
+  }
+  print("PASS\n");
+  return 0;
+}
@@ -0,0 +1,187 @@
+#include <argparse/argparse.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <asio/detached.hpp>
+#include <opencv4/opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ranges.h>
+
+#include "ardupilot_interface.hpp"
+#include "fake_autopilot.hpp"
+#include "frame_view.hpp"
+#include "model_registry.hpp"
+#include "obstacle_clusters.hpp"
+#include "obstacle_pipeline.hpp"
+#include "perf_baseline.hpp"
+
+using fmt::print;
+using namespace std::chrono;
+
+static argparse::ArgumentParser args("michi_perf_gate");
+// Exit codes besides 0 and 1; ctest reports NO_BASELINE as skipped
+constexpr int REGRESSED = 2;
+constexpr int NO_BASELINE = 77;
+
+// A depth frame from a camera 0.5 m above flat ground, with a post that
+// walks across the view and a wall behind it. Noise and dropouts are
+// seeded, so every run replays the same session.
+SyntheticDepth synthetic_depth(int frame, std::span<const float, 2> fov, uint32_t seed) {
+  constexpr int width = 640, height = 480;
+  constexpr float camera_height = 0.5f, wall_z = 6.0f, post_z = 2.5f, post_radius = 0.15f;
+  const auto k = DepthIntrinsics::from_fov(width, height, fov[0], fov[1]);
+  const float post_x = 1.5f * std::sin(frame * 0.05f);
+  const int left = int(k.ppx + k.fx * (post_x - post_radius) / post_z);
+  const int right = int(k.ppx + k.fx * (post_x + post_radius) / post_z);
+  const int foot = int(k.ppy + k.fy * camera_height / post_z);
+  SyntheticDepth depth(width, height, k);
+  depth.fill(wall_z).ground(camera_height).nearest(cv::Rect(left, 0, right - left, foot), post_z);
+  depth.noise(0.01f, seed + frame).dropout(0.02f, seed + frame);
+  return depth;
+}
+
+double elapsed_ms(time_point<steady_clock> start) {
+  return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+// Replays the session through the pipeline one tick at a time, as mission2
+// runs it: obstacles from the depth frame, then objects, then the detector,
+// then what goes to the autopilot. Only the stages are timed.
+auto replay(auto& mi, std::optional<ClassificationModel>& model, float threshold, const cv::Mat& image,
+            std::map<std::string, std::vector<double>>& samples, asio::io_context& io_ctx) -> asio::awaitable<void> {
+  const int warmup = args.get<int>("--warmup");
+  const int frames = args.get<int>("--frames");
+  std::array<float, 2> fov{ 87.0f * float(M_PI) / 180.0f, 58.0f * float(M_PI) / 180.0f };
+  const uint32_t seed = args.get<int>("--seed");
+  ObstacleBinner binner;
+  GridClusterer clusterer;
+  ObstacleTracker tracker;
+  std::vector<GroundPoint> ground_points;
+  cv::Mat input;
+  asio::steady_timer timer(co_await asio::this_coro::executor);
+
+  for (int i = 0; i < warmup + frames; i++) {
+    const bool timed = i >= warmup;
+    const double timestamp_ms = i * 1000.0 / 30.0;
+    auto depth = synthetic_depth(i, fov, seed);
+
+    // From the Z16 frame, as the camera hands it over
+    auto start = steady_clock::now();
+    auto distances = obstacle_bins(depth.view(timestamp_ms), std::span(fov), 0.3f, binner, nullptr, {}, {}, &ground_points);
+    if (timed) samples["obstacles"].push_back(elapsed_ms(start));
+
+    start = steady_clock::now();
+    tracker.update(clusterer.cluster(ground_points), timestamp_ms / 1000.0);
+    if (timed) samples["clusters"].push_back(elapsed_ms(start));
+
+    if (model) {
+      // Models preprocess in place
+      image.copyTo(input);
+      start = steady_clock::now();
+      classify(*model, input, threshold);
+      if (timed) samples["inference"].push_back(elapsed_ms(start));
+    }
+
+    const float hfov_deg = fov[0] * 180.0f / M_PI;
+    std::array<float, 3> velocity{ 0.1f, 0.0f, 0.0f };
+    start = steady_clock::now();
+    co_await mi.set_obstacle_distance(std::span(distances), hfov_deg / binner.params().bins, 17.5f, 300.0f, -0.5f * hfov_deg);
+    co_await mi.set_target_velocity(velocity);
+    if (timed) samples["mavlink"].push_back(elapsed_ms(start));
+
+    // Let telemetry in between ticks, as the camera wait does
+    timer.expires_after(1ms);
+    co_await timer.async_wait(use_nothrow_awaitable);
+  }
+  io_ctx.stop();
+}
+
+int main(int argc, char* argv[]) {
+  args.add_description("Replays a synthetic session through the pipeline and fails if a stage got slower than its baseline");
+  args.add_argument("--frames").default_value(100).help("Frames to time").scan<'i', int>();
+  args.add_argument("--warmup").default_value(10).help("Frames before timing, while caches and allocators settle").scan<'i', int>();
+  args.add_argument("--seed").default_value(7).help("Seed for the synthetic depth noise").scan<'i', int>();
+  args.add_argument("--baseline").required()
+    .help(fmt::format("Stage latencies to compare against, exits {} if the file doesn't exist", NO_BASELINE));
+  args.add_argument("--update-baseline").default_value(false).implicit_value(true)
+    .help("Record this run as the baseline instead of comparing");
+  args.add_argument("--report").help("Also write this run's latencies and the diff to this file");
+  args.add_argument("--tolerance").default_value(PerfTolerance{}.p50).help("How much slower p50 may get, as a fraction").scan<'g', double>();
+  args.add_argument("--tolerance-p99").default_value(PerfTolerance{}.p99).help("How much slower p99 may get, as a fraction").scan<'g', double>();
+  args.add_argument("-m", "--model").help(fmt::format("Also time this detector: {}", fmt::join(model_names(), ", ")));
+  args.add_argument("-p", "--model-path").default_value(std::string("lib/model7.onnx")).help("Path to the model's ONNX file");
+  args.add_argument("--image").default_value(std::string("tests/sample_left_arrow.jpg")).help("Image the detector runs on");
+  try {
+    args.parse_args(argc, argv);
+  } catch (const std::runtime_error& err) {
+    std::cerr << err.what() << '\n' << args;
+    return 1;
+  }
+  spdlog::set_level(spdlog::level::warn);
+#ifndef __OPTIMIZE__
+  spdlog::warn("Built without optimization, latencies won't match a Release baseline");
+#endif
+
+  std::optional<ClassificationModel> model;
+  float threshold = 0.0f;
+  cv::Mat image;
+  if (auto name = args.present("--model")) {
+    auto entry = model_registry().find(*name);
+    if (entry == model_registry().end()) {
+      spdlog::error("Unknown model {}, choose one of {}", *name, fmt::join(model_names(), ", "));
+      return 1;
+    }
+    image = cv::imread(args.get("--image"));
+    if (image.empty()) {
+      spdlog::error("Could not read {}", args.get("--image"));
+      return 1;
+    }
+    cv::resize(image, image, cv::Size(640, 480));
+    model = entry->second.make(args.get("--model-path"));
+    threshold = entry->second.threshold;
+  }
+
+  std::map<std::string, std::vector<double>> samples;
+  asio::io_context io_ctx(1);
+  auto mi = loopback_autopilot(io_ctx, 50);
+  asio::co_spawn(io_ctx, mi.loop(), asio::detached);
+  asio::co_spawn(io_ctx, replay(mi, model, threshold, image, samples, io_ctx), asio::detached);
+  io_ctx.run();
+
+  PerfReport report;
+  for (auto& [stage, ms] : samples) report[stage] = summarize_latency(std::move(ms));
+
+  const std::string baseline_path = args.get("--baseline");
+  if (args.get<bool>("--update-baseline")) {
+    if (not write_perf_report(baseline_path, report)) return 1;
+    print("Recorded baseline {}\n{}", baseline_path, latency_diff_table(compare_latency(report, {})));
+    return 0;
+  }
+  if (not std::filesystem::exists(baseline_path)) {
+    // A baseline from another machine or build would mean nothing, so none
+    // is made up here
+    print("{}\n", latency_diff_table(compare_latency(report, {})));
+    spdlog::warn("No baseline at {}, record one with --update-baseline", baseline_path);
+    return NO_BASELINE;
+  }
+  auto baseline = read_perf_report(baseline_path);
+  if (not baseline) return 1;
+  PerfTolerance tolerance;
+  tolerance.p50 = args.get<double>("--tolerance");
+  tolerance.p99 = args.get<double>("--tolerance-p99");
+  auto diffs = compare_latency(report, *baseline, tolerance);
+  print("{}", latency_diff_table(diffs));
+  if (auto path = args.present("--report"); path and not write_perf_report(*path, report, diffs)) return 1;
+  if (any_regressed(diffs)) {
+    spdlog::error("Pipeline got slower than {}, rerun with --update-baseline if that's intended", baseline_path);
+    return REGRESSED;
+  }
+  return 0;
+}
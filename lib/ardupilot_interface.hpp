@@ -2,7 +2,10 @@
 
 #include <Eigen/Geometry>
 #include "expected.hpp"
+#include "geodetic.hpp"
+#include "metrics.hpp"
 #include <algorithm>
+#include <array>
 #include <concepts>
 #include <queue>
 // #define ASIO_ENABLE_HANDLER_TRACKING 1
@@ -80,7 +83,8 @@ const float INVALID = 0.0f;
 
 struct ArdupilotState {
   std::array<float, 3> m_local_xyz;
-  std::array<int32_t, 3> m_lat_lon_alt;
+  tLatLonAlt m_lat_lon_alt;
+  tLatLonAlt m_ekf_origin;
   std::array<float, 3> m_global_vel;
   std::array<float, 3> m_rpy;
   std::array<float, 3> m_rpy_vel;
@@ -103,13 +107,23 @@ class MavlinkInterface
   uint32_t USE_POSITION = 0x0DFC;
   uint32_t USE_VELOCITY = 0x0DE7;
   uint32_t USE_YAW = 0x09FF;
+  uint32_t USE_VELOCITY_YAW_RATE = 0x05C7;
 
   uint8_t m_channel = MAVLINK_COMM_0;
 
   // The thing we want to get from AP
-  ArdupilotState m_ap_state;
+  ArdupilotState m_ap_state{};
   size_t REQUESTS_QUEUE_SIZE = 25;
   asio::experimental::channel<void(asio::error_code, mavlink_message_t)> m_ap_requests;
+  // Receive state lives here rather than in the coroutine frame, which keeps
+  // the frame small enough for asio to recycle and the read free of allocation
+  std::array<uint8_t, 512> m_rx_buffer;
+  mavlink_message_t m_rx_msg;
+  mavlink_status_t m_rx_status;
+  // Shared by every interface in the process
+  Counter& m_rx_messages = metrics().counter("michi_mavlink_rx_messages_total", "MAVLink messages received");
+  Counter& m_rx_errors = metrics().counter("michi_mavlink_rx_errors_total", "MAVLink parse errors, mostly bad CRCs");
+  Counter& m_tx_messages = metrics().counter("michi_mavlink_tx_messages_total", "MAVLink messages sent");
 
   inline auto get_uptime() -> uint32_t
   {
@@ -122,6 +136,7 @@ class MavlinkInterface
     auto len = mavlink_msg_to_send_buffer(buffer, &msg);
     auto res = co_await asio::async_write(
       m_uart, asio::buffer(buffer, len), use_nothrow_awaitable);
+    if (not std::get<0>(res)) m_tx_messages.inc();
     co_return res;
   }
   auto update_local_position(const mavlink_message_t* msg) -> void {
@@ -139,6 +154,17 @@ class MavlinkInterface
     mavlink_global_position_int_t pos;
     mavlink_msg_global_position_int_decode(msg, &pos);
     m_ap_state.m_heading_deg = pos.hdg / 100.0f;
+    // AP streams GLOBAL_POSITION_INT but rarely the _COV variant
+    m_ap_state.m_lat_lon_alt = {pos.lat, pos.lon, pos.alt};
+  }
+  auto update_ekf_origin(const mavlink_message_t* msg) -> void {
+    mavlink_gps_global_origin_t origin;
+    mavlink_msg_gps_global_origin_decode(msg, &origin);
+    tLatLonAlt new_origin{origin.latitude, origin.longitude, origin.altitude};
+    if (has_global_fix(m_ap_state.m_ekf_origin) and new_origin != m_ap_state.m_ekf_origin) {
+      spdlog::warn("EKF origin changed to {}", new_origin);
+    }
+    m_ap_state.m_ekf_origin = new_origin;
   }
   auto update_attitude(const mavlink_message_t* msg) -> void {
     mavlink_attitude_t att;
@@ -187,6 +213,10 @@ class MavlinkInterface
         spdlog::trace("Got Global Position cov");
         update_global_position(msg);
         break;
+      case MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN:
+        spdlog::trace("Got EKF origin");
+        update_ekf_origin(msg);
+        break;
       case MAVLINK_MSG_ID_COMMAND_ACK:
         spdlog::info("Got ack");
         break;
@@ -202,21 +232,23 @@ class MavlinkInterface
     spdlog::trace("State updated: {} {} {} {}", m_ap_state.m_lat_lon_alt, 
     m_ap_state.m_global_vel, m_ap_state.m_rpy, m_ap_state.m_rpy_vel);
   }
+  // Handles every message completed by one read; a message split across
+  // reads is carried over by the parser
   auto receive_message() -> asio::awaitable<std::error_code> {
-    std::vector<uint8_t> buffer(MAVLINK_MAX_PACKET_LEN);
     auto [error, len] = co_await m_uart.async_read_some(
-      asio::buffer(buffer), use_nothrow_awaitable);
+      asio::buffer(m_rx_buffer), use_nothrow_awaitable);
     if (error) {
       spdlog::trace("Read from m_uart failed, asio error: {}", error.message());   
       co_return error;
     }
-    mavlink_message_t msg;
-    mavlink_status_t status;
-    for (int i = 0; i < len; i++) {
-      if (mavlink_parse_char(m_channel, buffer[i], &msg, &status))
-        break;
+    for (size_t i = 0; i < len; i++) {
+      if (mavlink_parse_char(m_channel, m_rx_buffer[i], &m_rx_msg, &m_rx_status)) {
+        m_rx_messages.inc();
+        handle_message(&m_rx_msg);
+      }
+      // Parse errors since the last call, bad CRCs among them
+      if (m_rx_status.packet_rx_drop_count) m_rx_errors.inc(m_rx_status.packet_rx_drop_count);
     }
-    handle_message(&msg);
     co_return MavlinkErrc::Success;
   }
 
@@ -271,7 +303,7 @@ public:
       // co_await timer.async_wait(use_nothrow_awaitable);
     }
   }
-  auto init() -> asio::awaitable<tResult<void>>
+  auto init(float position_rate_hz = 10.0f) -> asio::awaitable<tResult<void>>
   {
     using std::ignore;
     using std::tie;
@@ -300,8 +332,13 @@ public:
     while (not ran_once) // RUN THIS ONLY ONCE
     {
       ran_once = true;
-      auto len = mavlink_msg_command_long_pack_chan(m_system_id, m_my_id, m_channel, &msg, m_system_id, m_component_id, mav_cmd_set_message_interval, 0, MAVLINK_MSG_ID_GLOBAL_POSITION_INT, 100000, INVALID, INVALID, INVALID, INVALID, INVALID);
-      spdlog::debug("Sending 10Hz rate for Global Position");
+      auto len = mavlink_msg_command_long_pack_chan(m_system_id, m_my_id, m_channel, &msg, m_system_id, m_component_id, mav_cmd_set_message_interval, 0, MAVLINK_MSG_ID_GLOBAL_POSITION_INT, 1e6f / position_rate_hz, INVALID, INVALID, INVALID, INVALID, INVALID);
+      spdlog::debug("Sending {}Hz rate for Global Position", position_rate_hz);
+      tie(error) = co_await m_ap_requests.async_send(asio::error_code{}, msg, use_nothrow_awaitable);
+      if (error) break;
+      // AP only sends the origin when it changes, so ask for the current one
+      const uint16_t mav_cmd_request_message = 512;
+      mavlink_msg_command_long_pack_chan(m_system_id, m_my_id, m_channel, &msg, m_system_id, m_component_id, mav_cmd_request_message, 0, MAVLINK_MSG_ID_GPS_GLOBAL_ORIGIN, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID);
       tie(error) = co_await m_ap_requests.async_send(asio::error_code{}, msg, use_nothrow_awaitable);
     }
     if (error) {
@@ -316,6 +353,10 @@ public:
   auto global_position() -> std::span<int32_t, 3> const {
     return std::span(m_ap_state.m_lat_lon_alt);
   }
+  // 0, 0 until AP has set its origin
+  auto ekf_origin() -> std::span<int32_t, 3> const {
+    return std::span(m_ap_state.m_ekf_origin);
+  }
   auto global_linear_velocity() -> std::span<float, 3> const {
     return std::span(m_ap_state.m_global_vel);
   }
@@ -454,6 +495,39 @@ public:
       // co_return make_unexpected(MavlinkErrc::FailedWrite);
     }
   }
+  // Body frame velocity with a yaw rate in rad/s, positive clockwise. The
+  // autopilot stops the vehicle if these aren't renewed within a few seconds.
+  auto set_target_velocity_yaw_rate(std::span<float, 3> velxyz, float yaw_rate)
+    -> asio::awaitable<void>
+  {
+    mavlink_message_t msg;
+    mavlink_msg_set_position_target_local_ned_pack_chan(
+      m_system_id,
+      m_my_id,
+      m_channel,
+      &msg,
+      get_uptime(),
+      m_system_id,
+      m_component_id,
+      MAV_FRAME_BODY_OFFSET_NED,
+      USE_VELOCITY_YAW_RATE,
+      INVALID,
+      INVALID,
+      INVALID,
+      velxyz[0],
+      velxyz[1],
+      velxyz[2],
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID,
+      yaw_rate);
+    auto [error] = co_await m_ap_requests.async_send(asio::error_code{}, msg, use_nothrow_awaitable);
+    if (error) {
+      spdlog::error("Could not send set_target, asio error: {}",
+                    error.message());
+    }
+  }
   // ArduPilot doesn't respond to this message it seems use set_target_attitude instead
   auto set_target_yaw(float yaw) -> asio::awaitable<void> {
     mavlink_message_t msg;
@@ -524,6 +598,38 @@ public:
       // co_return make_unexpected(MavlinkErrc::FailedWrite);
     }
   }
+  // Global targets stay valid across EKF origin resets, unlike local ones
+  auto set_target_position_global(std::span<int32_t, 3> lat_lon_alt)
+    -> asio::awaitable<void>
+  {
+    mavlink_message_t msg;
+    mavlink_msg_set_position_target_global_int_pack_chan(
+      m_system_id,
+      m_my_id,
+      m_channel,
+      &msg,
+      get_uptime(),
+      m_system_id,
+      m_component_id,
+      MAV_FRAME_GLOBAL_INT,
+      USE_POSITION,
+      lat_lon_alt[0],
+      lat_lon_alt[1],
+      lat_lon_alt[2] / 1000.0f,
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID,
+      INVALID);
+    auto [error] = co_await m_ap_requests.async_send(asio::error_code{}, msg, use_nothrow_awaitable);
+    if (error) {
+      spdlog::error("Could not send set_target_global, asio error: {}",
+                    error.message());
+    }
+  }
   auto set_target_attitude(std::span<float, 4> rotation_quaternion,
                            float thrust) -> asio::awaitable<void>
   {
@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>
+#include <span>
 #include <unordered_map>
 #include <opencv4/opencv2/opencv.hpp>
 #include <opencv4/opencv2/core.hpp>
@@ -8,7 +9,11 @@
 #include <boost/circular_buffer.hpp>
 
 #include "classification_model.hpp"
+#include "cone_detector.hpp"
+#include "frame_view.hpp"
 #include "mobilenet_arrow.hpp"
+#include "geodetic.hpp"
+#include "mission_checkpoint.hpp"
 
 using LatLonDeg = Eigen::Vector2f;
 using Eigen::Vector3f;
@@ -23,6 +28,7 @@ struct Objective {
   float approach_heading; // Compass heading when this objective was approached
   float target_heading; // Target heading after this objective was reached
   Vector3f location;
+  std::optional<tLatLonAlt> global; // Survives EKF origin resets, unlike location
 
   float distance_to(const Objective& o) {
     auto diff = location - o.location;
@@ -33,17 +39,37 @@ struct Objective {
     return diff.norm();
   }
 };
+// The objective being approached as seen in the current frame
+struct ObjectiveSighting {
+  cv::Rect box;
+  float range; // m
+};
 struct ImpureInterface{
   struct InputState {
     std::span<float, 3> xyz;
     float heading_deg;
+    std::optional<tLatLonAlt> lat_lon_alt;
+    std::optional<tLatLonAlt> ekf_origin; // Where the local frame is anchored
   } input;
   struct Outputs {
-    int delay_sec;
-    Vector3f target_xyz_pos_local;
-    float yaw;
+    int delay_sec = 0;
+    Vector3f target_xyz_pos_local = Vector3f(0, 0, 0);
+    std::optional<float> yaw; // Target heading in degrees; 0 is north, not "no turn"
+    std::optional<tLatLonAlt> target_lat_lon_alt;
+    std::optional<ObjectiveSighting> sighting; // Only with tracking enabled
   } output;
   ImpureInterface(std::span<float, 3> input_xyz, float yaw_deg) : input{.xyz = input_xyz, .heading_deg = yaw_deg} {}
+  ImpureInterface(std::span<float, 3> input_xyz, float yaw_deg, std::span<int32_t, 3> input_lat_lon_alt)
+    : ImpureInterface(input_xyz, yaw_deg) {
+    tLatLonAlt lla{input_lat_lon_alt[0], input_lat_lon_alt[1], input_lat_lon_alt[2]};
+    if (has_global_fix(lla)) input.lat_lon_alt.emplace(lla);
+  }
+  ImpureInterface(std::span<float, 3> input_xyz, float yaw_deg, std::span<int32_t, 3> input_lat_lon_alt,
+                  std::span<int32_t, 3> input_ekf_origin)
+    : ImpureInterface(input_xyz, yaw_deg, input_lat_lon_alt) {
+    tLatLonAlt origin{input_ekf_origin[0], input_ekf_origin[1], input_ekf_origin[2]};
+    if (has_global_fix(origin)) input.ekf_origin.emplace(origin);
+  }
 };
 class ArrowStateMachine {
   std::vector<Objective> m_objectives;
@@ -59,7 +85,25 @@ class ArrowStateMachine {
   std::optional<float> m_current_dist_to_obj;
   Vector3f m_current_pos;
   float m_current_heading_deg;
+
+  // Tangent plane fixed at the first GPS fix; m_local_offset is the local NED
+  // position of that origin, which jumps whenever the EKF resets its origin
+  std::optional<LocalTangentPlane> m_tangent_plane;
+  std::optional<Vector3f> m_local_offset;
+  std::optional<tLatLonAlt> m_ekf_origin;
+  // Without the EKF origin, a horizontal jump this big between the local and
+  // global positions is taken as an origin reset
+  float m_origin_jump_threshold = 1.0f;
+  // Set when the autopilot's copy of the target may be stale (rebase, resume)
+  bool m_resend_target = false;
   boost::circular_buffer<ClassificationModel::Detection> m_detections;
+  // Colour pre-detector for cones: answers obvious cones without the network
+  // and keeps the cone's range fresh every frame during the final approach
+  std::optional<ConeColorDetector> m_cone_detector;
+  float m_cone_refine_threshold = 0.3f; // Target moves less than this are not resent
+  std::optional<cv::Rect> m_detection_box;
+  std::optional<cv::Rect> m_cone_box; // Where the cone being approached was last seen
+  bool m_track_objective = false; // Look for the objective every frame while approaching
 
   auto get_pose_lock(cv::Mat& rgb_image,
                      std::span<float, 4> rect_vertices,
@@ -71,52 +115,167 @@ class ArrowStateMachine {
     // TODO: complete this
     return std::optional<double>();
   }
-  auto get_depth_lock(rs2::depth_frame& depth_frame,
+  auto get_depth_lock(const DepthView& depth_frame,
                       cv::Rect rect_vertices) -> std::optional<float>
   {
     std::optional<float> distance;
     int count = 0, valid = 0;
-    float dist_sum = 0.0f;
+    uint64_t raw_sum = 0;
     spdlog::debug("Rectangle: {} {}, {} {}, size: {}×{}",
                   rect_vertices.tl().x,
                   rect_vertices.tl().y,
                   rect_vertices.br().x,
                   rect_vertices.br().y,
                   rect_vertices.height, rect_vertices.width);
-    for (int i = std::max(rect_vertices.x, 0); i < std::min(rect_vertices.x + rect_vertices.width, depth_frame.get_width()); i++) {
-      for (int j = std::max(rect_vertices.y, 0); j < std::min(rect_vertices.y + rect_vertices.height, depth_frame.get_height()); j++) {
-        // TODO: optimize out get_distance with get_units instead
-        float dist = depth_frame.get_distance(i, j);
-        if (int(dist*1000) != 0) valid++;
-        count++;
-        dist_sum += dist;
+    const cv::Rect roi = rect_vertices & cv::Rect(0, 0, depth_frame.width, depth_frame.height);
+    // Raw Z16 along each row, scaled to metres once
+    for (int j = roi.y; j < roi.br().y; j++) {
+      const uint16_t* row = depth_frame.row(j);
+      for (int i = roi.x; i < roi.br().x; i++) {
+        // Under a millimetre counts as no data
+        if (row[i] * depth_frame.units >= 0.001f) valid++;
+        raw_sum += row[i];
       }
     }
-    if (count*0.5 < valid) distance.emplace(dist_sum/count);
+    count = roi.area();
+    if (count*0.5 < valid) distance.emplace(raw_sum * depth_frame.units / count);
     spdlog::debug("Depth lock done");
     return distance;
   }
 
-  void set_outputs(ImpureInterface& i, float yaw = 0, int delay_sec = 0, bool send_obj = false) {
+  // Must run before the network, which preprocesses the frame in place.
+  // Empty if the model was skipped and the colour detector had no answer.
+  std::optional<ClassificationModel::Detection> detect(cv::Mat& rgb_image, bool run_model = true) {
+    m_detection_box.reset();
+    if (m_cone_detector) {
+      auto candidates = m_cone_detector->propose(rgb_image);
+      if (not candidates.empty() and candidates.front().score >= m_cone_detector->params().direct_score) {
+        m_detection_box.emplace(candidates.front().box);
+        return ClassificationModel::Detection::CONE;
+      }
+    }
+    if (not run_model) return std::nullopt;
+    auto detection = classify(m_detector, rgb_image, m_detector_threshold);
+    if (detection != ClassificationModel::Detection::NONE) m_detection_box.emplace(get_bounding_box(m_detector));
+    return detection;
+  }
+  static bool matches(Objective::Type objective, ClassificationModel::Detection d) {
+    switch (objective) {
+      case Objective::Type::ARROW_LEFT:
+        return d == ClassificationModel::Detection::ARROW_LEFT or d == ClassificationModel::Detection::ARUCO;
+      case Objective::Type::ARROW_RIGHT: return d == ClassificationModel::Detection::ARROW_RIGHT;
+      case Objective::Type::CONE: return d == ClassificationModel::Detection::CONE;
+      default: return false;
+    }
+  }
+  // Finds the objective being approached in this frame: cones by colour when
+  // the pre-detector is on, everything else with the model
+  auto sight_objective(cv::Mat& rgb_image, const DepthView& depth_image, bool run_model = true) -> std::optional<ObjectiveSighting> {
+    const auto type = m_objectives[*m_current_obj].type;
+    std::optional<cv::Rect> box;
+    if (type == Objective::Type::CONE and m_cone_detector) {
+      auto candidates = m_cone_detector->propose(rgb_image);
+      // Any other orange blob would drag the cone, and the range, with it
+      if (auto cone = follow_cone(candidates, m_cone_box, rgb_image.cols, m_cone_detector->params())) {
+        m_cone_box = cone->box;
+        box.emplace(cone->box);
+      }
+    } else if (m_track_objective and run_model) {
+      if (matches(type, classify(m_detector, rgb_image, m_detector_threshold))) box.emplace(get_bounding_box(m_detector));
+    }
+    if (not box) return std::nullopt;
+    auto dist = get_depth_lock(depth_image, *box);
+    if (not dist) return std::nullopt;
+    return ObjectiveSighting{ *box, *dist };
+  }
+  // Re-ranges the cone being approached, so the target tracks it at camera
+  // rate instead of relying on the range from when it was sighted
+  bool refine_cone(const ObjectiveSighting& sighting) {
+    auto& cone = m_objectives[*m_current_obj];
+    float heading_radian = (m_current_heading_deg*M_PI) / 180.0f;
+    Vector3f location = m_current_pos + sighting.range*Vector3f(std::cos(heading_radian), std::sin(heading_radian), 0.0f);
+    if (cone.distance_to(location) < m_cone_refine_threshold) return false;
+    cone.location = location;
+    anchor_global(cone);
+    m_current_dist_to_obj.emplace(sighting.range);
+    spdlog::info("Cone re-ranged at {}m", sighting.range);
+    return true;
+  }
+
+  void set_outputs(ImpureInterface& i, std::optional<float> yaw = {}, int delay_sec = 0, bool send_obj = false) {
     i.output = { .delay_sec = delay_sec,
                  .target_xyz_pos_local = Vector3f(0, 0, 0),
                  .yaw = yaw };
     if (send_obj and m_current_obj) {
       i.output.target_xyz_pos_local = m_objectives[*m_current_obj].location;
+      i.output.target_lat_lon_alt = m_objectives[*m_current_obj].global;
     }
   }
+  void anchor_global(Objective& o) {
+    if (not m_tangent_plane or not m_local_offset) return;
+    o.global.emplace(m_tangent_plane->to_global(o.location - *m_local_offset));
+  }
+  void rebase_objectives() {
+    for (auto& o : m_objectives) {
+      if (o.global) o.location = m_tangent_plane->to_ned(*o.global) + *m_local_offset;
+    }
+    m_resend_target = true;
+  }
+  void update_global_state(const tLatLonAlt& lla, const std::optional<tLatLonAlt>& ekf_origin) {
+    if (not m_tangent_plane) {
+      m_tangent_plane.emplace(lla);
+      spdlog::info("Tangent plane origin at {}, {}", lla[0], lla[1]);
+    }
+    if (ekf_origin) {
+      // The local frame is the EKF origin's NED frame, so the offset follows
+      // from the origin alone and only moves when the origin does
+      if (m_ekf_origin == ekf_origin) return;
+      if (m_ekf_origin) spdlog::critical("EKF origin moved to {}, {}, rebasing objectives", (*ekf_origin)[0], (*ekf_origin)[1]);
+      const bool first = not m_local_offset;
+      m_ekf_origin = ekf_origin;
+      m_local_offset.emplace(-m_tangent_plane->to_ned(*ekf_origin));
+      rebase_objectives();
+      if (first) {
+        for (auto& o : m_objectives) {
+          if (not o.global) anchor_global(o);
+        }
+      }
+      return;
+    }
+    // Local and global positions come from different streams, so they are
+    // only compared horizontally, where GPS altitude noise can't trip it
+    Vector3f local_offset = m_current_pos - m_tangent_plane->to_ned(lla);
+    if (not m_local_offset) {
+      m_local_offset.emplace(local_offset);
+      // Objectives restored from a checkpoint already know where they are
+      rebase_objectives();
+      for (auto& o : m_objectives) {
+        if (not o.global) anchor_global(o);
+      }
+      return;
+    }
+    const float jump = (local_offset - *m_local_offset).head<2>().norm();
+    if (jump < m_origin_jump_threshold) return;
+    spdlog::critical("Local origin moved by {}m, rebasing objectives", jump);
+    m_local_offset.emplace(local_offset);
+    rebase_objectives();
+  }
   void update_state(const ImpureInterface::InputState& i) {
     m_current_pos = Vector3f(i.xyz[0], i.xyz[1], i.xyz[2]);
     m_current_heading_deg = i.heading_deg;
     spdlog::debug("Got heading {}",m_current_heading_deg);
+    if (i.lat_lon_alt) update_global_state(*i.lat_lon_alt, i.ekf_origin);
     if (m_current_obj) {
       m_current_dist_to_obj.emplace(m_objectives[*m_current_obj].distance_to(m_current_pos));
     }
   }
-  bool seek(cv::Mat& rgb_image, rs2::depth_frame& depth_image, bool strong_only = false) {
+  bool seek(cv::Mat& rgb_image, const DepthView& depth_image, bool strong_only = false, bool run_model = true) {
     // What happens when an objective is detected
+    auto detected = detect(rgb_image, run_model);
+    // Nothing was looked at, so there is nothing to vote on or head towards
+    if (not detected) return false;
 
-    if (auto type_detected = classify(m_detector, rgb_image, m_detector_threshold); type_detected == ClassificationModel::Detection::NONE) {
+    if (auto type_detected = *detected; type_detected == ClassificationModel::Detection::NONE) {
       if (not m_detections.empty()) m_detections.pop_front();
       if (strong_only) return true;
       float target_heading_deg = m_current_heading_deg;
@@ -125,6 +284,7 @@ class ArrowStateMachine {
       m_objectives.emplace_back(Objective::Type::DIRECTION, m_current_heading_deg, target_heading_deg);
       float heading_radian = (m_current_heading_deg*M_PI) / 180.0f;
       m_objectives.back().location = m_current_pos + m_waypoint_distance*Vector3f(std::cos(heading_radian), std::sin(heading_radian), 0.0f); 
+      anchor_global(m_objectives.back());
       m_current_obj.emplace(m_objectives.size()-1);
       spdlog::critical("Setting waypoint");
       return true;
@@ -151,14 +311,18 @@ class ArrowStateMachine {
       } else {
         return true;
       }
+      // Votes are spent on this objective, they must not carry over to the next
+      m_detections.clear();
     }
     m_current_obj.emplace(m_objectives.size() - 1);
     // Try to estimate position
-    cv::Rect bb = get_bounding_box(m_detector);
+    cv::Rect bb = *m_detection_box;
+    m_cone_box = bb;
     if (auto dist = get_depth_lock(depth_image, bb); dist.has_value()) {
       // Set target location to this distance
       float heading_radian = (m_current_heading_deg*M_PI) / 180.0f;
       m_objectives.back().location = m_current_pos + *dist*Vector3f(std::cos(heading_radian), std::sin(heading_radian), 0.0f); 
+      anchor_global(m_objectives.back());
       spdlog::critical("Target at {}m away", *dist);
       // Set yaw target
       return true;
@@ -171,25 +335,40 @@ class ArrowStateMachine {
     }
   }
   public:
-  bool next(ImpureInterface& i, cv::Mat& rgb_image, rs2::depth_frame& depth_image) {
+  // Without run_model the network is skipped for this frame, as when the tick
+  // is running late; only the colour detector looks at it
+  bool next(ImpureInterface& i, cv::Mat& rgb_image, const DepthView& depth_image, bool run_model = true) {
     update_state(i.input);
     if (m_current_obj) {
+      if (m_resend_target) set_outputs(i, {}, 0, true);
+      m_resend_target = false;
 
       if (m_objectives[*m_current_obj].type == Objective::Type::DIRECTION) {
-        seek(rgb_image, depth_image, true);
+        seek(rgb_image, depth_image, true, run_model);
         if (m_objectives[*m_current_obj].type != Objective::Type::DIRECTION) {
-          set_outputs(i, 0, 0, true);
+          set_outputs(i, {}, 0, true);
           return false;
         }
       }
+      const auto type = m_objectives[*m_current_obj].type;
+      std::optional<ObjectiveSighting> sighting;
+      if (type != Objective::Type::DIRECTION and ((type == Objective::Type::CONE and m_cone_detector) or m_track_objective)) {
+        sighting = sight_objective(rgb_image, depth_image, run_model);
+      }
+      if (sighting and type == Objective::Type::CONE and m_cone_detector and refine_cone(*sighting)) {
+        set_outputs(i, {}, 0, true);
+      }
+      // Measured range beats the one dead reckoned from where it was sighted
+      if (sighting) m_current_dist_to_obj.emplace(sighting->range);
       // if objective reached, then set new target heading
       if (m_current_dist_to_obj < m_waypoint_threshold) {
         spdlog::critical("Current target reached");
         if (m_objectives[*m_current_obj].type == Objective::Type::CONE) return true;
         float heading_target = m_objectives[*m_current_obj].target_heading;
+        auto reached_type = m_objectives[*m_current_obj].type;
         int delay = 10;
         m_current_obj.reset();
-        if (m_objectives[*m_current_obj].type == Objective::Type::DIRECTION) {
+        if (reached_type == Objective::Type::DIRECTION) {
           delay = 0;
           // heading_target = 0;
         }
@@ -197,13 +376,66 @@ class ArrowStateMachine {
         return false;
       }
       spdlog::info("Distance to target: {}", *m_current_dist_to_obj);
+      if (m_track_objective) i.output.sighting = sighting;
       return false;
     } else {
-      set_outputs(i, 0, 0,
-      seek(rgb_image, depth_image));
+      set_outputs(i, {}, 0,
+      seek(rgb_image, depth_image, false, run_model));
       return false;
     }
   }
+  auto snapshot() const -> MissionSnapshot {
+    MissionSnapshot s{};
+    // Keep the most recent objectives if the course outgrows the snapshot
+    size_t first = m_objectives.size() > s.objectives.size() ? m_objectives.size() - s.objectives.size() : 0;
+    s.objective_count = m_objectives.size() - first;
+    s.current_objective = (m_current_obj and *m_current_obj >= int(first)) ? *m_current_obj - first : -1;
+    for (size_t i = first; i < m_objectives.size(); i++) {
+      const auto& o = m_objectives[i];
+      auto& r = s.objectives[i - first];
+      r.type = static_cast<uint8_t>(o.type);
+      r.has_global = o.global.has_value();
+      r.approach_heading = o.approach_heading;
+      r.target_heading = o.target_heading;
+      r.location = { o.location[0], o.location[1], o.location[2] };
+      if (o.global) r.global = *o.global;
+    }
+    s.detection_count = std::min(m_detections.size(), s.detections.size());
+    for (size_t i = 0; i < s.detection_count; i++) {
+      s.detections[i] = static_cast<uint8_t>(m_detections[i]);
+    }
+    return s;
+  }
+  void restore(const MissionSnapshot& s) {
+    m_objectives.clear();
+    for (size_t i = 0; i < std::min<size_t>(s.objective_count, s.objectives.size()); i++) {
+      const auto& r = s.objectives[i];
+      auto& o = m_objectives.emplace_back(static_cast<Objective::Type>(r.type), r.approach_heading, r.target_heading);
+      o.location = Vector3f(r.location[0], r.location[1], r.location[2]);
+      if (r.has_global) o.global.emplace(r.global);
+    }
+    m_current_obj.reset();
+    if (s.current_objective >= 0 and size_t(s.current_objective) < m_objectives.size()) {
+      m_current_obj.emplace(s.current_objective);
+    }
+    m_detections.clear();
+    for (size_t i = 0; i < std::min<size_t>(s.detection_count, s.detections.size()); i++) {
+      m_detections.push_back(static_cast<ClassificationModel::Detection>(s.detections[i]));
+    }
+    m_resend_target = true;
+    spdlog::info("Restored {} objectives, current target {}", m_objectives.size(), s.current_objective);
+  }
+  void set_cone_detector(const ConeColorParams& params) {
+    m_cone_detector.emplace(params);
+  }
+  // Retuning while running; waypoints already placed keep their spacing
+  void set_thresholds(float detection_threshold, float wp_threshold, float wp_distance) {
+    m_detector_threshold = detection_threshold;
+    m_waypoint_threshold = wp_threshold;
+    m_waypoint_distance = wp_distance;
+  }
+  // Report the objective's box and range in every frame of the approach
+  void set_objective_tracking(bool track) { m_track_objective = track; }
   ArrowStateMachine(ClassificationModel& m, float detection_threshold = 0.6f, int detection_buffer_len = 5, float wp_threshold = 2.0f, float wp_distance = 2.0f)
     : m_detector(std::move(m))
     , m_detector_threshold(detection_threshold), m_detections(detection_buffer_len),
@@ -56,6 +56,11 @@ public:
         return m_bounding_box;
     }
 
+    // Marker decoding is all-or-nothing
+    friend float model_get_confidence(const ArucoDetector& detector) {
+        return 1.0f;
+    }
+
 
     std::pair<cv::Vec3d, cv::Vec3d> get_pose() {
         assert(!m_detection_result.ids.empty() && "No markers detected");
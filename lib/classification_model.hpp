@@ -1,7 +1,32 @@
 #pragma once
 
 #include <opencv4/opencv2/opencv.hpp>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <type_traits>
+
+// Wall time of one classify() split into stages, for benchmarking
+struct StageTimings {
+  std::chrono::nanoseconds pre{0};
+  std::chrono::nanoseconds infer{0};
+  std::chrono::nanoseconds post{0};
+};
+// Call lap() after preprocessing and after inference, post is taken on return
+class StageClock {
+  StageTimings& m_out;
+  std::chrono::steady_clock::time_point m_last = std::chrono::steady_clock::now();
+  int m_stage = 0;
+
+  public:
+  explicit StageClock(StageTimings& out) : m_out(out) { m_out = {}; }
+  void lap() {
+    auto now = std::chrono::steady_clock::now();
+    (m_stage++ == 0 ? m_out.pre : m_out.infer) = now - m_last;
+    m_last = now;
+  }
+  ~StageClock() { m_out.post = std::chrono::steady_clock::now() - m_last; }
+};
 class ClassificationModel {
   public:
   enum class Detection {
@@ -18,6 +43,9 @@ class ClassificationModel {
     virtual ~dClassification() {}
     virtual Detection classify(cv::Mat& image, float threshold) = 0;
     virtual cv::Rect get_bounding_box() = 0;
+    virtual float get_confidence() = 0;
+    virtual StageTimings get_timings() = 0;
+    virtual std::unique_ptr<dClassification> replicate() const = 0;
   };
 
   template <typename T>
@@ -29,6 +57,25 @@ class ClassificationModel {
     cv::Rect get_bounding_box() override {
       return model_get_bounding_box(m_value);
     }
+    float get_confidence() override {
+      return model_get_confidence(m_value);
+    }
+    StageTimings get_timings() override {
+      if constexpr (requires(const T& t) { model_get_timings(t); }) {
+        return model_get_timings(m_value);
+      } else {
+        return {}; // Model does not split its stages
+      }
+    }
+    std::unique_ptr<dClassification> replicate() const override {
+      if constexpr (requires(const T& t) { model_replicate(t); }) {
+        return std::make_unique<cClassification<T>>(model_replicate(m_value));
+      } else if constexpr (std::is_copy_constructible_v<T>) {
+        return std::make_unique<cClassification<T>>(T(m_value));
+      } else {
+        return nullptr;
+      }
+    }
 
     cClassification(T&& t) : m_value(std::move(t)) {}
     T m_value;
@@ -39,10 +86,36 @@ class ClassificationModel {
   friend cv::Rect get_bounding_box(const ClassificationModel& model) {
     return model.m_value->get_bounding_box();
   }
+  // Score of the last detection, only valid when classify found something
+  friend float get_confidence(const ClassificationModel& model) {
+    return model.m_value->get_confidence();
+  }
+  friend StageTimings get_timings(const ClassificationModel& model) {
+    return model.m_value->get_timings();
+  }
+  // Another instance sharing the loaded weights but with its own buffers, so
+  // each thread can classify on its own copy. Empty if the model can't be shared.
+  friend std::optional<ClassificationModel> replicate(const ClassificationModel& model) {
+    auto value = model.m_value->replicate();
+    if (not value) return std::nullopt;
+    return ClassificationModel(std::move(value));
+  }
   std::unique_ptr<dClassification> m_value;
 
+  explicit ClassificationModel(std::unique_ptr<dClassification> value) : m_value(std::move(value)) {}
+
   public:
   template <typename T>
   ClassificationModel(T t) : m_value{new cClassification<T>(std::move(t))}{
   }
 };
+
+constexpr const char* to_string(ClassificationModel::Detection d) {
+  switch (d) {
+    case ClassificationModel::Detection::ARROW_LEFT: return "LEFT";
+    case ClassificationModel::Detection::ARROW_RIGHT: return "RIGHT";
+    case ClassificationModel::Detection::CONE: return "CONE";
+    case ClassificationModel::Detection::ARUCO: return "ARUCO";
+    default: return "NONE";
+  }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Axis-aligned box in pixels, top-left corner and size
+struct EvalBox {
+  float x, y, width, height;
+};
+struct LabeledBox {
+  int cls;
+  EvalBox box;
+};
+struct ScoredBox {
+  int cls;
+  float score;
+  EvalBox box;
+};
+
+inline float iou(const EvalBox& a, const EvalBox& b) {
+  const float ix = std::max(0.0f, std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x));
+  const float iy = std::max(0.0f, std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y));
+  const float intersection = ix * iy;
+  const float union_area = a.width * a.height + b.width * b.height - intersection;
+  return union_area > 0.0f ? intersection / union_area : 0.0f;
+}
+
+// One object per line: "class cx cy w h", coordinates normalized to [0, 1]
+inline std::vector<LabeledBox> parse_yolo_labels(std::istream& in, int image_width, int image_height) {
+  std::vector<LabeledBox> labels;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    LabeledBox l;
+    float cx, cy, w, h;
+    if (not (fields >> l.cls >> cx >> cy >> w >> h)) continue;
+    l.box = { (cx - w / 2) * image_width, (cy - h / 2) * image_height, w * image_width, h * image_height };
+    labels.push_back(l);
+  }
+  return labels;
+}
+
+struct ClassMetrics {
+  size_t ground_truths = 0;
+  size_t true_positives = 0;
+  size_t false_positives = 0;
+  float precision = 0.0f; // At the threshold predictions were made with
+  float recall = 0.0f;
+  float average_precision = 0.0f; // Area under the interpolated PR curve
+  float mean_iou = 0.0f; // Over true positives
+};
+
+// Accumulates predictions and ground truth image by image (from any thread)
+// and scores them PASCAL VOC style: per class, predictions are ranked by
+// score and greedily matched to the unmatched truth box of highest IoU, and
+// AP is the all-point interpolated area under the precision-recall curve.
+class DetectionEvaluator {
+  struct Prediction {
+    size_t image;
+    ScoredBox box;
+  };
+  int m_classes;
+  float m_iou_threshold;
+  mutable std::mutex m_mutex;
+  std::vector<Prediction> m_predictions;
+  std::map<size_t, std::vector<LabeledBox>> m_truths;
+
+  public:
+  explicit DetectionEvaluator(int classes, float iou_threshold = 0.5f)
+    : m_classes(classes), m_iou_threshold(iou_threshold) {}
+
+  void add_image(size_t image, std::span<const LabeledBox> truths, std::span<const ScoredBox> predictions) {
+    std::lock_guard lock(m_mutex);
+    auto& t = m_truths[image];
+    t.insert(t.end(), truths.begin(), truths.end());
+    for (const auto& p : predictions) m_predictions.push_back({ image, p });
+  }
+  size_t images() const {
+    std::lock_guard lock(m_mutex);
+    return m_truths.size();
+  }
+
+  std::vector<ClassMetrics> evaluate() const {
+    std::lock_guard lock(m_mutex);
+    std::vector<ClassMetrics> metrics(m_classes);
+    for (int cls = 0; cls < m_classes; cls++) {
+      auto& m = metrics[cls];
+      std::map<size_t, std::vector<bool>> matched;
+      for (const auto& [image, truths] : m_truths) {
+        matched[image].assign(truths.size(), false);
+        m.ground_truths += std::count_if(truths.begin(), truths.end(),
+                                         [cls](const LabeledBox& l) { return l.cls == cls; });
+      }
+      std::vector<const Prediction*> ranked;
+      for (const auto& p : m_predictions) {
+        if (p.box.cls == cls) ranked.push_back(&p);
+      }
+      std::stable_sort(ranked.begin(), ranked.end(), [](auto a, auto b) { return a->box.score > b->box.score; });
+
+      std::vector<float> precision, recall;
+      float iou_sum = 0.0f;
+      for (const auto* p : ranked) {
+        const auto& truths = m_truths.at(p->image);
+        auto& used = matched[p->image];
+        int best = -1;
+        float best_iou = m_iou_threshold;
+        for (size_t i = 0; i < truths.size(); i++) {
+          if (truths[i].cls != cls or used[i]) continue;
+          if (float o = iou(p->box.box, truths[i].box); o >= best_iou) {
+            best = i;
+            best_iou = o;
+          }
+        }
+        if (best >= 0) {
+          used[best] = true;
+          m.true_positives++;
+          iou_sum += best_iou;
+        } else {
+          m.false_positives++;
+        }
+        precision.push_back(float(m.true_positives) / (m.true_positives + m.false_positives));
+        recall.push_back(m.ground_truths ? float(m.true_positives) / m.ground_truths : 0.0f);
+      }
+      if (not ranked.empty()) m.precision = precision.back();
+      if (not recall.empty()) m.recall = recall.back();
+      if (m.true_positives) m.mean_iou = iou_sum / m.true_positives;
+      // Precision envelope from the right, then integrate over recall steps
+      for (size_t i = precision.size(); i-- > 1;) precision[i - 1] = std::max(precision[i - 1], precision[i]);
+      float last_recall = 0.0f;
+      for (size_t i = 0; i < precision.size(); i++) {
+        m.average_precision += (recall[i] - last_recall) * precision[i];
+        last_recall = recall[i];
+      }
+    }
+    return metrics;
+  }
+  // Mean over classes that appear in the ground truth
+  static float mean_average_precision(std::span<const ClassMetrics> metrics) {
+    float sum = 0.0f;
+    int n = 0;
+    for (const auto& m : metrics) {
+      if (not m.ground_truths) continue;
+      sum += m.average_precision;
+      n++;
+    }
+    return n ? sum / n : 0.0f;
+  }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <opencv4/opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+
+#include "classification_model.hpp"
+#include "pipeline_queue.hpp"
+
+// What one classify() call found, copied out of the instance that ran it
+struct DetectionResult {
+  ClassificationModel::Detection detection = ClassificationModel::Detection::NONE;
+  cv::Rect box; // Only set when something was detected
+  float confidence = 0.0f;
+  StageTimings timings;
+};
+
+// Replicas of one model, each on its own thread with its own input and output
+// buffers, sharing the loaded weights. submit() queues a frame for whichever
+// replica is free next; once queue_depth frames are waiting it blocks, so a
+// producer faster than the pool is held back rather than piling up frames.
+class DetectorPool {
+  struct Job {
+    cv::Mat frame;
+    float threshold;
+    std::promise<DetectionResult> result;
+  };
+  BoundedQueue<Job> m_jobs;
+  std::vector<std::jthread> m_workers;
+
+  static void work(ClassificationModel model, BoundedQueue<Job>& jobs) {
+    while (auto job = jobs.pop()) {
+      try {
+        DetectionResult r;
+        r.detection = classify(model, job->frame, job->threshold);
+        if (r.detection != ClassificationModel::Detection::NONE) {
+          r.box = get_bounding_box(model);
+          r.confidence = get_confidence(model);
+        }
+        r.timings = get_timings(model);
+        job->result.set_value(r);
+      }
+      catch (...) {
+        job->result.set_exception(std::current_exception());
+      }
+    }
+  }
+
+  public:
+  // queue_depth 0 allows one waiting frame per replica
+  DetectorPool(ClassificationModel model, int instances, size_t queue_depth = 0)
+    : m_jobs(queue_depth ? queue_depth : std::max(1, instances))
+  {
+    std::vector<ClassificationModel> replicas;
+    for (int i = 1; i < instances; i++) {
+      auto replica = replicate(model);
+      if (not replica) {
+        spdlog::warn("Model cannot be replicated, detector pool runs a single instance");
+        break;
+      }
+      replicas.push_back(std::move(*replica));
+    }
+    replicas.push_back(std::move(model));
+    for (auto& r : replicas) {
+      m_workers.emplace_back(work, std::move(r), std::ref(m_jobs));
+    }
+  }
+  // Frames already submitted are still classified before the workers exit
+  ~DetectorPool() { m_jobs.close(); }
+
+  // The pool owns the frame from here on: models preprocess in place, so
+  // pass a clone if the caller still needs the original
+  std::future<DetectionResult> submit(cv::Mat frame, float threshold) {
+    Job job{ std::move(frame), threshold, {} };
+    auto result = job.result.get_future();
+    m_jobs.push(std::move(job)); // A dropped job breaks its promise
+    return result;
+  }
+
+  size_t size() const { return m_workers.size(); }
+};
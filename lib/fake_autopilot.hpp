@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/write.hpp>
+
+#include "ardupilot_interface.hpp"
+
+// Stands in for the autopilot: streams the telemetry ArduPilot is asked for
+// and swallows whatever the planner sends
+inline auto fake_autopilot(tcp::socket socket, int rate_hz) -> asio::awaitable<void> {
+  std::vector<uint8_t> stream;
+  auto add = [&](const mavlink_message_t& msg) {
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    auto len = mavlink_msg_to_send_buffer(buffer, &msg);
+    stream.insert(stream.end(), buffer, buffer + len);
+  };
+  mavlink_message_t msg;
+  mavlink_msg_attitude_pack_chan(1, 1, MAVLINK_COMM_1, &msg, 0, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.1f);
+  add(msg);
+  mavlink_msg_global_position_int_pack_chan(1, 1, MAVLINK_COMM_1, &msg, 0, 473977420, 85455940, 500000, 1000, 100, 0, 0, 9000);
+  add(msg);
+  mavlink_msg_local_position_ned_pack_chan(1, 1, MAVLINK_COMM_1, &msg, 0, 1.0f, 2.0f, 0.0f, 0.5f, 0.0f, 0.0f);
+  add(msg);
+
+  asio::steady_timer timer(socket.get_executor());
+  auto sink = [&socket]() -> asio::awaitable<void> {
+    std::array<uint8_t, 1024> discard;
+    while (true) {
+      auto [error, len] = co_await socket.async_read_some(asio::buffer(discard), use_nothrow_awaitable);
+      if (error) co_return;
+    }
+  };
+  asio::co_spawn(socket.get_executor(), sink(), asio::detached);
+  while (true) {
+    auto [error, written] = co_await asio::async_write(socket, asio::buffer(stream), use_nothrow_awaitable);
+    if (error) co_return;
+    timer.expires_after(std::chrono::microseconds(1000000 / rate_hz));
+    co_await timer.async_wait(use_nothrow_awaitable);
+  }
+}
+
+// A MavlinkInterface talking to fake_autopilot over loopback, both on io_ctx
+inline auto loopback_autopilot(asio::io_context& io_ctx, int rate_hz) -> MavlinkInterface<tcp::socket> {
+  tcp::acceptor acceptor(io_ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  tcp::socket planner_side(io_ctx);
+  planner_side.connect(acceptor.local_endpoint());
+  tcp::socket autopilot_side = acceptor.accept();
+  asio::co_spawn(io_ctx, fake_autopilot(std::move(autopilot_side), rate_hz), asio::detached);
+  return MavlinkInterface<tcp::socket>(std::move(planner_side));
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <opencv4/opencv2/core.hpp>
+
+// Frames as the pipeline reads them, borrowed from whoever owns the pixels:
+// a realsense frame (see depth_view() in realsense_generator.hpp), the
+// simulator or a test. Nothing here needs librealsense, so the state machine
+// and obstacle pipeline run on any machine against SyntheticDepth.
+
+// Pinhole intrinsics in pixels; depth is along the optical axis
+struct DepthIntrinsics {
+  float fx = 0.0f, fy = 0.0f;
+  float ppx = 0.0f, ppy = 0.0f;
+
+  // Centred principal point, fov in radians
+  static DepthIntrinsics from_fov(int width, int height, float hfov, float vfov) {
+    return { (width / 2.0f) / std::tan(hfov / 2.0f), (height / 2.0f) / std::tan(vfov / 2.0f),
+             width / 2.0f, height / 2.0f };
+  }
+};
+
+// Z16 depth, 0 where the camera has no data
+struct DepthView {
+  const uint16_t* data = nullptr;
+  int width = 0, height = 0;
+  int stride = 0; // In pixels
+  float units = 0.001f; // Metres per step
+  DepthIntrinsics intrinsics;
+  double timestamp_ms = 0.0;
+
+  const uint16_t* row(int y) const { return data + size_t(y) * stride; }
+  uint16_t raw(int x, int y) const { return row(y)[x]; }
+  // The same accessors as rs2::depth_frame
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+  float get_distance(int x, int y) const { return raw(x, y) * units; }
+};
+
+// BGR8, as the colour stream is configured
+struct ColorView {
+  const uint8_t* data = nullptr;
+  int width = 0, height = 0;
+  int stride = 0; // In bytes
+
+  // Shares the pixels, models preprocess in place
+  cv::Mat mat() const { return cv::Mat(height, width, CV_8UC3, const_cast<uint8_t*>(data), stride); }
+};
+
+// A depth frame built up in code, for tests, benchmarks and the simulator.
+// Unset pixels read as no data.
+class SyntheticDepth {
+  std::vector<uint16_t> m_raw;
+  int m_width, m_height;
+  float m_units;
+  DepthIntrinsics m_intrinsics;
+
+  uint16_t to_raw(float z) const {
+    const float steps = std::round(z / m_units);
+    return std::isfinite(steps) and steps > 0.0f ? uint16_t(std::min(steps, 65535.0f)) : 0;
+  }
+  cv::Rect clip(cv::Rect roi) const { return roi & cv::Rect(0, 0, m_width, m_height); }
+  // Cheap per-pixel hash instead of an RNG draw keeps frames reproducible
+  static uint32_t hash(int x, int y, uint32_t seed) {
+    uint32_t h = (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ seed;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+  }
+
+  public:
+  SyntheticDepth(int width, int height, DepthIntrinsics intrinsics, float units = 0.001f)
+    : m_raw(size_t(width) * height, 0), m_width(width), m_height(height), m_units(units), m_intrinsics(intrinsics) {}
+
+  // Depth z over the whole frame, eg. a wall facing the camera
+  SyntheticDepth& fill(float z) { return fill(cv::Rect(0, 0, m_width, m_height), z); }
+  SyntheticDepth& fill(cv::Rect roi, float z) {
+    roi = clip(roi);
+    const uint16_t value = to_raw(z);
+    for (int y = roi.y; y < roi.br().y; y++) std::fill_n(&m_raw[size_t(y) * m_width + roi.x], roi.width, value);
+    return *this;
+  }
+  // Something at depth z in front of what's already there
+  SyntheticDepth& nearest(cv::Rect roi, float z) {
+    roi = clip(roi);
+    const uint16_t value = to_raw(z);
+    for (int y = roi.y; y < roi.br().y; y++) {
+      for (int x = roi.x; x < roi.br().x; x++) {
+        auto& d = m_raw[size_t(y) * m_width + x];
+        if (d == 0 or value < d) d = value;
+      }
+    }
+    return *this;
+  }
+  // Flat ground camera_height below a level camera, y pointing down
+  SyntheticDepth& ground(float camera_height) {
+    for (int y = std::max(0, int(std::floor(m_intrinsics.ppy)) + 1); y < m_height; y++) {
+      const float ry = (y - m_intrinsics.ppy) / m_intrinsics.fy;
+      nearest(cv::Rect(0, y, m_width, 1), camera_height / ry);
+    }
+    return *this;
+  }
+  // Drops about this fraction of the pixels in roi to no data
+  SyntheticDepth& dropout(float fraction, uint32_t seed = 0) { return dropout(cv::Rect(0, 0, m_width, m_height), fraction, seed); }
+  SyntheticDepth& dropout(cv::Rect roi, float fraction, uint32_t seed = 0) {
+    roi = clip(roi);
+    for (int y = roi.y; y < roi.br().y; y++) {
+      for (int x = roi.x; x < roi.br().x; x++) {
+        if ((hash(x, y, seed) % 1000) < fraction * 1000) m_raw[size_t(y) * m_width + x] = 0;
+      }
+    }
+    return *this;
+  }
+  // Gaussian noise proportional to depth, as stereo error grows with range
+  SyntheticDepth& noise(float relative_sigma, uint32_t seed = 0) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> n(0.0f, relative_sigma);
+    for (auto& d : m_raw) {
+      if (d) d = to_raw(d * m_units * (1.0f + n(rng)));
+    }
+    return *this;
+  }
+
+  DepthView view(double timestamp_ms = 0.0) const {
+    return { m_raw.data(), m_width, m_height, m_width, m_units, m_intrinsics, timestamp_ms };
+  }
+};
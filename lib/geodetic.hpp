@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <Eigen/Dense>
+
+// MAVLink global position: latitude, longitude in degE7, altitude in mm (MSL)
+using tLatLonAlt = std::array<int32_t, 3>;
+
+namespace wgs84 {
+constexpr double SEMI_MAJOR_AXIS_M = 6378137.0;
+constexpr double FLATTENING = 1.0 / 298.257223563;
+constexpr double ECCENTRICITY_SQ = FLATTENING * (2.0 - FLATTENING);
+constexpr double DEG_TO_RAD = M_PI / 180.0;
+constexpr double DEGE7_TO_RAD = DEG_TO_RAD * 1e-7;
+constexpr int64_t HALF_TURN_DEGE7 = 1'800'000'000;
+}
+
+constexpr bool has_global_fix(const tLatLonAlt& lla) {
+  // AP reports 0, 0 until it gets a GPS lock
+  return lla[0] != 0 or lla[1] != 0;
+}
+
+// Flat-earth (local tangent plane) conversion between MAVLink global positions
+// and NED metres around a fixed origin. Curvature radii are evaluated once at
+// the origin, so conversions are only a multiply-add per axis; the error stays
+// below a decimetre within a kilometre of the origin, which covers a course.
+class LocalTangentPlane {
+  tLatLonAlt m_origin;
+  double m_north_m_per_dege7;
+  double m_east_m_per_dege7;
+
+  static constexpr int64_t wrap_longitude(int64_t dlon) {
+    if (dlon > wgs84::HALF_TURN_DEGE7) dlon -= 2 * wgs84::HALF_TURN_DEGE7;
+    else if (dlon < -wgs84::HALF_TURN_DEGE7) dlon += 2 * wgs84::HALF_TURN_DEGE7;
+    return dlon;
+  }
+
+  public:
+  explicit LocalTangentPlane(const tLatLonAlt& origin) : m_origin(origin) {
+    using namespace wgs84;
+    const double lat = origin[0] * DEGE7_TO_RAD;
+    const double sin_lat = std::sin(lat);
+    const double w = 1.0 - ECCENTRICITY_SQ * sin_lat * sin_lat;
+    const double prime_vertical_radius = SEMI_MAJOR_AXIS_M / std::sqrt(w);
+    const double meridional_radius =
+      SEMI_MAJOR_AXIS_M * (1.0 - ECCENTRICITY_SQ) / (w * std::sqrt(w));
+    const double alt_m = origin[2] / 1000.0;
+    m_north_m_per_dege7 = (meridional_radius + alt_m) * DEGE7_TO_RAD;
+    m_east_m_per_dege7 =
+      (prime_vertical_radius + alt_m) * std::cos(lat) * DEGE7_TO_RAD;
+  }
+  auto origin() const -> const tLatLonAlt& { return m_origin; }
+
+  auto to_ned(const tLatLonAlt& lla) const -> Eigen::Vector3f {
+    const int64_t dlat = int64_t(lla[0]) - m_origin[0];
+    const int64_t dlon = wrap_longitude(int64_t(lla[1]) - m_origin[1]);
+    const int64_t dalt = int64_t(lla[2]) - m_origin[2];
+    return Eigen::Vector3f(dlat * m_north_m_per_dege7,
+                           dlon * m_east_m_per_dege7,
+                           -dalt / 1000.0);
+  }
+  auto to_global(const Eigen::Vector3f& ned) const -> tLatLonAlt {
+    int64_t lat = m_origin[0] + std::llround(ned[0] / m_north_m_per_dege7);
+    int64_t lon = wrap_longitude(
+      m_origin[1] + std::llround(ned[1] / m_east_m_per_dege7));
+    int64_t alt = m_origin[2] - std::llround(ned[2] * 1000.0);
+    return { int32_t(lat), int32_t(lon), int32_t(alt) };
+  }
+};
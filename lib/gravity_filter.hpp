@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include <Eigen/Geometry>
+
+// Complementary filter for which way is up in the camera frame. The gyro
+// carries the estimate through motion and every accelerometer sample pulls
+// it a little towards the measured specific force, which points up when the
+// camera isn't accelerating. Samples far from 1 g are skipped as manoeuvres.
+class GravityFilter {
+  static constexpr float G = 9.80665f;
+  float m_accel_weight;
+  float m_accel_tolerance;
+  std::optional<Eigen::Vector3f> m_up;
+  std::optional<double> m_last_gyro_ms;
+
+  public:
+  explicit GravityFilter(float accel_weight = 0.02f, float accel_tolerance = 0.1f)
+    : m_accel_weight(accel_weight), m_accel_tolerance(accel_tolerance) {}
+
+  // Angular rate in rad/s about the camera axes
+  void gyro(const Eigen::Vector3f& rate, double timestamp_ms) {
+    if (m_up and m_last_gyro_ms) {
+      // Gaps beyond a few samples are dropped frames, not motion to integrate
+      const float dt = std::clamp(float(timestamp_ms - *m_last_gyro_ms) / 1000.0f, 0.0f, 0.05f);
+      const float angle = rate.norm() * dt;
+      // The camera turning by +angle turns fixed directions by -angle in its frame
+      if (angle > 0.0f) m_up = (Eigen::AngleAxisf(-angle, rate.normalized()) * *m_up).normalized();
+    }
+    m_last_gyro_ms = timestamp_ms;
+  }
+  // Specific force in m/s², as the accelerometer reports it
+  void accel(const Eigen::Vector3f& specific_force) {
+    const float g = specific_force.norm();
+    if (g == 0.0f) return;
+    if (not m_up) {
+      m_up = specific_force / g;
+      return;
+    }
+    if (std::abs(g - G) > m_accel_tolerance * G) return;
+    m_up = ((1.0f - m_accel_weight) * *m_up + m_accel_weight * specific_force / g).normalized();
+  }
+  // Unit vector opposite gravity, empty until the first accelerometer sample
+  std::optional<Eigen::Vector3f> up() const { return m_up; }
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include <gz/msgs/image.pb.h>
+#include <gz/transport/Node.hh>
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+#include <spdlog/spdlog.h>
+
+#include "realsense_generator.hpp"
+
+// Topics and optics of a Gazebo rgbd camera, eg. the <camera> of an
+// rgbd_camera sensor. Gazebo does not publish intrinsics on the image topics,
+// so they are derived from the horizontal FOV assuming square pixels.
+struct GzCameraParams {
+  std::string color_topic = "/camera/image";
+  std::string depth_topic = "/camera/depth_image";
+  int width = 640;
+  int height = 480;
+  int fps = 30;
+  float hfov = 1.047f; // radians, Gazebo's default
+};
+
+namespace gz_frame_detail {
+// librealsense only hands the frame deleter the pixel pointer, so messages whose
+// payload is lent to a frame are parked here and looked up by that pointer.
+class ParkedImages {
+  std::mutex m_mutex;
+  std::unordered_map<const void*, std::unique_ptr<gz::msgs::Image>> m_images;
+
+  public:
+  void* park(std::unique_ptr<gz::msgs::Image> image) {
+    void* pixels = image->mutable_data()->data();
+    std::lock_guard lock(m_mutex);
+    m_images.emplace(pixels, std::move(image));
+    return pixels;
+  }
+  void release(void* pixels) {
+    std::unique_ptr<gz::msgs::Image> image;
+    {
+      std::lock_guard lock(m_mutex);
+      auto it = m_images.find(pixels);
+      if (it == m_images.end()) return;
+      image = std::move(it->second);
+      m_images.erase(it);
+    }
+  }
+};
+inline ParkedImages& parked_images() {
+  static ParkedImages images;
+  return images;
+}
+inline void release_parked(void* pixels) { parked_images().release(pixels); }
+inline void release_u8(void* pixels) { delete[] static_cast<uint8_t*>(pixels); }
+inline void release_u16(void* pixels) { delete[] static_cast<uint16_t*>(pixels); }
+
+// 0 for formats GzFrameSource doesn't take
+inline int bytes_per_pixel(gz::msgs::PixelFormatType format) {
+  switch (format) {
+    case gz::msgs::PixelFormatType::BGR_INT8:
+    case gz::msgs::PixelFormatType::RGB_INT8:
+      return 3;
+    case gz::msgs::PixelFormatType::R_FLOAT32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+inline rs2_time_t stamp_ms(const gz::msgs::Image& image) {
+  const auto& stamp = image.header().stamp();
+  return stamp.sec() * 1e3 + stamp.nsec() * 1e-6;
+}
+}
+
+// Subscribes to a Gazebo camera and depth camera and injects the images into a
+// librealsense software device, so consumers get genuine rs2::frames (including
+// pointcloud and filter support) through RealsenseDevice. BGR colour images are
+// handed to librealsense without copying; depth is converted from float metres
+// to Z16 millimetres.
+class GzFrameSource {
+  GzCameraParams m_params;
+  rs2_intrinsics m_intrinsics;
+  rs2::software_device m_dev;
+  rs2::software_sensor m_depth_sensor;
+  rs2::software_sensor m_color_sensor;
+  rs2::stream_profile m_depth_profile;
+  rs2::stream_profile m_color_profile;
+  rs2::syncer m_sync;
+  gz::transport::Node m_node;
+  std::atomic<int> m_depth_count = 0;
+  std::atomic<int> m_color_count = 0;
+  std::atomic<int> m_dropped = 0;
+
+  static auto make_intrinsics(const GzCameraParams& p) -> rs2_intrinsics {
+    const float focal = p.width / (2.0f * std::tan(p.hfov / 2.0f));
+    return { p.width, p.height, p.width / 2.0f, p.height / 2.0f, focal, focal,
+             RS2_DISTORTION_NONE, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } };
+  }
+  bool parse(const char* data, size_t size, gz::msgs::Image& image) {
+    if (not image.ParseFromArray(data, size)) return false;
+    if (int(image.width()) != m_params.width or int(image.height()) != m_params.height) {
+      if (m_dropped++ == 0) {
+        spdlog::error("Gazebo image is {}x{}, expected {}x{}: dropping frames",
+                      image.width(), image.height(), m_params.width, m_params.height);
+      }
+      return false;
+    }
+    // Frames are read as tightly packed rows, so padded or truncated
+    // payloads would be read past their end
+    const int bpp = gz_frame_detail::bytes_per_pixel(image.pixel_format_type());
+    const size_t step = size_t(m_params.width) * bpp;
+    if (bpp and (image.step() != step or image.data().size() < step * m_params.height)) {
+      if (m_dropped++ == 0) {
+        spdlog::error("Gazebo image has step {} and {} bytes, expected step {} and {}: dropping frames",
+                      image.step(), image.data().size(), step, step * m_params.height);
+      }
+      return false;
+    }
+    return true;
+  }
+  void inject(rs2::software_sensor& sensor, const rs2::stream_profile& profile,
+              void* pixels, void (*deleter)(void*), int bpp, rs2_time_t timestamp,
+              int frame_number) {
+    rs2_software_video_frame frame{};
+    frame.pixels = pixels;
+    frame.deleter = deleter;
+    frame.stride = m_params.width * bpp;
+    frame.bpp = bpp;
+    frame.timestamp = timestamp;
+    frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+    frame.frame_number = frame_number;
+    frame.profile = profile.get();
+    sensor.on_video_frame(frame);
+  }
+
+  void on_color(const char* data, size_t size) {
+    auto image = std::make_unique<gz::msgs::Image>();
+    if (not parse(data, size, *image)) return;
+    const rs2_time_t timestamp = gz_frame_detail::stamp_ms(*image);
+    const int frame_number = m_color_count++;
+    switch (image->pixel_format_type()) {
+      case gz::msgs::PixelFormatType::BGR_INT8: {
+        void* pixels = gz_frame_detail::parked_images().park(std::move(image));
+        inject(m_color_sensor, m_color_profile, pixels,
+               gz_frame_detail::release_parked, 3, timestamp, frame_number);
+        break;
+      }
+      case gz::msgs::PixelFormatType::RGB_INT8: {
+        const size_t n = size_t(m_params.width) * m_params.height;
+        const auto* rgb = reinterpret_cast<const uint8_t*>(image->data().data());
+        auto* bgr = new uint8_t[n * 3];
+        for (size_t i = 0; i < n; i++) {
+          bgr[3 * i] = rgb[3 * i + 2];
+          bgr[3 * i + 1] = rgb[3 * i + 1];
+          bgr[3 * i + 2] = rgb[3 * i];
+        }
+        inject(m_color_sensor, m_color_profile, bgr,
+               gz_frame_detail::release_u8, 3, timestamp, frame_number);
+        break;
+      }
+      default:
+        if (m_dropped++ == 0) {
+          spdlog::error("Unsupported Gazebo colour format {}: dropping frames",
+                        int(image->pixel_format_type()));
+        }
+    }
+  }
+  void on_depth(const char* data, size_t size) {
+    gz::msgs::Image image;
+    if (not parse(data, size, image)) return;
+    if (image.pixel_format_type() != gz::msgs::PixelFormatType::R_FLOAT32) {
+      if (m_dropped++ == 0) {
+        spdlog::error("Unsupported Gazebo depth format {}: dropping frames",
+                      int(image.pixel_format_type()));
+      }
+      return;
+    }
+    const size_t n = size_t(m_params.width) * m_params.height;
+    const auto* metres = reinterpret_cast<const float*>(image.data().data());
+    auto* mm = new uint16_t[n];
+    for (size_t i = 0; i < n; i++) {
+      // Gazebo reports out of range as +-inf, librealsense uses 0 for no data
+      const float d = metres[i] * 1000.0f;
+      mm[i] = std::isfinite(d) and d > 0.0f and d < 65535.0f ? uint16_t(d) : 0;
+    }
+    inject(m_depth_sensor, m_depth_profile, mm, gz_frame_detail::release_u16, 2,
+           gz_frame_detail::stamp_ms(image), m_depth_count++);
+  }
+
+  public:
+  explicit GzFrameSource(const GzCameraParams& params)
+    : m_params(params)
+    , m_intrinsics(make_intrinsics(params))
+    , m_depth_sensor(m_dev.add_sensor("Depth"))
+    , m_color_sensor(m_dev.add_sensor("Color")) {
+    m_depth_profile = m_depth_sensor.add_video_stream(
+      { RS2_STREAM_DEPTH, 0, 0, params.width, params.height, params.fps, 2,
+        RS2_FORMAT_Z16, m_intrinsics });
+    m_depth_sensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, 0.001f);
+    m_color_profile = m_color_sensor.add_video_stream(
+      { RS2_STREAM_COLOR, 0, 1, params.width, params.height, params.fps, 3,
+        RS2_FORMAT_BGR8, m_intrinsics });
+    // Gazebo renders both images from the same optical frame
+    m_depth_profile.register_extrinsics_to(
+      m_color_profile, { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } });
+    m_dev.create_matcher(RS2_MATCHER_DEFAULT);
+    m_depth_sensor.open(m_depth_profile);
+    m_color_sensor.open(m_color_profile);
+    m_depth_sensor.start(m_sync);
+    m_color_sensor.start(m_sync);
+  }
+  GzFrameSource(const GzFrameSource&) = delete;
+  GzFrameSource& operator=(const GzFrameSource&) = delete;
+  ~GzFrameSource() {
+    for (const auto& topic : m_node.SubscribedTopics()) m_node.Unsubscribe(topic);
+    m_color_sensor.stop();
+    m_depth_sensor.stop();
+  }
+
+  // Raw subscriptions skip gz-transport's own deserialization into a temporary
+  bool subscribe() {
+    return m_node.SubscribeRaw(
+             m_params.color_topic,
+             [this](const char* data, size_t size, const gz::transport::MessageInfo&) {
+               on_color(data, size);
+             },
+             "gz.msgs.Image") and
+           m_node.SubscribeRaw(
+             m_params.depth_topic,
+             [this](const char* data, size_t size, const gz::transport::MessageInfo&) {
+               on_depth(data, size);
+             },
+             "gz.msgs.Image");
+  }
+  bool poll_for_frames(rs2::frameset* frames) { return m_sync.poll_for_frames(frames); }
+  auto intrinsics() const -> const rs2_intrinsics& { return m_intrinsics; }
+};
+
+// Counterpart of setup_device() for Gazebo; gives back the source and its FOV in radians
+inline auto setup_gz_device(const GzCameraParams& params) noexcept
+  -> tResult<std::tuple<std::shared_ptr<GzFrameSource>, float, float>> {
+  try {
+    auto source = std::make_shared<GzFrameSource>(params);
+    if (not source->subscribe()) {
+      spdlog::error("Could not subscribe to {} and {}", params.color_topic, params.depth_topic);
+      return make_unexpected(DeviceErrc::SimulatorError);
+    }
+    float fov[2];
+    auto intrinsics = source->intrinsics();
+    rs2_fov(&intrinsics, fov);
+    spdlog::info("Gazebo camera {}x{} on {} and {}", params.width, params.height,
+                 params.color_topic, params.depth_topic);
+    return std::make_tuple(source, float(fov[0] * M_PI / 180.0f), float(fov[1] * M_PI / 180.0f));
+  }
+  catch (const std::exception& e) {
+    spdlog::error("Exception in setup_gz_device(): {}", e.what());
+    return make_unexpected(DeviceErrc::LibrsError);
+  }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <spdlog/fmt/fmt.h>
+
+// Metrics are updated from the mission, camera and MAVLink threads without
+// locks and read by the scrape thread, so every value is a relaxed atomic.
+// Nothing on the update path allocates.
+
+class Counter {
+  std::atomic<uint64_t> m_value = 0;
+
+  public:
+  void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+class Gauge {
+  std::atomic<double> m_value = 0.0;
+
+  public:
+  void set(double v) { m_value.store(v, std::memory_order_relaxed); }
+  void add(double v) { m_value.fetch_add(v, std::memory_order_relaxed); }
+  double value() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+// Fixed buckets given by their upper bounds, plus +Inf
+class Histogram {
+  std::vector<double> m_bounds;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+  std::atomic<double> m_sum = 0.0;
+  std::atomic<uint64_t> m_count = 0;
+
+  public:
+  explicit Histogram(std::vector<double> bounds)
+    : m_bounds(std::move(bounds)), m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1]()) {
+    std::sort(m_bounds.begin(), m_bounds.end());
+  }
+  void observe(double v) {
+    const size_t bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), v) - m_bounds.begin();
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  // In seconds, as Prometheus expects times
+  template <typename Rep, typename Period>
+  void observe(std::chrono::duration<Rep, Period> d) {
+    observe(std::chrono::duration<double>(d).count());
+  }
+  const std::vector<double>& bounds() const { return m_bounds; }
+  uint64_t bucket(size_t i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+  double sum() const { return m_sum.load(std::memory_order_relaxed); }
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+};
+
+// 1 ms to 1 s, for stage and inference latencies
+inline std::vector<double> latency_buckets() {
+  return { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.075, 0.1, 0.15, 0.25, 0.5, 1.0 };
+}
+
+// Named metrics rendered in the Prometheus text format. Asking for a name
+// that exists returns the same metric, so each component registers what it
+// updates without coordinating with the others. Metrics live as long as the
+// registry; hold on to the reference rather than looking names up per update.
+class MetricsRegistry {
+  struct Family {
+    std::string help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+  mutable std::mutex m_mutex;
+  std::map<std::string, Family> m_families;
+  std::vector<std::function<void()>> m_collectors;
+
+  Family& family(const std::string& name, const std::string& help) {
+    auto& f = m_families[name];
+    if (f.help.empty()) f.help = help;
+    return f;
+  }
+
+  public:
+  Counter& counter(const std::string& name, const std::string& help) {
+    std::lock_guard lock(m_mutex);
+    auto& f = family(name, help);
+    if (not f.counter) f.counter = std::make_unique<Counter>();
+    return *f.counter;
+  }
+  Gauge& gauge(const std::string& name, const std::string& help) {
+    std::lock_guard lock(m_mutex);
+    auto& f = family(name, help);
+    if (not f.gauge) f.gauge = std::make_unique<Gauge>();
+    return *f.gauge;
+  }
+  Histogram& histogram(const std::string& name, const std::string& help, std::vector<double> bounds = latency_buckets()) {
+    std::lock_guard lock(m_mutex);
+    auto& f = family(name, help);
+    if (not f.histogram) f.histogram = std::make_unique<Histogram>(std::move(bounds));
+    return *f.histogram;
+  }
+  // Runs on the scrape thread before every render, for values that are
+  // cheaper to sample on demand than to keep up to date
+  void on_collect(std::function<void()> collect) {
+    std::lock_guard lock(m_mutex);
+    m_collectors.push_back(std::move(collect));
+  }
+
+  std::string render() const {
+    std::lock_guard lock(m_mutex);
+    for (const auto& collect : m_collectors) collect();
+    std::string out;
+    auto header = [&](const std::string& name, const Family& f, const char* type) {
+      fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, f.help, name, type);
+    };
+    for (const auto& [name, f] : m_families) {
+      if (f.counter) {
+        header(name, f, "counter");
+        fmt::format_to(std::back_inserter(out), "{} {}\n", name, f.counter->value());
+      }
+      if (f.gauge) {
+        header(name, f, "gauge");
+        fmt::format_to(std::back_inserter(out), "{} {}\n", name, f.gauge->value());
+      }
+      if (f.histogram) {
+        header(name, f, "histogram");
+        const auto& h = *f.histogram;
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < h.bounds().size(); i++) {
+          cumulative += h.bucket(i);
+          fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"{}\"}} {}\n", name, h.bounds()[i], cumulative);
+        }
+        cumulative += h.bucket(h.bounds().size());
+        fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"+Inf\"}} {}\n{}_sum {}\n{}_count {}\n",
+                       name, cumulative, name, h.sum(), name, cumulative);
+      }
+    }
+    return out;
+  }
+};
+
+// The process-wide registry
+inline MetricsRegistry& metrics() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+// Resident set size from /proc, sampled at each scrape
+inline void register_process_metrics(MetricsRegistry& registry = metrics()) {
+  auto& rss = registry.gauge("michi_resident_memory_bytes", "Resident set size of the process");
+  registry.on_collect([&rss] {
+    long pages = 0, resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+      if (std::fscanf(statm, "%ld %ld", &pages, &resident) == 2) rss.set(double(resident) * sysconf(_SC_PAGESIZE));
+      std::fclose(statm);
+    }
+  });
+}
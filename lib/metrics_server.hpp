@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/read_until.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/write.hpp>
+#include <spdlog/spdlog.h>
+
+#include "common.hpp"
+#include "expected.hpp"
+#include "metrics.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class MetricsErrc {
+  // 0 implies success
+  BadAddress = 10,
+  BindFailed, // Usually the port is taken
+};
+struct MetricsErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "MetricsServer";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<MetricsErrc>(ev)) {
+      case MetricsErrc::BadAddress:
+      return "metrics address is not host:port";
+      case MetricsErrc::BindFailed:
+      return "could not listen on metrics address";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const MetricsErrCategory metricserrc_category;
+inline std::error_code make_error_code(MetricsErrc e) {
+  return {static_cast<int>(e), metricserrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<MetricsErrc> : true_type {};
+}
+
+// Answers every HTTP request with the registry in the Prometheus text
+// format, eg. `curl rover:9464/metrics`. It runs its own io_context on its
+// own thread, so a slow scraper never holds up the mission or MAVLink. Each
+// connection gets its own coroutine and a deadline for its request, so a
+// client that connects and says nothing can't hold up the next scrape.
+class MetricsServer {
+  static constexpr auto REQUEST_TIMEOUT = std::chrono::seconds(5);
+
+  asio::io_context m_io;
+  asio::ip::tcp::acceptor m_acceptor;
+  MetricsRegistry& m_registry;
+  std::thread m_thread;
+
+  MetricsServer(MetricsRegistry& registry) : m_acceptor(m_io), m_registry(registry) {}
+
+  auto respond(asio::ip::tcp::socket socket) -> asio::awaitable<void> {
+    asio::streambuf request;
+    asio::steady_timer deadline(socket.get_executor());
+    deadline.expires_after(REQUEST_TIMEOUT);
+    // Whatever was asked for, once the headers are in
+    auto result = co_await (asio::async_read_until(socket, request, "\r\n\r\n", use_nothrow_awaitable) ||
+                            deadline.async_wait(use_nothrow_awaitable));
+    if (result.index() != 0) {
+      spdlog::debug("Metrics client sent no request within {}s", REQUEST_TIMEOUT.count());
+      co_return;
+    }
+    auto [read_error, n] = std::get<0>(result);
+    if (read_error) co_return;
+    const std::string body = m_registry.render();
+    const std::string response = fmt::format(
+      "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+      body.size(), body);
+    co_await asio::async_write(socket, asio::buffer(response), use_nothrow_awaitable);
+  }
+
+  auto serve() -> asio::awaitable<void> {
+    while (true) {
+      auto [error, socket] = co_await m_acceptor.async_accept(use_nothrow_awaitable);
+      if (error == asio::error::operation_aborted) co_return;
+      if (error) continue;
+      asio::co_spawn(m_io, respond(std::move(socket)), asio::detached);
+    }
+  }
+
+  public:
+  // address is host:port, port 0 picks a free one
+  static tResult<std::unique_ptr<MetricsServer>> start(const std::string& address, MetricsRegistry& registry = metrics()) {
+    const auto sep = address.rfind(':');
+    if (sep == std::string::npos) return make_unexpected(MetricsErrc::BadAddress);
+    std::error_code error;
+    auto host = asio::ip::make_address(address.substr(0, sep), error);
+    if (error) return make_unexpected(MetricsErrc::BadAddress);
+    unsigned long port;
+    try {
+      port = std::stoul(address.substr(sep + 1));
+    } catch (const std::exception&) {
+      return make_unexpected(MetricsErrc::BadAddress);
+    }
+    if (port > 65535) return make_unexpected(MetricsErrc::BadAddress);
+
+    std::unique_ptr<MetricsServer> server(new MetricsServer(registry));
+    asio::ip::tcp::endpoint endpoint(host, port);
+    server->m_acceptor.open(endpoint.protocol(), error);
+    if (not error) server->m_acceptor.set_option(asio::socket_base::reuse_address(true), error);
+    if (not error) server->m_acceptor.bind(endpoint, error);
+    if (not error) server->m_acceptor.listen(asio::socket_base::max_listen_connections, error);
+    if (error) {
+      spdlog::error("Metrics on {}: {}", address, error.message());
+      return make_unexpected(MetricsErrc::BindFailed);
+    }
+    asio::co_spawn(server->m_io, server->serve(), asio::detached);
+    server->m_thread = std::thread([s = server.get()] { s->m_io.run(); });
+    return server;
+  }
+  ~MetricsServer() {
+    m_io.stop();
+    if (m_thread.joinable()) m_thread.join();
+  }
+  unsigned short port() const { return m_acceptor.local_endpoint().port(); }
+};
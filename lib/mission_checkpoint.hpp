@@ -0,0 +1,190 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+#include "expected.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class CheckpointErrc {
+  // 0 implies success
+  OpenFailed = 10, // Setup error
+  MapFailed,
+  NoValidSnapshot = 20, // Nothing to resume from
+};
+struct CheckpointErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "MissionCheckpoint";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<CheckpointErrc>(ev)) {
+      case CheckpointErrc::OpenFailed:
+      return "could not open or resize checkpoint file";
+      case CheckpointErrc::MapFailed:
+      return "could not memory-map checkpoint file";
+      case CheckpointErrc::NoValidSnapshot:
+      return "checkpoint file holds no complete snapshot";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const CheckpointErrCategory checkpointerrc_category;
+inline std::error_code make_error_code(CheckpointErrc e) {
+  return {static_cast<int>(e), checkpointerrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<CheckpointErrc> : true_type {};
+}
+
+// Plain-old-data image of the mission state, written verbatim into the file
+struct MissionSnapshot {
+  static constexpr size_t MAX_OBJECTIVES = 256;
+  static constexpr size_t MAX_DETECTIONS = 32;
+  struct ObjectiveRecord {
+    uint8_t type;
+    uint8_t has_global;
+    uint8_t reserved[2]; // Explicit padding, snapshots are compared bytewise
+    float approach_heading;
+    float target_heading;
+    std::array<float, 3> location;
+    std::array<int32_t, 3> global;
+  };
+  int32_t current_objective; // -1 when there is no target
+  uint32_t objective_count;
+  uint32_t detection_count;
+  std::array<uint8_t, MAX_DETECTIONS> detections;
+  std::array<ObjectiveRecord, MAX_OBJECTIVES> objectives;
+};
+static_assert(std::is_trivially_copyable_v<MissionSnapshot>);
+
+// Two alternating slots, each sealed by a checksum over its sequence number and
+// payload. A crash mid-write can only tear the slot being written, so the other
+// one is always a complete, earlier snapshot.
+class MissionCheckpoint {
+  static constexpr uint32_t MAGIC = 0x4d434b50; // "MCKP"
+  static constexpr uint32_t VERSION = 1;
+  struct Slot {
+    uint64_t sequence;
+    uint64_t checksum;
+    MissionSnapshot snapshot;
+  };
+  struct File {
+    uint32_t magic;
+    uint32_t version;
+    std::array<Slot, 2> slots;
+  };
+
+  int m_fd = -1;
+  File* m_file = nullptr;
+  uint64_t m_sequence = 0;
+
+  static uint64_t checksum(const Slot& slot) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void* data, size_t len) {
+      auto bytes = static_cast<const uint8_t*>(data);
+      for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+      }
+    };
+    mix(&slot.sequence, sizeof(slot.sequence));
+    mix(&slot.snapshot, sizeof(slot.snapshot));
+    return hash;
+  }
+  auto latest_slot() const -> const Slot* {
+    const Slot* latest = nullptr;
+    for (const auto& slot : m_file->slots) {
+      if (slot.sequence == 0 or slot.checksum != checksum(slot)) continue;
+      if (not latest or slot.sequence > latest->sequence) latest = &slot;
+    }
+    return latest;
+  }
+  MissionCheckpoint(int fd, File* file) : m_fd(fd), m_file(file) {
+    if (auto slot = latest_slot()) m_sequence = slot->sequence;
+  }
+
+  public:
+  static auto open(const std::string& path) -> tResult<MissionCheckpoint> {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      spdlog::error("Could not open checkpoint {}: {}", path, std::strerror(errno));
+      return make_unexpected(CheckpointErrc::OpenFailed);
+    }
+    struct stat st;
+    bool fresh = fstat(fd, &st) != 0 or st.st_size != sizeof(File);
+    if (fresh and ftruncate(fd, sizeof(File)) != 0) {
+      ::close(fd);
+      return make_unexpected(CheckpointErrc::OpenFailed);
+    }
+    void* addr = mmap(nullptr, sizeof(File), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      return make_unexpected(CheckpointErrc::MapFailed);
+    }
+    auto file = static_cast<File*>(addr);
+    if (fresh or file->magic != MAGIC or file->version != VERSION) {
+      spdlog::info("Initializing checkpoint {}", path);
+      std::memset(file, 0, sizeof(File));
+      file->magic = MAGIC;
+      file->version = VERSION;
+    }
+    return MissionCheckpoint(fd, file);
+  }
+  MissionCheckpoint(MissionCheckpoint&& o) noexcept
+    : m_fd(std::exchange(o.m_fd, -1))
+    , m_file(std::exchange(o.m_file, nullptr))
+    , m_sequence(o.m_sequence) {}
+  MissionCheckpoint& operator=(MissionCheckpoint&& o) noexcept {
+    std::swap(m_fd, o.m_fd);
+    std::swap(m_file, o.m_file);
+    m_sequence = o.m_sequence;
+    return *this;
+  }
+  ~MissionCheckpoint() {
+    if (m_file) munmap(m_file, sizeof(File));
+    if (m_fd >= 0) ::close(m_fd);
+  }
+
+  auto load() const -> tResult<MissionSnapshot> {
+    auto slot = latest_slot();
+    if (not slot) return make_unexpected(CheckpointErrc::NoValidSnapshot);
+    return slot->snapshot;
+  }
+  // Returns false when the snapshot is unchanged and nothing was written
+  bool save(const MissionSnapshot& snapshot) {
+    const Slot& last = m_file->slots[m_sequence % 2];
+    if (m_sequence and std::memcmp(&last.snapshot, &snapshot, sizeof(snapshot)) == 0) {
+      return false;
+    }
+    Slot& slot = m_file->slots[(m_sequence + 1) % 2];
+    slot.sequence = 0; // Invalidate before overwriting
+    slot.snapshot = snapshot;
+    slot.sequence = ++m_sequence;
+    slot.checksum = checksum(slot);
+    msync(m_file, sizeof(File), MS_ASYNC);
+    return true;
+  }
+  // Invalidates both slots so a finished mission can't be resumed
+  void clear() {
+    for (auto& slot : m_file->slots) slot.sequence = 0;
+    m_sequence = 0;
+    msync(m_file, sizeof(File), MS_SYNC);
+  }
+};
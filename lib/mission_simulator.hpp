@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <opencv4/opencv2/core.hpp>
+
+#include "arrow_state_machine.hpp"
+#include "classification_model.hpp"
+#include "frame_view.hpp"
+#include "visual_servo.hpp"
+
+// Headless course simulator: synthetic detections and depth ROIs from objects
+// at known poses, a kinematic rover standing in for the autopilot, and the
+// same output handling as mission2, stepped as fast as the CPU allows.
+using Eigen::Vector2f;
+
+struct SimParams {
+  // Camera
+  int image_width = 640;
+  int image_height = 480;
+  float hfov_rad = 1.2043f; // D435 colour, 69°
+  float arrow_range_m = 10.0f;
+  float cone_range_m = 15.0f;
+  float object_size_m = 0.5f;
+  // Detector and depth noise
+  float detection_prob = 0.9f;
+  float confusion_prob = 0.03f;
+  float false_positive_prob = 0.01f;
+  float depth_dropout = 0.1f;
+  float depth_noise_m = 0.05f;
+  // Vehicle
+  float cruise_speed_ms = 1.0f;
+  float yaw_rate_dps = 45.0f;
+  float waypoint_radius_m = 0.3f;
+  float rover_radius_m = 0.4f;
+  // Planner loop, mirroring mission2
+  float tick_s = 0.13f;
+  float turn_wait_s = 4.0f;
+  float initial_velocity_ms = 0.1f;
+  float turning_throttle = 0.1f;
+  bool servo = false; // Visual servoing on approach, as mission2 --servo
+  ServoParams servo_params;
+  // State machine
+  float detector_threshold = 0.5f;
+  int vote_window = 5;
+  float wp_threshold = 2.0f;
+  float wp_distance = 5.0f;
+  // Course
+  int arrows = 4;
+  int obstacles = 3;
+  float leg_min_m = 6.0f;
+  float leg_max_m = 14.0f;
+  float lateral_jitter_m = 0.5f;
+  float timeout_s = 900.0f;
+  float success_radius_m = 3.0f;
+};
+
+struct SimObject {
+  enum class Kind {
+    ARROW_LEFT,
+    ARROW_RIGHT,
+    CONE,
+    OBSTACLE,
+  };
+  Kind kind;
+  Vector2f position; // North, East
+  float radius;
+};
+struct SimCourse {
+  std::vector<SimObject> objects;
+
+  auto cone() const -> const SimObject& {
+    return *std::find_if(objects.begin(), objects.end(), [](const auto& o) {
+      return o.kind == SimObject::Kind::CONE;
+    });
+  }
+};
+
+inline float wrap_heading_deg(float deg) {
+  deg = std::fmod(deg, 360.0f);
+  return deg < 0 ? deg + 360.0f : deg;
+}
+inline Vector2f heading_vector(float heading_deg) {
+  float rad = heading_deg * M_PI / 180.0f;
+  return Vector2f(std::cos(rad), std::sin(rad));
+}
+
+inline float distance_to_segment(const Vector2f& q, const Vector2f& a, const Vector2f& b) {
+  Vector2f ab = b - a;
+  float t = std::clamp((q - a).dot(ab) / ab.squaredNorm(), 0.0f, 1.0f);
+  return (a + t * ab - q).norm();
+}
+
+inline SimCourse random_course(const SimParams& p, std::mt19937& rng) {
+  std::uniform_real_distribution<float> leg(p.leg_min_m, p.leg_max_m);
+  std::normal_distribution<float> jitter(0.0f, p.lateral_jitter_m);
+  std::bernoulli_distribution left(0.5);
+  SimCourse c;
+  // Objectives must stay clear of every leg except their own, otherwise a
+  // later objective can be seen (or reached) from an earlier leg
+  auto self_intersecting = [&] {
+    Vector2f a(0.0f, 0.0f);
+    for (size_t leg_end = 0; leg_end < c.objects.size(); a = c.objects[leg_end++].position) {
+      for (size_t i = 0; i < c.objects.size(); i++) {
+        if (i + 1 >= leg_end and i <= leg_end + 1) continue;
+        if (distance_to_segment(c.objects[i].position, a, c.objects[leg_end].position) < p.leg_min_m) return true;
+      }
+    }
+    return false;
+  };
+  for (int attempt = 0; attempt == 0 or (self_intersecting() and attempt < 100); attempt++) {
+    c.objects.clear();
+    Vector2f pos(0.0f, 0.0f);
+    float heading = 0.0f;
+    auto place = [&](SimObject::Kind kind) {
+      Vector2f dir = heading_vector(heading);
+      pos += leg(rng) * dir + jitter(rng) * Vector2f(-dir[1], dir[0]);
+      c.objects.push_back({ kind, pos, p.object_size_m / 2 });
+    };
+    for (int i = 0; i < p.arrows; i++) {
+      bool is_left = left(rng);
+      place(is_left ? SimObject::Kind::ARROW_LEFT : SimObject::Kind::ARROW_RIGHT);
+      heading = wrap_heading_deg(heading + (is_left ? -90.0f : 90.0f));
+    }
+    place(SimObject::Kind::CONE);
+  }
+
+  // Obstacles go around the course, clear of the legs between objectives
+  Vector2f lo(-5.0f, -5.0f), hi(5.0f, 5.0f);
+  for (const auto& o : c.objects) {
+    lo = lo.cwiseMin(o.position);
+    hi = hi.cwiseMax(o.position);
+  }
+  std::uniform_real_distribution<float> north(lo[0], hi[0]), east(lo[1], hi[1]);
+  const size_t course_objects = c.objects.size();
+  auto clear_of_legs = [&](const Vector2f& q) {
+    Vector2f a(0.0f, 0.0f);
+    for (size_t i = 0; i < course_objects; a = c.objects[i++].position) {
+      if (distance_to_segment(q, a, c.objects[i].position) < 2.0f) return false;
+    }
+    return true;
+  };
+  for (int i = 0, tries = 0; i < p.obstacles and tries < 100 * p.obstacles; tries++) {
+    Vector2f q(north(rng), east(rng));
+    if (not clear_of_legs(q)) continue;
+    c.objects.push_back({ SimObject::Kind::OBSTACLE, q, 0.3f });
+    i++;
+  }
+  return c;
+}
+
+struct SimDetection {
+  ClassificationModel::Detection type;
+  cv::Rect box;
+  float range;
+};
+
+class SimSensor {
+  const SimCourse& m_course;
+  const SimParams& m_params;
+  std::mt19937 m_rng;
+  std::optional<SimDetection> m_detection;
+  uint32_t m_frame = 0;
+
+  static ClassificationModel::Detection to_detection(SimObject::Kind k) {
+    switch (k) {
+      case SimObject::Kind::ARROW_LEFT: return ClassificationModel::Detection::ARROW_LEFT;
+      case SimObject::Kind::ARROW_RIGHT: return ClassificationModel::Detection::ARROW_RIGHT;
+      case SimObject::Kind::CONE: return ClassificationModel::Detection::CONE;
+      default: return ClassificationModel::Detection::NONE;
+    }
+  }
+  bool occluded(const Vector2f& from, const Vector2f& to) const {
+    for (const auto& o : m_course.objects) {
+      if (o.kind != SimObject::Kind::OBSTACLE) continue;
+      if (distance_to_segment(o.position, from, to) < o.radius) return true;
+    }
+    return false;
+  }
+  auto project(float forward, float right) const -> cv::Rect {
+    float fx = 0.5f * m_params.image_width / std::tan(0.5f * m_params.hfov_rad);
+    int size = std::max(2, int(fx * m_params.object_size_m / forward));
+    int u = int(0.5f * m_params.image_width + fx * right / forward);
+    return cv::Rect(u - size / 2, m_params.image_height / 2 - size / 2, size, size);
+  }
+
+  public:
+  SimSensor(const SimCourse& c, const SimParams& p, uint32_t seed)
+    : m_course(c), m_params(p), m_rng(seed) {}
+
+  // Depth frame with the detected object, if any, in view
+  auto observe(const Vector2f& pos, float heading_deg) -> SyntheticDepth {
+    m_frame++;
+    m_detection.reset();
+    Vector2f fwd = heading_vector(heading_deg), right(-fwd[1], fwd[0]);
+    const SimObject* nearest = nullptr;
+    float nearest_range = std::numeric_limits<float>::infinity();
+    for (const auto& o : m_course.objects) {
+      if (o.kind == SimObject::Kind::OBSTACLE) continue;
+      Vector2f d = o.position - pos;
+      float f = d.dot(fwd), r = d.dot(right);
+      float max_range = o.kind == SimObject::Kind::CONE ? m_params.cone_range_m : m_params.arrow_range_m;
+      if (f < 0.3f or d.norm() > max_range) continue;
+      if (std::abs(std::atan2(r, f)) > 0.5f * m_params.hfov_rad) continue;
+      if (d.norm() < nearest_range and not occluded(pos, o.position)) {
+        nearest = &o;
+        nearest_range = d.norm();
+      }
+    }
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    if (nearest) {
+      float max_range = nearest->kind == SimObject::Kind::CONE ? m_params.cone_range_m : m_params.arrow_range_m;
+      // Detection gets less reliable towards the edge of the range
+      if (u(m_rng) < m_params.detection_prob * (1.0f - 0.5f * nearest_range / max_range)) {
+        Vector2f d = nearest->position - pos;
+        auto type = to_detection(nearest->kind);
+        if (u(m_rng) < m_params.confusion_prob) {
+          type = type == ClassificationModel::Detection::ARROW_LEFT ? ClassificationModel::Detection::ARROW_RIGHT
+                                                                     : ClassificationModel::Detection::ARROW_LEFT;
+        }
+        std::normal_distribution<float> noise(0.0f, m_params.depth_noise_m);
+        m_detection.emplace(type, project(d.dot(fwd), d.dot(right)), nearest_range + noise(m_rng));
+      }
+    } else if (u(m_rng) < m_params.false_positive_prob) {
+      std::uniform_int_distribution<int> cls(1, 3);
+      m_detection.emplace(static_cast<ClassificationModel::Detection>(cls(m_rng)),
+                          project(4.0f, 0.0f), 4.0f);
+    }
+    const float vfov = 2.0f * std::atan(std::tan(0.5f * m_params.hfov_rad) * m_params.image_height / m_params.image_width);
+    SyntheticDepth depth(m_params.image_width, m_params.image_height,
+                         DepthIntrinsics::from_fov(m_params.image_width, m_params.image_height, m_params.hfov_rad, vfov));
+    if (m_detection) {
+      depth.fill(m_detection->box, m_detection->range).dropout(m_detection->box, m_params.depth_dropout, m_frame);
+    }
+    return depth;
+  }
+  auto detection() const -> const std::optional<SimDetection>& { return m_detection; }
+};
+
+// Classification model answering from the simulated sensor
+struct SimDetector {
+  std::shared_ptr<SimSensor> sensor;
+
+  friend ClassificationModel::Detection model_classify(SimDetector& sd, cv::Mat& image, float threshold) {
+    auto& d = sd.sensor->detection();
+    return d ? d->type : ClassificationModel::Detection::NONE;
+  }
+  friend cv::Rect model_get_bounding_box(const SimDetector& sd) {
+    assert(sd.sensor->detection().has_value());
+    return sd.sensor->detection()->box;
+  }
+  friend float model_get_confidence(const SimDetector& sd) {
+    return 1.0f;
+  }
+};
+
+// Kinematic stand-in for the autopilot in GUIDED mode
+class SimRover {
+  enum class Mode {
+    HOLD,
+    VELOCITY,
+    POSITION,
+    HEADING,
+    VELOCITY_YAW_RATE,
+  };
+  const SimParams& m_params;
+  Mode m_mode = Mode::HOLD;
+  Vector2f m_target;
+  float m_target_heading = 0.0f;
+  float m_speed = 0.0f;
+  float m_yaw_rate_dps = 0.0f;
+  bool m_in_contact = false;
+
+  void turn_towards(float heading_deg, float dt) {
+    float err = wrap_heading_deg(heading_deg - heading + 180.0f) - 180.0f;
+    float max_turn = m_params.yaw_rate_dps * dt;
+    heading = wrap_heading_deg(heading + std::clamp(err, -max_turn, max_turn));
+  }
+
+  public:
+  Vector2f position = Vector2f(0.0f, 0.0f);
+  float heading = 0.0f;
+  float distance_travelled = 0.0f;
+  int collisions = 0;
+
+  SimRover(const SimParams& p) : m_params(p) {}
+  void hold() { m_mode = Mode::HOLD; }
+  void set_velocity(float v) { m_mode = Mode::VELOCITY; m_speed = v; }
+  void set_position(const Vector2f& t) { m_mode = Mode::POSITION; m_target = t; }
+  void set_velocity_yaw_rate(float v, float yaw_rate_rad) {
+    m_mode = Mode::VELOCITY_YAW_RATE;
+    m_speed = std::min(v, m_params.cruise_speed_ms);
+    m_yaw_rate_dps = std::clamp(float(yaw_rate_rad * 180.0f / M_PI), -m_params.yaw_rate_dps, m_params.yaw_rate_dps);
+  }
+  void set_heading(float h, float throttle) {
+    m_mode = Mode::HEADING;
+    m_target_heading = h;
+    m_speed = throttle * m_params.cruise_speed_ms;
+  }
+  void step(float dt, const SimCourse& course) {
+    float v = 0.0f;
+    switch (m_mode) {
+      case Mode::HOLD:
+        break;
+      case Mode::VELOCITY:
+        v = m_speed;
+        break;
+      case Mode::POSITION: {
+        Vector2f d = m_target - position;
+        if (d.norm() < m_params.waypoint_radius_m) {
+          m_mode = Mode::HOLD;
+          break;
+        }
+        float bearing = std::atan2(d[1], d[0]) * 180.0f / M_PI;
+        turn_towards(bearing, dt);
+        float err = std::abs(wrap_heading_deg(bearing - heading + 180.0f) - 180.0f);
+        if (err < 60.0f) v = std::min(m_params.cruise_speed_ms, d.norm() / dt);
+        break;
+      }
+      case Mode::HEADING:
+        turn_towards(m_target_heading, dt);
+        v = m_speed;
+        break;
+      case Mode::VELOCITY_YAW_RATE:
+        heading = wrap_heading_deg(heading + m_yaw_rate_dps * dt);
+        v = m_speed;
+        break;
+    }
+    position += v * dt * heading_vector(heading);
+    distance_travelled += v * dt;
+    bool contact = false;
+    for (const auto& o : course.objects) {
+      if (o.kind == SimObject::Kind::OBSTACLE and
+          (o.position - position).norm() < o.radius + m_params.rover_radius_m) contact = true;
+    }
+    if (contact and not m_in_contact) collisions++;
+    m_in_contact = contact;
+  }
+};
+
+struct SimResult {
+  enum class Outcome {
+    SUCCESS,
+    STOPPED_SHORT, // State machine declared the cone reached elsewhere
+    TIMEOUT,
+  };
+  Outcome outcome;
+  float mission_time_s;
+  int ticks;
+  int collisions;
+  float distance_m;
+  float cone_distance_m; // Where the rover ended up relative to the cone
+};
+
+inline SimResult run_mission(const SimParams& p, uint32_t seed) {
+  std::mt19937 rng(seed);
+  SimCourse course = random_course(p, rng);
+  auto sensor = std::make_shared<SimSensor>(course, p, seed);
+  ClassificationModel detector(SimDetector{ sensor });
+  ArrowStateMachine sm(detector, p.detector_threshold, p.vote_window, p.wp_threshold, p.wp_distance);
+  SimRover rover(p);
+  std::optional<VisualServo> servo;
+  if (p.servo) {
+    servo.emplace(p.servo_params);
+    sm.set_objective_tracking(true);
+  }
+
+  float t = 0.0f;
+  int ticks = 0, targets = 0;
+  Vector3f last_target(0.0f, 0.0f, 0.0f);
+  cv::Mat image;
+  auto advance = [&](float dt) {
+    const float max_step = 0.05f;
+    for (float done = 0.0f; done < dt; done += max_step) {
+      rover.step(std::min(max_step, dt - done), course);
+    }
+    t += dt;
+  };
+  auto result = [&](SimResult::Outcome outcome) {
+    return SimResult{ outcome, t, ticks, rover.collisions, rover.distance_travelled,
+                      (course.cone().position - rover.position).norm() };
+  };
+
+  while (t < p.timeout_s) {
+    ticks++;
+    auto depth = sensor->observe(rover.position, rover.heading);
+    std::array<float, 3> xyz{ rover.position[0], rover.position[1], 0.0f };
+    ImpureInterface io{ std::span(xyz), rover.heading };
+    if (sm.next(io, image, depth.view())) {
+      bool at_cone = (course.cone().position - rover.position).norm() < p.success_radius_m;
+      return result(at_cone ? SimResult::Outcome::SUCCESS : SimResult::Outcome::STOPPED_SHORT);
+    }
+    if (io.output.delay_sec) {
+      rover.hold();
+      advance(io.output.delay_sec);
+    }
+    if (io.output.target_xyz_pos_local != Vector3f(0.0f, 0.0f, 0.0f) and
+        io.output.target_xyz_pos_local != last_target) {
+      last_target = io.output.target_xyz_pos_local;
+      targets++;
+      rover.set_position(last_target.head<2>());
+    }
+    if (servo and (io.output.yaw or io.output.delay_sec)) {
+      servo->reset();
+    } else if (servo) {
+      std::optional<VisualServo::Sighting> seen;
+      if (const auto& s = io.output.sighting) {
+        seen = VisualServo::Sighting{ pixel_bearing(s->box.x + s->box.width / 2.0f, p.image_width, p.hfov_rad), s->range };
+      }
+      bool was_engaged = servo->engaged();
+      auto now = VisualServo::clock::time_point(std::chrono::duration_cast<VisualServo::clock::duration>(std::chrono::duration<float>(t)));
+      if (auto command = servo->update(seen, now)) {
+        rover.set_velocity_yaw_rate(command->forward, command->yaw_rate);
+      } else if (was_engaged) {
+        rover.set_position(last_target.head<2>());
+      }
+    }
+    if (io.output.yaw) {
+      rover.set_heading(*io.output.yaw, p.turning_throttle);
+      advance(p.turn_wait_s);
+    }
+    if (targets == 0) rover.set_velocity(p.initial_velocity_ms);
+    advance(p.tick_s);
+  }
+  return result(SimResult::Outcome::TIMEOUT);
+}
+
+// Runs `count` randomized courses on `threads` workers; course i uses seed + i
+inline std::vector<SimResult> run_missions(const SimParams& p, int count, uint32_t seed, unsigned threads) {
+  std::vector<SimResult> results(count);
+  std::atomic<int> next{ 0 };
+  std::vector<std::jthread> workers;
+  for (unsigned i = 0; i < std::max(1u, threads); i++) {
+    workers.emplace_back([&] {
+      for (int c = next++; c < count; c = next++) results[c] = run_mission(p, seed + c);
+    });
+  }
+  workers.clear(); // joins
+  return results;
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <iostream>
 #include <librealsense2/rs.hpp>
+#include <memory>
 #include <numeric>
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
@@ -12,6 +13,7 @@
 #include <span>
 #include <spdlog/spdlog.h>
 #include "classification_model.hpp"
+#include "ort_session.hpp"
 
 const std::array<const char*, 1> MOBILENET_ARROW_INPUT_NAMES{ "input_tensor" };
 const std::array<int64_t, 4> MOBILENET_ARROW_INPUT_SHAPE{ 1, 480, 640, 3 };
@@ -45,34 +47,42 @@ std::array<ClassificationModel::Detection, 4> MOHNISH4_CLASSMAP= {
 };
 class MobilenetArrowClassifier
 {
-  Ort::Env m_env;
-  Ort::SessionOptions m_session_options;
-  Ort::Session m_session;
+  std::shared_ptr<Ort::Session> m_session; // Run() is thread safe, replicas share it
 
   Ort::AllocatorWithDefaultOptions m_allocator;
   std::array<Ort::Value, 1> m_input_tensor;
   std::optional<cv::Rect> m_bounding_box;
+  float m_confidence = 0.0f;
+  StageTimings m_timings;
   std::array<ClassificationModel::Detection, 4>& m_result_map;
 
 public:
   MobilenetArrowClassifier(
     std::string const& s,
+    std::array<ClassificationModel::Detection, 4>& class_to_detection_map,
+    const SessionConfig& config = {})
+    : MobilenetArrowClassifier(
+        std::make_shared<Ort::Session>(OrtRuntime::instance(config).make_session(s, config)),
+        class_to_detection_map)
+  {
+    spdlog::info("Initialized and loaded MobilenetArrow ONNX session");
+  }
+  MobilenetArrowClassifier(
+    std::shared_ptr<Ort::Session> session,
     std::array<ClassificationModel::Detection, 4>& class_to_detection_map)
-    : m_env(ORT_LOGGING_LEVEL_WARNING, "MobilenetArrowClassifier")
-    , m_session(m_env, s.c_str(), m_session_options)
+    : m_session(std::move(session))
     , m_input_tensor{ Ort::Value::CreateTensor<uint8_t>(
         m_allocator,
         MOBILENET_ARROW_INPUT_SHAPE.data(),
         MOBILENET_ARROW_INPUT_SHAPE.size()) }
     , m_result_map(class_to_detection_map)
   {
-    spdlog::info("Initialized and loaded MobilenetArrow ONNX session");
   }
-  static MobilenetArrowClassifier make_waseem2_model(const std::string& s) {
-    return MobilenetArrowClassifier(s, WASEEM2_CLASSMAP);
+  static MobilenetArrowClassifier make_waseem2_model(const std::string& s, const SessionConfig& config = {}) {
+    return MobilenetArrowClassifier(s, WASEEM2_CLASSMAP, config);
   }
-  static MobilenetArrowClassifier make_mohnish4_model(const std::string& s) {
-    return MobilenetArrowClassifier(s, MOHNISH4_CLASSMAP);
+  static MobilenetArrowClassifier make_mohnish4_model(const std::string& s, const SessionConfig& config = {}) {
+    return MobilenetArrowClassifier(s, MOHNISH4_CLASSMAP, config);
   }
   friend ClassificationModel::Detection model_classify(
     MobilenetArrowClassifier& mac,
@@ -80,6 +90,7 @@ public:
     float threshold = 0.6f)
   {
     mac.m_bounding_box.reset();
+    StageClock clock(mac.m_timings);
     cv::Size original_image_size = image.size();
     // Image preprocessing
     cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
@@ -91,13 +102,15 @@ public:
            product(std::span(MOBILENET_ARROW_INPUT_SHAPE)));
     auto dest = mac.m_input_tensor[0].GetTensorMutableData<uint8_t>();
     std::copy(image.begin<uint8_t>(), image.end<uint8_t>(), dest);
+    clock.lap();
 
-    auto output_tensors = mac.m_session.Run(Ort::RunOptions{ nullptr },
+    auto output_tensors = mac.m_session->Run(Ort::RunOptions{ nullptr },
                                         MOBILENET_ARROW_INPUT_NAMES.data(),
                                         mac.m_input_tensor.data(),
                                         MOBILENET_ARROW_INPUT_NAMES.size(),
                                         MOBILENET_ARROW_OUTPUT_NAMES.data(),
                                         MOBILENET_ARROW_OUTPUT_NAMES.size());
+    clock.lap();
 
     const float* ndetections = output_tensors[5].GetTensorData<float>();
     size_t detections = *ndetections;
@@ -117,6 +130,7 @@ public:
     spdlog::info("Bounding box {},{},{},{}", bb_tl_br[0],bb_tl_br[1],bb_tl_br[2],bb_tl_br[3]);
     cv::Rect bounding_box(original_image_size.width*bb_tl_br[1], original_image_size.height*bb_tl_br[0], (bb_tl_br[3]-bb_tl_br[1])*original_image_size.width, (bb_tl_br[2] - bb_tl_br[0])*original_image_size.height); // Example bounding box (x, y, width, height)
     mac.m_bounding_box.emplace(bounding_box);
+    mac.m_confidence = scores[best_detection];
 
     return mac.m_result_map[classes[best_detection]];
   }
@@ -125,4 +139,16 @@ public:
     assert(mac.m_bounding_box.has_value());
     return mac.m_bounding_box.value();
   }
+  friend float model_get_confidence(const MobilenetArrowClassifier& mac)
+  {
+    return mac.m_confidence;
+  }
+  friend StageTimings model_get_timings(const MobilenetArrowClassifier& mac)
+  {
+    return mac.m_timings;
+  }
+  friend MobilenetArrowClassifier model_replicate(const MobilenetArrowClassifier& mac)
+  {
+    return MobilenetArrowClassifier(mac.m_session, mac.m_result_map);
+  }
 };
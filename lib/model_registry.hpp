@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "classification_model.hpp"
+#include "ort_session.hpp"
+#include "mobilenet_arrow.hpp"
+#include "yolov8_arrow.hpp"
+#include "aruco_detector.hpp"
+
+struct ModelEntry {
+  std::function<ClassificationModel(const std::string& model_path, const SessionConfig& config)> factory;
+  float threshold; // Confidence the model was validated at
+  const char* description;
+
+  ClassificationModel make(const std::string& model_path, const SessionConfig& config = {}) const {
+    return factory(model_path, config);
+  }
+  // Instances for n threads, sharing one set of weights where the model allows
+  std::vector<ClassificationModel> make_replicas(const std::string& model_path, int n, const SessionConfig& config = {}) const {
+    std::vector<ClassificationModel> models;
+    models.push_back(make(model_path, config));
+    while (int(models.size()) < n) {
+      auto replica = replicate(models.front());
+      models.push_back(replica ? std::move(*replica) : make(model_path, config));
+    }
+    return models;
+  }
+};
+
+// Every detector the binaries can be asked for by name
+inline const std::map<std::string, ModelEntry>& model_registry() {
+  static const std::map<std::string, ModelEntry> registry{
+    { "waseem2",
+      { [](const std::string& path, const SessionConfig& config) {
+         return ClassificationModel(MobilenetArrowClassifier::make_waseem2_model(path, config));
+       },
+        0.6f, "MobileNet SSD: cone, left, right" } },
+    { "mohnish4",
+      { [](const std::string& path, const SessionConfig& config) {
+         return ClassificationModel(MobilenetArrowClassifier::make_mohnish4_model(path, config));
+       },
+        0.6f, "MobileNet SSD: left, right, cone" } },
+    { "yolov8",
+      { [](const std::string& path, const SessionConfig& config) {
+         return ClassificationModel(Yolov8ArrowClassifier::make_mohnish7_model(path, config));
+       },
+        0.8f, "YOLOv8 (mohnish7): right, left, cone" } },
+    { "akash5",
+      { [](const std::string& path, const SessionConfig&) {
+         return ClassificationModel(ArucoDetector::make_akash5_model(path));
+       },
+        0.0f, "ArUco 4x4_50 markers, model path unused" } },
+  };
+  return registry;
+}
+
+inline std::vector<std::string> model_names() {
+  std::vector<std::string> names;
+  for (const auto& [name, entry] : model_registry()) names.push_back(name);
+  return names;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// How the ranges falling in one bin become its distance
+enum class BinReducer {
+  MIN, // Closest return, as sensitive to flying pixels as it gets
+  KTH_MIN, // k-th closest return
+  PERCENTILE, // Given fraction of the returns are closer
+  MIN_OF_CLUSTERS, // Closest run of at least min_cluster returns within cluster_gap of each other
+};
+
+inline std::optional<BinReducer> parse_bin_reducer(const std::string& name) {
+  if (name == "min") return BinReducer::MIN;
+  if (name == "kth") return BinReducer::KTH_MIN;
+  if (name == "percentile") return BinReducer::PERCENTILE;
+  if (name == "clusters") return BinReducer::MIN_OF_CLUSTERS;
+  return std::nullopt;
+}
+
+struct BinParams {
+  size_t bins = 72;
+  BinReducer reducer = BinReducer::PERCENTILE;
+  size_t k = 3;
+  float percentile = 0.05f;
+  float cluster_gap = 0.1f; // m
+  size_t min_cluster = 4;
+  // Elevation band, in degrees off the optical axis, that bins look at
+  float band_low_deg = -90.0f;
+  float band_high_deg = 90.0f;
+};
+
+// Reduces a range image to obstacle bins across its width in one pass over
+// the rows of the band. Columns are split between bins so every column
+// lands in exactly one bin. Ranges that are not finite and positive are
+// no returns. Scratch space is kept between frames.
+class ObstacleBinner {
+  static constexpr size_t MAX_K = 16;
+  BinParams m_params;
+  std::vector<std::vector<float>> m_scratch; // Returns per bin
+  std::vector<std::array<float, MAX_K>> m_smallest; // k smallest per bin, ascending
+  std::vector<size_t> m_counts;
+  std::vector<uint32_t> m_column_bin;
+
+  // Insertion into a sorted run of at most k: a partial sorting network
+  // that keeps the k closest returns without storing the rest
+  static void keep_smallest(std::array<float, MAX_K>& smallest, size_t& count, size_t k, float r) {
+    if (count == k and r >= smallest[k - 1]) return;
+    size_t i = count < k ? count++ : k - 1;
+    while (i > 0 and smallest[i - 1] > r) {
+      smallest[i] = smallest[i - 1];
+      i--;
+    }
+    smallest[i] = r;
+  }
+  float min_of_clusters(std::vector<float>& returns) const {
+    std::sort(returns.begin(), returns.end());
+    size_t start = 0;
+    for (size_t i = 1; i <= returns.size(); i++) {
+      if (i == returns.size() or returns[i] - returns[i - 1] > m_params.cluster_gap) {
+        if (i - start >= m_params.min_cluster) return returns[start];
+        start = i;
+      }
+    }
+    return INFINITY;
+  }
+  bool needs_scratch() const {
+    return m_params.reducer == BinReducer::PERCENTILE or m_params.reducer == BinReducer::MIN_OF_CLUSTERS;
+  }
+
+  public:
+  explicit ObstacleBinner(const BinParams& params = {}) : m_params(params) {
+    m_params.bins = std::max<size_t>(m_params.bins, 1);
+    m_params.k = std::clamp<size_t>(m_params.k, 1, MAX_K);
+    m_scratch.resize(m_params.bins);
+    m_smallest.resize(m_params.bins);
+    m_counts.resize(m_params.bins);
+  }
+  const BinParams& params() const { return m_params; }
+
+  // range is row-major, top row first, spanning vfov_rad vertically.
+  // Distances in cm, UINT16_MAX for a bin without returns.
+  void reduce(std::span<const float> range, size_t width, size_t height, float vfov_rad, std::span<uint16_t> distances) {
+    const size_t bins = m_params.bins;
+    if (width == 0 or height == 0) {
+      std::fill(distances.begin(), distances.end(), UINT16_MAX);
+      return;
+    }
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    for (auto& s : m_scratch) s.clear();
+    // Bin of each column, computed once per frame
+    m_column_bin.resize(width);
+    for (size_t c = 0; c < width; c++) m_column_bin[c] = std::min(bins - 1, c * bins / width);
+
+    const float row_deg = vfov_rad * 180.0f / float(M_PI) / height;
+    const bool scratch = needs_scratch();
+    const size_t k = m_params.reducer == BinReducer::MIN ? 1 : m_params.k;
+    for (size_t row = 0; row < height; row++) {
+      const float elevation = vfov_rad * 90.0f / float(M_PI) - (row + 0.5f) * row_deg;
+      if (elevation < m_params.band_low_deg or elevation > m_params.band_high_deg) continue;
+      const float* line = range.data() + row * width;
+      for (size_t c = 0; c < width; c++) {
+        const float r = line[c];
+        if (not std::isfinite(r) or r <= 0.0f) continue;
+        const uint32_t b = m_column_bin[c];
+        if (scratch) {
+          m_scratch[b].push_back(r);
+        } else {
+          keep_smallest(m_smallest[b], m_counts[b], k, r);
+        }
+      }
+    }
+
+    for (size_t b = 0; b < std::min(bins, distances.size()); b++) {
+      float r = INFINITY;
+      switch (m_params.reducer) {
+        case BinReducer::MIN:
+        case BinReducer::KTH_MIN:
+          // Fewer than k returns: trust the farthest one there is
+          if (m_counts[b]) r = m_smallest[b][std::min(m_counts[b], k) - 1];
+          break;
+        case BinReducer::PERCENTILE: {
+          auto& returns = m_scratch[b];
+          if (returns.empty()) break;
+          auto nth = returns.begin() + std::min(returns.size() - 1, size_t(m_params.percentile * returns.size()));
+          std::nth_element(returns.begin(), nth, returns.end());
+          r = *nth;
+          break;
+        }
+        case BinReducer::MIN_OF_CLUSTERS:
+          r = min_of_clusters(m_scratch[b]);
+          break;
+      }
+      distances[b] = std::isfinite(r) ? uint16_t(std::clamp(std::lround(r * 100.0f), 1L, long(UINT16_MAX - 1))) : UINT16_MAX;
+    }
+    for (size_t b = bins; b < distances.size(); b++) distances[b] = UINT16_MAX;
+  }
+};
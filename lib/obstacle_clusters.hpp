@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "obstacle_merge.hpp"
+
+// An obstacle point dropped onto the ground, in the body frame: x forward,
+// y right, m
+struct GroundPoint {
+  float x;
+  float y;
+};
+
+// Camera frame ground points to the body frame of a rover carrying the
+// camera at mount, as merge_obstacle_sectors does for bins
+inline GroundPoint to_body(GroundPoint p, const CameraExtrinsics& mount) {
+  const float yaw = mount.yaw_deg * float(M_PI) / 180.0f;
+  const float c = std::cos(yaw), s = std::sin(yaw);
+  return { mount.x + p.x * c - p.y * s, mount.y + p.x * s + p.y * c };
+}
+
+// Bounding footprint of the points of one obstacle
+struct ObstacleCluster {
+  float min_x, min_y, max_x, max_y;
+  float centroid_x, centroid_y;
+  uint32_t points;
+
+  float length() const { return max_x - min_x; }
+  float width() const { return max_y - min_y; }
+};
+
+struct ClusterParams {
+  float cell = 0.1f; // m, points in touching cells belong together
+  uint32_t min_points = 5; // Smaller clusters are noise
+  float max_range = 6.0f; // m, points further out aren't clustered
+};
+
+// Connected components of the occupied cells of a ground grid, touching
+// including diagonally. One hash lookup per point and nine per occupied
+// cell, so it is linear in the points where a k-d tree search would be
+// n log n. Containers are kept between frames.
+class GridClusterer {
+  ClusterParams m_params;
+  std::unordered_map<uint64_t, uint32_t> m_cell_index;
+  std::vector<uint64_t> m_cells;
+  std::vector<uint32_t> m_parent; // Union-find over cells
+  std::vector<uint32_t> m_point_cell;
+  std::vector<uint32_t> m_cluster_of_root;
+  std::vector<ObstacleCluster> m_clusters;
+
+  static uint64_t key(int32_t cx, int32_t cy) { return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy); }
+  uint32_t find(uint32_t c) {
+    while (m_parent[c] != c) {
+      m_parent[c] = m_parent[m_parent[c]];
+      c = m_parent[c];
+    }
+    return c;
+  }
+  void unite(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) m_parent[std::max(a, b)] = std::min(a, b);
+  }
+
+  public:
+  explicit GridClusterer(const ClusterParams& params = {}) : m_params(params) {}
+  const ClusterParams& params() const { return m_params; }
+
+  // Clusters of at least min_points, valid until the next call
+  std::span<const ObstacleCluster> cluster(std::span<const GroundPoint> points) {
+    constexpr uint32_t SKIPPED = std::numeric_limits<uint32_t>::max();
+    m_cell_index.clear();
+    m_cells.clear();
+    m_point_cell.resize(points.size());
+    const float max_range2 = m_params.max_range * m_params.max_range;
+    for (size_t i = 0; i < points.size(); i++) {
+      const auto& p = points[i];
+      if (not std::isfinite(p.x) or not std::isfinite(p.y) or p.x * p.x + p.y * p.y > max_range2) {
+        m_point_cell[i] = SKIPPED;
+        continue;
+      }
+      const uint64_t k = key(int32_t(std::floor(p.x / m_params.cell)), int32_t(std::floor(p.y / m_params.cell)));
+      auto [it, inserted] = m_cell_index.try_emplace(k, uint32_t(m_cells.size()));
+      if (inserted) m_cells.push_back(k);
+      m_point_cell[i] = it->second;
+    }
+
+    m_parent.resize(m_cells.size());
+    std::iota(m_parent.begin(), m_parent.end(), 0);
+    for (uint32_t c = 0; c < m_cells.size(); c++) {
+      const int32_t cx = int32_t(m_cells[c] >> 32), cy = int32_t(uint32_t(m_cells[c]));
+      for (int32_t dx = -1; dx <= 1; dx++) {
+        for (int32_t dy = -1; dy <= 1; dy++) {
+          if (auto it = m_cell_index.find(key(cx + dx, cy + dy)); it != m_cell_index.end()) unite(c, it->second);
+        }
+      }
+    }
+
+    m_clusters.clear();
+    m_cluster_of_root.assign(m_cells.size(), SKIPPED);
+    for (size_t i = 0; i < points.size(); i++) {
+      if (m_point_cell[i] == SKIPPED) continue;
+      const uint32_t root = find(m_point_cell[i]);
+      const auto& p = points[i];
+      if (m_cluster_of_root[root] == SKIPPED) {
+        m_cluster_of_root[root] = m_clusters.size();
+        m_clusters.push_back({ p.x, p.y, p.x, p.y, 0.0f, 0.0f, 0 });
+      }
+      auto& cluster = m_clusters[m_cluster_of_root[root]];
+      cluster.min_x = std::min(cluster.min_x, p.x);
+      cluster.min_y = std::min(cluster.min_y, p.y);
+      cluster.max_x = std::max(cluster.max_x, p.x);
+      cluster.max_y = std::max(cluster.max_y, p.y);
+      cluster.centroid_x += p.x;
+      cluster.centroid_y += p.y;
+      cluster.points++;
+    }
+    std::erase_if(m_clusters, [&](const auto& cluster) { return cluster.points < m_params.min_points; });
+    for (auto& cluster : m_clusters) {
+      cluster.centroid_x /= cluster.points;
+      cluster.centroid_y /= cluster.points;
+    }
+    return m_clusters;
+  }
+};
+
+// An obstacle followed from frame to frame. Velocity is relative to the
+// rover, so a fixed post drifts backwards as the rover drives past it.
+struct TrackedObstacle {
+  uint32_t id;
+  ObstacleCluster cluster;
+  float velocity_x = 0.0f; // m/s
+  float velocity_y = 0.0f;
+  uint32_t age = 1; // Frames seen
+  uint32_t missed = 0; // Frames missed in a row
+  double last_seen_s;
+};
+
+struct TrackerParams {
+  float max_jump = 0.5f; // m, between the predicted and the seen centroid
+  uint32_t max_missed = 3;
+  float velocity_smoothing = 0.5f; // Weight of the newest velocity
+};
+
+// Associates clusters with tracks greedily, closest predicted centroid
+// first. There are a handful of obstacles in view, so every pair is tried.
+class ObstacleTracker {
+  TrackerParams m_params;
+  std::vector<TrackedObstacle> m_tracks;
+  uint32_t m_next_id = 0;
+  struct Pair {
+    float distance;
+    uint32_t track;
+    uint32_t cluster;
+  };
+  std::vector<Pair> m_pairs;
+  std::vector<bool> m_track_matched, m_cluster_matched;
+
+  public:
+  explicit ObstacleTracker(const TrackerParams& params = {}) : m_params(params) {}
+
+  std::span<const TrackedObstacle> update(std::span<const ObstacleCluster> clusters, double timestamp_s) {
+    m_pairs.clear();
+    for (uint32_t t = 0; t < m_tracks.size(); t++) {
+      const auto& track = m_tracks[t];
+      const float dt = timestamp_s - track.last_seen_s;
+      const float x = track.cluster.centroid_x + track.velocity_x * dt;
+      const float y = track.cluster.centroid_y + track.velocity_y * dt;
+      for (uint32_t c = 0; c < clusters.size(); c++) {
+        const float d = std::hypot(clusters[c].centroid_x - x, clusters[c].centroid_y - y);
+        if (d <= m_params.max_jump) m_pairs.push_back({ d, t, c });
+      }
+    }
+    std::sort(m_pairs.begin(), m_pairs.end(), [](const auto& a, const auto& b) { return a.distance < b.distance; });
+
+    m_track_matched.assign(m_tracks.size(), false);
+    m_cluster_matched.assign(clusters.size(), false);
+    for (const auto& pair : m_pairs) {
+      if (m_track_matched[pair.track] or m_cluster_matched[pair.cluster]) continue;
+      m_track_matched[pair.track] = m_cluster_matched[pair.cluster] = true;
+      auto& track = m_tracks[pair.track];
+      const auto& cluster = clusters[pair.cluster];
+      const float dt = timestamp_s - track.last_seen_s;
+      if (dt > 0.0f) {
+        const float a = m_params.velocity_smoothing;
+        const float vx = (cluster.centroid_x - track.cluster.centroid_x) / dt;
+        const float vy = (cluster.centroid_y - track.cluster.centroid_y) / dt;
+        // The first velocity is all there is to go on
+        track.velocity_x = track.age == 1 ? vx : (1.0f - a) * track.velocity_x + a * vx;
+        track.velocity_y = track.age == 1 ? vy : (1.0f - a) * track.velocity_y + a * vy;
+      }
+      track.cluster = cluster;
+      track.age++;
+      track.missed = 0;
+      track.last_seen_s = timestamp_s;
+    }
+
+    for (uint32_t t = 0; t < m_tracks.size(); t++) {
+      if (not m_track_matched[t]) m_tracks[t].missed++;
+    }
+    std::erase_if(m_tracks, [&](const auto& track) { return track.missed > m_params.max_missed; });
+    for (uint32_t c = 0; c < clusters.size(); c++) {
+      if (not m_cluster_matched[c]) m_tracks.push_back({ .id = m_next_id++, .cluster = clusters[c], .last_seen_s = timestamp_s });
+    }
+    return m_tracks;
+  }
+  std::span<const TrackedObstacle> tracks() const { return m_tracks; }
+};
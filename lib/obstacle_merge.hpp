@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <string>
+
+// Where a depth camera sits on the rover, in the body frame: x forward, y
+// right, yaw clockwise from the nose, as in MAV_FRAME_BODY_FRD
+struct CameraExtrinsics {
+  float yaw_deg = 0.0f;
+  float x = 0.0f; // m
+  float y = 0.0f; // m
+};
+
+struct CameraSpec {
+  std::string serial;
+  CameraExtrinsics extrinsics;
+};
+
+// "SERIAL[:yaw_deg[:x[:y]]]", eg. 123622270348:180:-0.3:0
+inline std::optional<CameraSpec> parse_camera_spec(const std::string& spec) {
+  CameraSpec camera;
+  size_t start = 0, colon = spec.find(':');
+  camera.serial = spec.substr(0, colon);
+  if (camera.serial.empty()) return std::nullopt;
+  float* fields[] = { &camera.extrinsics.yaw_deg, &camera.extrinsics.x, &camera.extrinsics.y };
+  for (float* field : fields) {
+    if (colon == std::string::npos) break;
+    start = colon + 1;
+    colon = spec.find(':', start);
+    std::string value = spec.substr(start, colon == std::string::npos ? std::string::npos : colon - start);
+    char* end;
+    *field = std::strtof(value.c_str(), &end);
+    if (value.empty() or *end) return std::nullopt;
+  }
+  if (colon != std::string::npos) return std::nullopt;
+  return camera;
+}
+
+// Obstacle bins of one camera, laid out like OBSTACLE_DISTANCE: element i
+// looks offset_deg + i * increment_deg off the camera axis
+struct ObstacleSector {
+  std::span<const uint16_t> distances; // cm, UINT16_MAX where nothing was seen
+  float increment_deg;
+  float offset_deg;
+  CameraExtrinsics mount;
+};
+
+constexpr size_t MERGED_OBSTACLE_BINS = 72;
+constexpr float MERGED_OBSTACLE_INCREMENT_DEG = 360.0f / MERGED_OBSTACLE_BINS;
+
+// Moves every reading to the body origin and keeps the closest one per 5°
+// around the rover, so the result goes out as one OBSTACLE_DISTANCE with
+// MERGED_OBSTACLE_INCREMENT_DEG and an angle_offset of 0. Bins no camera
+// sees stay UINT16_MAX, which the autopilot treats as unknown.
+inline auto merge_obstacle_sectors(std::span<const ObstacleSector> sectors)
+  -> std::array<uint16_t, MERGED_OBSTACLE_BINS> {
+  std::array<uint16_t, MERGED_OBSTACLE_BINS> merged;
+  merged.fill(UINT16_MAX);
+  for (const auto& sector : sectors) {
+    for (size_t i = 0; i < sector.distances.size(); i++) {
+      if (sector.distances[i] == UINT16_MAX) continue;
+      const float range = sector.distances[i] / 100.0f;
+      const float angle = (sector.mount.yaw_deg + sector.offset_deg + i * sector.increment_deg) * float(M_PI) / 180.0f;
+      const float x = sector.mount.x + range * std::cos(angle);
+      const float y = sector.mount.y + range * std::sin(angle);
+      float bearing_deg = std::atan2(y, x) * 180.0f / float(M_PI);
+      if (bearing_deg < 0.0f) bearing_deg += 360.0f;
+      const size_t bin = size_t(std::lround(bearing_deg / MERGED_OBSTACLE_INCREMENT_DEG)) % MERGED_OBSTACLE_BINS;
+      // At least 1 cm: 0 would be an invalid reading
+      const uint16_t cm = std::clamp<long>(std::lround(std::hypot(x, y) * 100.0f), 1, UINT16_MAX - 1);
+      merged[bin] = std::min(merged[bin], cm);
+    }
+  }
+  return merged;
+}
@@ -0,0 +1,447 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <pcl/common/angles.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+#include <pcl/filters/extract_indices.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/range_image/range_image.h>
+#include <librealsense2/rs.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+
+#include <asio/co_spawn.hpp>
+#include <asio/deferred.hpp>
+#include <asio/experimental/parallel_group.hpp>
+#include <asio/thread_pool.hpp>
+
+#include "common.hpp"
+#include "frame_view.hpp"
+#include "obstacle_bins.hpp"
+#include "obstacle_clusters.hpp"
+#include "obstacle_merge.hpp"
+#include "plane_ransac.hpp"
+#include "range_image_dump.hpp"
+#include "realsense_generator.hpp"
+
+using tPclPtr = pcl::PointCloud<pcl::PointXYZ>::Ptr;
+
+constexpr float RANGE_IMAGE_ANGULAR_RES = 1.0f * (M_PI / 180.0f);
+
+// Knobs that trade obstacle accuracy for time, coarsest last
+struct ObstacleQuality {
+  float voxel_leaf = 0.01f; // m
+  int ransac_iterations = 50;
+  // With the IMU's up vector, candidate planes that aren't level are
+  // rejected, so far fewer iterations find the ground
+  int ransac_iterations_level = 10;
+};
+constexpr std::array<ObstacleQuality, 3> OBSTACLE_QUALITY_LEVELS{ { { 0.01f, 50, 10 }, { 0.02f, 25, 6 }, { 0.04f, 12, 4 } } };
+// How far the ground may tilt from the IMU's horizontal
+constexpr float GROUND_MAX_TILT = 10.0f * (M_PI / 180.0f);
+// Points higher above the ground pass over the rover
+constexpr float OBSTACLE_MAX_HEIGHT = 1.5f;
+
+// Debug snapshots of the obstacle pipeline, taken when the sampler says so
+struct ObstacleDebugDump {
+  RangeDumpSampler sampler;
+  std::unique_ptr<RangeImageDump> dump;
+
+  void record(const pcl::RangeImage& rg_img,
+              std::span<const uint16_t> distances,
+              const Eigen::Vector4f& ground_plane,
+              std::span<float, 2> fov,
+              double timestamp_ms) {
+    RangeFrame frame;
+    frame.header.width = rg_img.width;
+    frame.header.height = rg_img.height;
+    frame.header.timestamp_ms = timestamp_ms;
+    frame.header.angular_resolution = RANGE_IMAGE_ANGULAR_RES;
+    frame.header.fov[0] = fov[0];
+    frame.header.fov[1] = fov[1];
+    for (int i = 0; i < 4; i++) frame.header.ground_plane[i] = ground_plane[i];
+    frame.range.reserve(rg_img.points.size());
+    for (const auto& p : rg_img.points) frame.range.push_back(p.range);
+    frame.bins.assign(distances.begin(), distances.end());
+    if (not dump->submit(std::move(frame))) {
+      spdlog::warn("Range image dump is behind, {} frames dropped", dump->dropped());
+    }
+  }
+};
+
+inline void
+calculate_obstacle_distances(tPclPtr pc,
+                             std::span<uint16_t> distances,
+                             std::span<float, 2> fov,
+                             pcl::RangeImage& rg_img,
+                             ObstacleBinner& binner)
+{
+  Eigen::Affine3f rs_pose =
+    static_cast<Eigen::Affine3f>(Eigen::Translation3f(0.0f, 0.0f, 0.0f));
+  pcl::RangeImage::CoordinateFrame coord_frame = pcl::RangeImage::CAMERA_FRAME;
+  float noise_lvl = 0.0f;
+  float min_range = 0.0f;
+  int border = 0;
+  rg_img.createFromPointCloud(*pc,
+                              RANGE_IMAGE_ANGULAR_RES,
+                              fov[0],
+                              fov[1],
+                              rs_pose,
+                              coord_frame,
+                              noise_lvl,
+                              min_range,
+                              border);
+  // Unobserved pixels are -inf, which the binner skips
+  thread_local std::vector<float> ranges;
+  ranges.resize(rg_img.points.size());
+  std::transform(rg_img.points.begin(), rg_img.points.end(), ranges.begin(), [](const auto& p) { return p.range; });
+  binner.reduce(ranges, rg_img.width, rg_img.height, fov[1], distances);
+  spdlog::debug("Distances: {}", distances);
+}
+
+inline tPclPtr points_to_pcl(const rs2::points& points)
+{
+    tPclPtr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+
+    auto sp = points.get_profile().as<rs2::video_stream_profile>();
+    cloud->width = sp.width();
+    cloud->height = sp.height();
+    cloud->is_dense = false;
+    cloud->points.resize(points.size());
+    auto ptr = points.get_vertices();
+    for (auto& p : cloud->points)
+    {
+        p.x = ptr->x;
+        p.y = ptr->y;
+        p.z = ptr->z;
+        ptr++;
+    }
+
+    return cloud;
+}
+
+// Deprojects every pixel like rs2::pointcloud does, no data becoming the origin
+inline tPclPtr depth_to_pcl(const DepthView& depth)
+{
+    tPclPtr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    cloud->width = depth.width;
+    cloud->height = depth.height;
+    cloud->is_dense = false;
+    cloud->points.resize(size_t(depth.width) * depth.height);
+    const auto& k = depth.intrinsics;
+    auto p = cloud->points.begin();
+    for (int y = 0; y < depth.height; y++) {
+      const uint16_t* row = depth.row(y);
+      for (int x = 0; x < depth.width; x++, p++) {
+        const float z = row[x] * depth.units;
+        p->x = (x - k.ppx) / k.fx * z;
+        p->y = (y - k.ppy) / k.fy * z;
+        p->z = z;
+      }
+    }
+    return cloud;
+}
+
+inline void
+selectOutsideGroundPlane(const tPclPtr input_cloud,
+                         Eigen::Vector4f& plane_coefficients,
+                         float threshold,
+                         std::vector<int>& inliers)
+{
+    int nr_p = 0;
+    inliers.resize(input_cloud->size());
+
+    float threshold_close = threshold;
+    float threshold_far = 0.1;
+    float threshold_boundary = 1.5 * 1.5; // pre-squared
+
+    // Iterate through the 3d points and calculate the distances from them to
+    // the plane
+    for (size_t i = 0; i < input_cloud->size(); ++i) {
+        // Calculate the distance from the point to the plane normal as the dot
+        // product D = (P-A).N/|N|
+        Eigen::Vector4f pt(input_cloud->points[i].x,
+                           input_cloud->points[i].y,
+                           input_cloud->points[i].z,
+                           1);
+
+        float distance = fabsf(plane_coefficients.dot(pt));
+
+        // check to see whether the point is near or far from us
+        float source_distance = std::pow(input_cloud->points[i].x, 2) +
+                                std::pow(input_cloud->points[i].y, 2);
+        bool near = source_distance < threshold_boundary;
+
+        if ((near && distance < threshold_close) ||
+            (!near &&
+             distance <
+               threshold_far)) // (near ? threshold_close : threshold_far))
+        {
+      // Returns the indices of the points whose distances are smaller than the
+      // threshold
+      inliers[nr_p] = i;
+      ++nr_p;
+        }
+    }
+    inliers.resize(nr_p);
+}
+inline bool
+remove_groundplane(Eigen::Vector4f& groundplane_model_,
+                   const tPclPtr input_cloud,
+                   tPclPtr output_cloud, float ground_plane_threshold)
+{
+    // pcl::copyPointCloud(*input_cloud, *output_cloud);
+    pcl::SampleConsensusModelPlane<pcl::PointXYZ> plane_model =
+      pcl::SampleConsensusModelPlane<pcl::PointXYZ>(input_cloud);
+
+    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+    //   selectWithinDistance (const Eigen::VectorXf &model_coefficients,
+    //                const double threshold,
+    //                std::vector<int> &inliers) override;
+    // plane_model.selectWithinDistance(groundplane_model_,
+    // groundplane_threshold_, inliers->indices);
+    selectOutsideGroundPlane(input_cloud,
+                             groundplane_model_,
+                             ground_plane_threshold,
+                             inliers->indices);
+
+    // pcl::copyPointCloud<pcl::PointXYZ>(*input_cloud, inliers, *output_cloud);
+    pcl::ExtractIndices<pcl::PointXYZ> extract;
+    extract.setInputCloud(input_cloud);
+    extract.setIndices(inliers);
+    extract.setNegative(true); // points not matching the ground plane
+
+    extract.filter(*output_cloud);
+
+    return true;
+}
+// Drops obstacle points onto the ground plane, x along the camera's heading
+// and y to its right
+inline void
+project_to_ground(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                  Eigen::Vector4f plane,
+                  std::vector<GroundPoint>& ground_points)
+{
+    ground_points.clear();
+    const float norm = plane.head<3>().norm();
+    if (norm == 0.0f) return;
+    plane /= norm;
+    // Camera y points down, so the normal facing up has a negative y
+    if (plane[1] > 0.0f) plane = -plane;
+    const Eigen::Vector3f up = plane.head<3>();
+    const Eigen::Vector3f forward = (Eigen::Vector3f::UnitZ() - up.z() * up).normalized();
+    const Eigen::Vector3f right = forward.cross(up);
+    ground_points.reserve(cloud.size());
+    for (const auto& p : cloud.points) {
+      const Eigen::Vector3f v(p.x, p.y, p.z);
+      if (up.dot(v) + plane[3] > OBSTACLE_MAX_HEIGHT) continue;
+      ground_points.push_back({ forward.dot(v), right.dot(v) });
+    }
+}
+
+// Obstacle distances across one camera's horizontal FOV, left to right.
+// Touches nothing shared but the debug dump, so cameras can run in parallel.
+// With a single camera, ransac_pool spreads the ground fit over more cores.
+inline auto
+obstacle_bins(tPclPtr pcl_points,
+              double timestamp_ms,
+              std::span<float, 2> fov,
+              float distance_threshold,
+              ObstacleBinner& binner,
+              ObstacleDebugDump* debug = nullptr,
+              const ObstacleQuality& quality = {},
+              std::optional<Eigen::Vector3f> up = {},
+              std::vector<GroundPoint>* ground_points = nullptr,
+              asio::thread_pool* ransac_pool = nullptr) -> std::array<uint16_t, 72>
+{
+    tPclPtr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>),
+      obstacle_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::VoxelGrid<pcl::PointXYZ> voxel_filter;
+    std::array<uint16_t, 72> distances;
+    pcl::RangeImage rg_img;
+    spdlog::debug("Got points");
+    voxel_filter.setInputCloud(pcl_points);
+    voxel_filter.setLeafSize(quality.voxel_leaf, quality.voxel_leaf, quality.voxel_leaf);
+    voxel_filter.filter(*cloud_filtered);
+    
+    PlaneRansacParams ransac;
+    ransac.distance_threshold = distance_threshold;
+    ransac.max_iterations = up ? quality.ransac_iterations_level : quality.ransac_iterations;
+    ransac.axis = up;
+    ransac.max_tilt = GROUND_MAX_TILT;
+    auto ground = PlaneRansac(ransac, ransac_pool).fit(cloud_filtered->points);
+    // Without a ground plane nothing is removed and every point counts as an
+    // obstacle: a wall filling the view must not read as open space
+    Eigen::Vector4f ground_coeff = Eigen::Vector4f::Zero();
+    if (ground) {
+      ground_coeff = ground->plane;
+      remove_groundplane(ground_coeff, cloud_filtered, obstacle_cloud, distance_threshold);
+    } else {
+      spdlog::debug("No ground plane in {} points", cloud_filtered->size());
+      obstacle_cloud = cloud_filtered;
+    }
+
+    calculate_obstacle_distances(obstacle_cloud, distances, fov, rg_img, binner);
+    if (ground_points) {
+      // Level with the camera when there is no ground to project onto
+      Eigen::Vector4f level = Eigen::Vector4f::Zero();
+      level.head<3>() = up.value_or(-Eigen::Vector3f::UnitY());
+      project_to_ground(*obstacle_cloud, ground ? ground_coeff : level, *ground_points);
+    }
+    if (debug and debug->sampler.sample()) {
+      debug->record(rg_img, distances, ground_coeff, fov, timestamp_ms);
+    }
+    return distances;
+}
+inline auto
+obstacle_bins(const rs2::points& points,
+              std::span<float, 2> fov,
+              float distance_threshold,
+              ObstacleBinner& binner,
+              ObstacleDebugDump* debug = nullptr,
+              const ObstacleQuality& quality = {},
+              std::optional<Eigen::Vector3f> up = {},
+              std::vector<GroundPoint>* ground_points = nullptr,
+              asio::thread_pool* ransac_pool = nullptr) -> std::array<uint16_t, 72>
+{
+    return obstacle_bins(points_to_pcl(points), points.get_timestamp(), fov, distance_threshold, binner, debug,
+                         quality, up, ground_points, ransac_pool);
+}
+inline auto
+obstacle_bins(const DepthView& depth,
+              std::span<float, 2> fov,
+              float distance_threshold,
+              ObstacleBinner& binner,
+              ObstacleDebugDump* debug = nullptr,
+              const ObstacleQuality& quality = {},
+              std::optional<Eigen::Vector3f> up = {},
+              std::vector<GroundPoint>* ground_points = nullptr,
+              asio::thread_pool* ransac_pool = nullptr) -> std::array<uint16_t, 72>
+{
+    return obstacle_bins(depth_to_pcl(depth), depth.timestamp_ms, fov, distance_threshold, binner, debug,
+                         quality, up, ground_points, ransac_pool);
+}
+
+// Obstacles as objects rather than bins: the obstacle points of every
+// camera clustered on the ground around the rover and tracked over time
+struct ObstacleObjects {
+  GridClusterer clusterer;
+  ObstacleTracker tracker;
+  std::vector<std::vector<GroundPoint>> camera_points;
+  std::vector<GroundPoint> points;
+
+  std::span<const TrackedObstacle> update(double timestamp_s) {
+    auto tracks = tracker.update(clusterer.cluster(points), timestamp_s);
+    for (const auto& track : tracks) {
+      if (track.missed) continue;
+      spdlog::debug("Obstacle {} at ({:.2f}, {:.2f})m, {:.2f}x{:.2f}m, moving ({:.2f}, {:.2f})m/s",
+                    track.id, track.cluster.centroid_x, track.cluster.centroid_y, track.cluster.length(),
+                    track.cluster.width(), track.velocity_x, track.velocity_y);
+    }
+    return tracks;
+  }
+};
+
+auto
+locate_obstacles(rs2::points& points,
+                 auto& mi,
+                 std::span<float, 2> fov,
+                 float distance_threshold,
+                 ObstacleBinner& binner,
+                 ObstacleDebugDump* debug = nullptr,
+                 const ObstacleQuality& quality = {},
+                 const ImuGravity* imu = nullptr,
+                 ObstacleObjects* objects = nullptr,
+                 asio::thread_pool* ransac_pool = nullptr) -> asio::awaitable<void>
+{
+    spdlog::debug("Inside locate_obstacles");
+    auto distances = obstacle_bins(points, fov, distance_threshold, binner, debug, quality, imu ? imu->up() : std::nullopt,
+                                   objects ? &objects->points : nullptr, ransac_pool);
+    if (objects) objects->update(points.get_timestamp() / 1000.0);
+
+    float hfov_deg = (fov[0] * 180.0f) / M_PI;
+    co_await mi->set_obstacle_distance(
+      std::span(distances), hfov_deg / binner.params().bins, 17.5f, 300.0f, -0.5f * hfov_deg);
+}
+
+// One of several depth cameras whose obstacles are merged around the rover
+struct ObstacleCamera {
+  std::shared_ptr<RealsenseDevice> device;
+  std::array<float, 2> fov;
+  CameraExtrinsics mount;
+  std::shared_ptr<ImuGravity> imu; // Null without an IMU
+  ObstacleBinner binner;
+};
+
+// Waits on every camera at once, so a tick waits for the slowest camera
+// rather than the sum of them
+inline auto capture_points(std::span<ObstacleCamera> cameras) -> asio::awaitable<std::vector<rs2::points>> {
+  auto executor = co_await asio::this_coro::executor;
+  auto capture = [&](size_t i) { return asio::co_spawn(executor, cameras[i].device->async_get_points(), asio::deferred); };
+  std::vector<decltype(capture(0))> ops;
+  for (size_t i = 0; i < cameras.size(); i++) ops.push_back(capture(i));
+  auto [order, exceptions, clouds] = co_await asio::experimental::make_parallel_group(std::move(ops))
+    .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+  for (auto& e : exceptions) {
+    if (e) std::rethrow_exception(e);
+  }
+  co_return std::move(clouds);
+}
+
+// Runs the pipeline of each camera on its own pool thread and sends one 360°
+// OBSTACLE_DISTANCE. Only the first camera feeds the debug dump.
+auto
+locate_obstacles(std::span<ObstacleCamera> cameras,
+                 std::span<const rs2::points> clouds,
+                 auto& mi,
+                 asio::thread_pool& pool,
+                 float distance_threshold,
+                 ObstacleDebugDump* debug = nullptr,
+                 const ObstacleQuality& quality = {},
+                 ObstacleObjects* objects = nullptr) -> asio::awaitable<void>
+{
+    if (objects) objects->camera_points.resize(cameras.size());
+    auto bins_on_pool = [&](size_t i) {
+      return asio::co_spawn(pool, [&, i]() -> asio::awaitable<std::array<uint16_t, 72>> {
+        auto& camera = cameras[i];
+        co_return obstacle_bins(clouds[i], camera.fov, distance_threshold, camera.binner, i == 0 ? debug : nullptr, quality,
+                                camera.imu ? camera.imu->up() : std::nullopt, objects ? &objects->camera_points[i] : nullptr);
+      }, asio::deferred);
+    };
+    std::vector<decltype(bins_on_pool(0))> ops;
+    for (size_t i = 0; i < cameras.size(); i++) ops.push_back(bins_on_pool(i));
+    auto [order, exceptions, bins] = co_await asio::experimental::make_parallel_group(std::move(ops))
+      .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+    for (auto& e : exceptions) {
+      if (e) std::rethrow_exception(e);
+    }
+
+    std::vector<ObstacleSector> sectors;
+    for (size_t i = 0; i < cameras.size(); i++) {
+      const float hfov_deg = (cameras[i].fov[0] * 180.0f) / M_PI;
+      const size_t bin_count = cameras[i].binner.params().bins;
+      sectors.push_back({ std::span(bins[i]).first(bin_count), hfov_deg / bin_count, -0.5f * hfov_deg, cameras[i].mount });
+    }
+    auto merged = merge_obstacle_sectors(sectors);
+    if (objects) {
+      objects->points.clear();
+      for (size_t i = 0; i < cameras.size(); i++) {
+        for (auto p : objects->camera_points[i]) objects->points.push_back(to_body(p, cameras[i].mount));
+      }
+      objects->update(clouds.front().get_timestamp() / 1000.0);
+    }
+    spdlog::debug("Merged distances: {}", merged);
+    co_await mi->set_obstacle_distance(
+      std::span(merged), MERGED_OBSTACLE_INCREMENT_DEG, 17.5f, 300.0f, 0.0f);
+}
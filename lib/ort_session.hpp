@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+#include <spdlog/spdlog.h>
+
+// CPU execution providers the classifiers can run on. Anything but CPU is
+// only usable if the linked onnxruntime was built with it.
+enum class ExecutionProvider {
+  CPU = 0,
+  XNNPACK, // ARM and x86 companion boards
+  OPENVINO, // Intel CPUs
+  DNNL, // oneDNN
+};
+
+constexpr const char* to_string(ExecutionProvider p) {
+  switch (p) {
+    case ExecutionProvider::XNNPACK: return "xnnpack";
+    case ExecutionProvider::OPENVINO: return "openvino";
+    case ExecutionProvider::DNNL: return "dnnl";
+    default: return "cpu";
+  }
+}
+inline std::optional<ExecutionProvider> parse_execution_provider(const std::string& name) {
+  for (auto p : { ExecutionProvider::CPU, ExecutionProvider::XNNPACK,
+                  ExecutionProvider::OPENVINO, ExecutionProvider::DNNL }) {
+    if (name == to_string(p)) return p;
+  }
+  return std::nullopt;
+}
+// Name onnxruntime registers the provider under
+constexpr const char* ort_provider_name(ExecutionProvider p) {
+  switch (p) {
+    case ExecutionProvider::XNNPACK: return "XnnpackExecutionProvider";
+    case ExecutionProvider::OPENVINO: return "OpenVINOExecutionProvider";
+    case ExecutionProvider::DNNL: return "DnnlExecutionProvider";
+    default: return "CPUExecutionProvider";
+  }
+}
+
+// Runtime knobs shared by the ONNX classifiers; zeros keep ORT's defaults
+struct SessionConfig {
+  int intra_op_threads = 0;
+  int inter_op_threads = 0;
+  bool parallel_execution = false; // Run independent graph branches concurrently
+  GraphOptimizationLevel optimization = GraphOptimizationLevel::ORT_ENABLE_ALL;
+  ExecutionProvider provider = ExecutionProvider::CPU;
+  bool log_placement = false; // Have ORT log which provider each node was assigned to
+  // Run on the process-wide thread pools and arena and share prepacked
+  // weights with other sessions of the same model, see OrtRuntime
+  bool shared_runtime = true;
+};
+
+inline bool provider_available(ExecutionProvider p) {
+  auto available = Ort::GetAvailableProviders();
+  return std::find(available.begin(), available.end(), ort_provider_name(p)) != available.end();
+}
+
+// Appends the configured provider ahead of the default CPU provider, which
+// always stays registered to pick up the nodes the first one cannot run.
+// Returns false when the provider could not be added and only CPU is used.
+inline bool append_execution_provider(Ort::SessionOptions& options, const SessionConfig& config) {
+  if (config.provider == ExecutionProvider::CPU) return true;
+  if (not provider_available(config.provider)) {
+    spdlog::warn("onnxruntime was built without {}, falling back to cpu", to_string(config.provider));
+    return false;
+  }
+  try {
+    switch (config.provider) {
+      case ExecutionProvider::XNNPACK: {
+        // XNNPACK has its own pool, ORT's intra-op pool only runs the remaining CPU nodes
+        options.AppendExecutionProvider("XNNPACK", { { "intra_op_num_threads", std::to_string(config.intra_op_threads) } });
+        break;
+      }
+      case ExecutionProvider::OPENVINO: {
+        OrtOpenVINOProviderOptions openvino{};
+        openvino.device_type = "CPU_FP32";
+        if (config.intra_op_threads) openvino.num_of_threads = config.intra_op_threads;
+        options.AppendExecutionProvider_OpenVINO(openvino);
+        break;
+      }
+      case ExecutionProvider::DNNL: {
+        const OrtApi& api = Ort::GetApi();
+        OrtDnnlProviderOptions* dnnl = nullptr;
+        Ort::ThrowOnError(api.CreateDnnlProviderOptions(&dnnl));
+        const char* keys[] = { "use_arena" };
+        const char* values[] = { "1" };
+        OrtStatus* status = api.UpdateDnnlProviderOptions(dnnl, keys, values, 1);
+        if (not status) status = api.SessionOptionsAppendExecutionProvider_Dnnl(options, dnnl);
+        api.ReleaseDnnlProviderOptions(dnnl);
+        Ort::ThrowOnError(status);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  catch (const Ort::Exception& e) {
+    spdlog::warn("Could not enable {}, falling back to cpu: {}", to_string(config.provider), e.what());
+    return false;
+  }
+  spdlog::info("Using {} execution provider", to_string(config.provider));
+  return true;
+}
+
+inline Ort::SessionOptions make_session_options(const SessionConfig& config) {
+  Ort::SessionOptions options;
+  if (config.shared_runtime) {
+    // Thread counts are those of the global pools
+    options.DisablePerSessionThreads();
+    options.AddConfigEntry("session.use_env_allocators", "1");
+  } else {
+    if (config.intra_op_threads) options.SetIntraOpNumThreads(config.intra_op_threads);
+    if (config.inter_op_threads) options.SetInterOpNumThreads(config.inter_op_threads);
+  }
+  options.SetExecutionMode(config.parallel_execution ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+  options.SetGraphOptimizationLevel(config.optimization);
+  // Node placements are reported at verbose severity when the session is created
+  if (config.log_placement) options.SetLogSeverityLevel(ORT_LOGGING_LEVEL_VERBOSE);
+  append_execution_provider(options, config);
+  return options;
+}
+
+// ONNX Runtime allows a single environment per process, so every classifier
+// shares this one. It owns the global intra/inter-op thread pools, a CPU arena
+// registered with the environment, and a container that lets sessions of the
+// same model share their prepacked (layout transformed) weights instead of
+// holding a copy each. The pools are sized by the config of the first session;
+// sessions with shared_runtime unset keep their own threads and arena.
+class OrtRuntime {
+  Ort::Env m_env;
+  Ort::PrepackedWeightsContainer m_prepacked;
+  int m_intra_op_threads;
+  int m_inter_op_threads;
+
+  static Ort::Env make_env(const SessionConfig& config) {
+    Ort::ThreadingOptions threading;
+    if (config.intra_op_threads) threading.SetGlobalIntraOpNumThreads(config.intra_op_threads);
+    if (config.inter_op_threads) threading.SetGlobalInterOpNumThreads(config.inter_op_threads);
+    return Ort::Env(threading, ORT_LOGGING_LEVEL_WARNING, "michi");
+  }
+
+  explicit OrtRuntime(const SessionConfig& config)
+    : m_env(make_env(config))
+    , m_intra_op_threads(config.intra_op_threads)
+    , m_inter_op_threads(config.inter_op_threads)
+  {
+    Ort::MemoryInfo cpu("Cpu", OrtArenaAllocator, 0, OrtMemTypeDefault);
+    // Zero and -1 keep ORT's default arena limits and growth
+    Ort::ArenaCfg arena(0, -1, -1, -1);
+    m_env.CreateAndRegisterAllocator(cpu, arena);
+    spdlog::info("Initialized ONNX Runtime environment, global pools intra {} inter {}",
+                 m_intra_op_threads, m_inter_op_threads);
+  }
+
+  public:
+  OrtRuntime(const OrtRuntime&) = delete;
+  OrtRuntime& operator=(const OrtRuntime&) = delete;
+
+  static OrtRuntime& instance(const SessionConfig& config = {}) {
+    static OrtRuntime runtime(config);
+    return runtime;
+  }
+
+  Ort::Env& env() { return m_env; }
+
+  Ort::Session make_session(const std::string& model_path, const SessionConfig& config) {
+    if (config.shared_runtime and (config.intra_op_threads != m_intra_op_threads or
+                                   config.inter_op_threads != m_inter_op_threads)) {
+      spdlog::warn("Session asks for intra {} inter {} threads, the global pools already have intra {} inter {}",
+                   config.intra_op_threads, config.inter_op_threads, m_intra_op_threads, m_inter_op_threads);
+    }
+    Ort::SessionOptions options = make_session_options(config);
+    if (not config.shared_runtime) return Ort::Session(m_env, model_path.c_str(), options);
+    // The container is not safe to fill from two sessions at once
+    static std::mutex mutex;
+    std::lock_guard lock(mutex);
+    return Ort::Session(m_env, model_path.c_str(), options, m_prepacked);
+  }
+};
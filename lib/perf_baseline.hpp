@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include "expected.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class PerfErrc {
+  // 0 implies success
+  Unreadable = 10,
+  Unwritable,
+};
+struct PerfErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "PerfBaseline";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<PerfErrc>(ev)) {
+      case PerfErrc::Unreadable:
+      return "could not read performance report";
+      case PerfErrc::Unwritable:
+      return "could not write performance report";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const PerfErrCategory perferrc_category;
+inline std::error_code make_error_code(PerfErrc e) {
+  return {static_cast<int>(e), perferrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<PerfErrc> : true_type {};
+}
+
+struct StageLatency {
+  double p50_ms = NAN;
+  double p99_ms = NAN;
+  size_t samples = 0;
+};
+// Latency of each pipeline stage over one replay, by stage name
+using PerfReport = std::map<std::string, StageLatency>;
+
+inline StageLatency summarize_latency(std::vector<double> samples_ms) {
+  StageLatency s;
+  s.samples = samples_ms.size();
+  if (samples_ms.empty()) return s;
+  auto at = [&](double p) {
+    auto nth = samples_ms.begin() + std::min(samples_ms.size() - 1, size_t(p * samples_ms.size()));
+    std::nth_element(samples_ms.begin(), nth, samples_ms.end());
+    return *nth;
+  };
+  s.p50_ms = at(0.5);
+  s.p99_ms = at(0.99);
+  return s;
+}
+
+// How much slower a stage may get before it counts as a regression. p99
+// is noisier than p50, and the floor keeps sub-millisecond stages from
+// failing on scheduler jitter.
+struct PerfTolerance {
+  double p50 = 0.25;
+  double p99 = 0.5;
+  double floor_ms = 0.2;
+};
+
+struct StageDiff {
+  std::string stage;
+  StageLatency baseline; // NaN for a stage the baseline doesn't have
+  StageLatency now; // NaN for a stage this run skipped
+  bool regressed = false;
+};
+
+inline std::vector<StageDiff> compare_latency(const PerfReport& now, const PerfReport& baseline,
+                                              const PerfTolerance& tolerance = {}) {
+  std::vector<StageDiff> diffs;
+  auto slower = [&](double now_ms, double before_ms, double relative) {
+    return now_ms > before_ms * (1.0 + relative) + tolerance.floor_ms;
+  };
+  for (const auto& [stage, latency] : now) {
+    StageDiff diff{ stage, {}, latency };
+    if (auto before = baseline.find(stage); before != baseline.end()) {
+      diff.baseline = before->second;
+      diff.regressed = slower(latency.p50_ms, before->second.p50_ms, tolerance.p50) or
+                       slower(latency.p99_ms, before->second.p99_ms, tolerance.p99);
+    }
+    diffs.push_back(diff);
+  }
+  for (const auto& [stage, latency] : baseline) {
+    if (not now.contains(stage)) diffs.push_back({ stage, latency, {} });
+  }
+  return diffs;
+}
+
+inline bool any_regressed(const std::vector<StageDiff>& diffs) {
+  return std::any_of(diffs.begin(), diffs.end(), [](const auto& d) { return d.regressed; });
+}
+
+// One line per stage, baseline -> now with the change, regressions marked
+inline std::string latency_diff_table(const std::vector<StageDiff>& diffs) {
+  std::string out = fmt::format("{:<12} {:>9} {:>9} {:>8}   {:>9} {:>9} {:>8}\n", "stage", "p50 was", "now", "change",
+                                "p99 was", "now", "change");
+  auto change = [](double now, double before) {
+    return std::isnan(now) or std::isnan(before) ? std::string("-") : fmt::format("{:+.0f}%", 100.0 * (now - before) / before);
+  };
+  for (const auto& d : diffs) {
+    fmt::format_to(std::back_inserter(out), "{:<12} {:>9.2f} {:>9.2f} {:>8}   {:>9.2f} {:>9.2f} {:>8}{}\n", d.stage,
+                   d.baseline.p50_ms, d.now.p50_ms, change(d.now.p50_ms, d.baseline.p50_ms), d.baseline.p99_ms,
+                   d.now.p99_ms, change(d.now.p99_ms, d.baseline.p99_ms), d.regressed ? "  REGRESSED" : "");
+  }
+  return out;
+}
+
+// {"stages": {"obstacles": {"p50_ms": .., "p99_ms": .., "samples": ..}, ..}}
+inline tResult<PerfReport> read_perf_report(const std::string& path) {
+  namespace pt = boost::property_tree;
+  pt::ptree tree;
+  try {
+    pt::read_json(path, tree);
+  } catch (const pt::json_parser_error& e) {
+    spdlog::error("Performance report {}: {}", path, e.what());
+    return make_unexpected(PerfErrc::Unreadable);
+  }
+  PerfReport report;
+  for (const auto& [stage, latency] : tree.get_child("stages", {})) {
+    report[stage] = { latency.get<double>("p50_ms", NAN), latency.get<double>("p99_ms", NAN),
+                      latency.get<size_t>("samples", 0) };
+  }
+  return report;
+}
+
+inline tResult<void> write_perf_report(const std::string& path, const PerfReport& report,
+                                       const std::vector<StageDiff>& diffs = {}) {
+  namespace pt = boost::property_tree;
+  pt::ptree tree;
+  for (const auto& [stage, latency] : report) {
+    pt::ptree& s = tree.put_child("stages." + stage, {});
+    s.put("p50_ms", latency.p50_ms);
+    s.put("p99_ms", latency.p99_ms);
+    s.put("samples", latency.samples);
+  }
+  for (const auto& d : diffs) {
+    pt::ptree& s = tree.put_child("diff." + d.stage, {});
+    s.put("baseline_p50_ms", d.baseline.p50_ms);
+    s.put("baseline_p99_ms", d.baseline.p99_ms);
+    s.put("regressed", d.regressed);
+  }
+  try {
+    pt::write_json(path, tree);
+  } catch (const pt::json_parser_error& e) {
+    spdlog::error("Performance report {}: {}", path, e.what());
+    return make_unexpected(PerfErrc::Unwritable);
+  }
+  return {};
+}
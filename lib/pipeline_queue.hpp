@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Blocking multi-producer, multi-consumer FIFO. Producers wait while it is
+// full, which is what keeps a fast stage from running ahead of a slow one.
+template <typename T>
+class BoundedQueue {
+  std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::condition_variable m_not_full;
+  std::deque<T> m_items;
+  size_t m_capacity;
+  bool m_closed = false;
+
+  public:
+  explicit BoundedQueue(size_t capacity) : m_capacity(capacity) {}
+
+  // Returns false if the queue was closed, the item is discarded
+  bool push(T item) {
+    std::unique_lock lock(m_mutex);
+    m_not_full.wait(lock, [this] { return m_closed or m_items.size() < m_capacity; });
+    if (m_closed) return false;
+    m_items.push_back(std::move(item));
+    lock.unlock();
+    m_not_empty.notify_one();
+    return true;
+  }
+  // Empty once the queue is closed and drained
+  std::optional<T> pop() {
+    std::unique_lock lock(m_mutex);
+    m_not_empty.wait(lock, [this] { return m_closed or not m_items.empty(); });
+    if (m_items.empty()) return std::nullopt;
+    T item = std::move(m_items.front());
+    m_items.pop_front();
+    lock.unlock();
+    m_not_full.notify_one();
+    return item;
+  }
+  void close() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_closed = true;
+    }
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+  }
+};
+
+// Takes items tagged with consecutive sequence numbers in any order and hands
+// them out in sequence order. Producers that are more than capacity ahead of
+// the consumer wait, so the reorder buffer stays bounded; the producer holding
+// the next item in sequence never waits, so this cannot deadlock.
+template <typename T>
+class OrderedQueue {
+  std::mutex m_mutex;
+  std::condition_variable m_ready;
+  std::condition_variable m_room;
+  std::map<size_t, T> m_pending;
+  size_t m_next = 0;
+  size_t m_capacity;
+  bool m_closed = false;
+
+  public:
+  explicit OrderedQueue(size_t capacity) : m_capacity(capacity) {}
+
+  bool push(size_t seq, T item) {
+    std::unique_lock lock(m_mutex);
+    m_room.wait(lock, [&] { return m_closed or seq < m_next + m_capacity; });
+    if (m_closed) return false;
+    m_pending.emplace(seq, std::move(item));
+    bool is_next = seq == m_next;
+    lock.unlock();
+    if (is_next) m_ready.notify_one();
+    return true;
+  }
+  // Once closed, skips over sequence numbers that never arrived
+  std::optional<T> pop() {
+    std::unique_lock lock(m_mutex);
+    m_ready.wait(lock, [this] {
+      return m_closed or (not m_pending.empty() and m_pending.begin()->first == m_next);
+    });
+    if (m_pending.empty()) return std::nullopt;
+    auto first = m_pending.begin();
+    T item = std::move(first->second);
+    m_next = first->first + 1;
+    m_pending.erase(first);
+    lock.unlock();
+    m_room.notify_all();
+    return item;
+  }
+  void close() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_closed = true;
+    }
+    m_ready.notify_all();
+    m_room.notify_all();
+  }
+};
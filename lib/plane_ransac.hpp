@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <asio/post.hpp>
+#include <asio/thread_pool.hpp>
+#include <Eigen/Dense>
+
+struct PlaneRansacParams {
+  float distance_threshold = 0.3f; // m
+  int max_iterations = 50; // Hypotheses at most, as PCL's setMaxIterations
+  float confidence = 0.99f; // Stop once a better plane is this unlikely
+  // Every hypothesis is first scored on this many random points, and only
+  // the best few of each batch are scored on the whole cloud
+  int preemptive_points = 256;
+  int batch = 16;
+  int survivors = 4;
+  // Slices the whole-cloud counts are split into when a pool is given, 0
+  // for one per core
+  int threads = 0;
+  // Each slice takes at least this many points, small clouds stay on one
+  int min_points_per_thread = 16384;
+  // Least squares on the inliers of the best plane, as PCL's
+  // setOptimizeCoefficients
+  bool refine = true;
+  // Only planes whose normal is within max_tilt of the axis, as PCL's
+  // SACMODEL_PERPENDICULAR_PLANE
+  std::optional<Eigen::Vector3f> axis;
+  float max_tilt = 0.0f; // radians
+  uint32_t seed = 12345;
+};
+
+struct PlaneFit {
+  Eigen::Vector4f plane; // ax + by + cz + d = 0 with a unit normal
+  size_t inliers;
+  int iterations; // Hypotheses generated
+};
+
+// RANSAC plane fitting for the ground. Same results as PCL's
+// SACSegmentation, but a hypothesis costs a few hundred point tests rather
+// than the whole cloud: hypotheses are generated in batches, scored on a
+// random subset, and only each batch's best are counted on every point.
+// Iterations stop adaptively once the best plane's inlier ratio makes a
+// better one unlikely. Given a pool, the whole-cloud counts are split
+// between it and the calling thread; without one everything runs on the
+// calling thread, as when each camera already has a pool thread of its own.
+class PlaneRansac {
+  PlaneRansacParams m_params;
+  asio::thread_pool* m_pool; // Null to count on the calling thread only
+  std::mt19937 m_rng;
+  // Coordinates one array each, so the inlier counts vectorize
+  std::vector<float> m_x, m_y, m_z;
+  std::vector<float> m_sx, m_sy, m_sz;
+
+  struct Hypothesis {
+    Eigen::Vector4f plane;
+    size_t score = 0;
+  };
+
+  static size_t count_inliers(const Eigen::Vector4f& p, float threshold, const float* x, const float* y,
+                              const float* z, size_t n) {
+    const float a = p[0], b = p[1], c = p[2], d = p[3];
+    size_t inliers = 0;
+    for (size_t i = 0; i < n; i++) inliers += std::abs(a * x[i] + b * y[i] + c * z[i] + d) <= threshold;
+    return inliers;
+  }
+
+  // Inliers of each hypothesis over the whole cloud, the first slice on the
+  // calling thread and the others on the pool
+  void score_all(std::span<Hypothesis> hypotheses) const {
+    const size_t n = m_x.size();
+    size_t slices = 1;
+    if (m_pool) {
+      const int cores = m_params.threads > 0 ? m_params.threads : std::max(1u, std::thread::hardware_concurrency());
+      slices = std::clamp<size_t>(n / std::max(1, m_params.min_points_per_thread), 1, cores);
+    }
+    auto slice = [&](size_t s) {
+      const size_t begin = n * s / slices, end = n * (s + 1) / slices;
+      std::vector<size_t> counts;
+      for (const auto& h : hypotheses) {
+        counts.push_back(count_inliers(h.plane, m_params.distance_threshold, &m_x[begin], &m_y[begin], &m_z[begin],
+                                       end - begin));
+      }
+      return counts;
+    };
+    std::vector<std::future<std::vector<size_t>>> others;
+    for (size_t s = 1; s < slices; s++) {
+      std::packaged_task<std::vector<size_t>()> task([&slice, s] { return slice(s); });
+      others.push_back(task.get_future());
+      asio::post(*m_pool, std::move(task));
+    }
+    auto counts = slice(0);
+    for (auto& other : others) {
+      auto more = other.get();
+      for (size_t i = 0; i < counts.size(); i++) counts[i] += more[i];
+    }
+    for (size_t i = 0; i < hypotheses.size(); i++) hypotheses[i].score = counts[i];
+  }
+
+  // A plane through three random points, if they span one the axis allows
+  std::optional<Eigen::Vector4f> hypothesize() {
+    std::uniform_int_distribution<size_t> pick(0, m_x.size() - 1);
+    const size_t i = pick(m_rng), j = pick(m_rng), k = pick(m_rng);
+    if (i == j or j == k or i == k) return std::nullopt;
+    const Eigen::Vector3f a(m_x[i], m_y[i], m_z[i]), b(m_x[j], m_y[j], m_z[j]), c(m_x[k], m_y[k], m_z[k]);
+    Eigen::Vector3f normal = (b - a).cross(c - a);
+    const float norm = normal.norm();
+    if (norm < 1e-6f) return std::nullopt; // Collinear
+    normal /= norm;
+    if (m_params.axis and std::abs(normal.dot(*m_params.axis)) < std::cos(m_params.max_tilt)) return std::nullopt;
+    return Eigen::Vector4f(normal.x(), normal.y(), normal.z(), -normal.dot(a));
+  }
+
+  // Hypotheses needed to draw an all-inlier sample with the confidence asked
+  int needed_iterations(double inlier_ratio) const {
+    const double p_good = std::pow(inlier_ratio, 3);
+    if (p_good >= 1.0) return 1;
+    if (p_good <= 0.0) return m_params.max_iterations;
+    const double k = std::log(1.0 - m_params.confidence) / std::log(1.0 - p_good);
+    return std::isfinite(k) ? int(std::min<double>(std::ceil(k), m_params.max_iterations)) : m_params.max_iterations;
+  }
+
+  // Total least squares on the inliers: the normal is the covariance's
+  // smallest eigenvector
+  Eigen::Vector4f refine(const Eigen::Vector4f& plane) const {
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d outer = Eigen::Matrix3d::Zero();
+    size_t n = 0;
+    for (size_t i = 0; i < m_x.size(); i++) {
+      if (std::abs(plane[0] * m_x[i] + plane[1] * m_y[i] + plane[2] * m_z[i] + plane[3]) > m_params.distance_threshold) continue;
+      const Eigen::Vector3d p(m_x[i], m_y[i], m_z[i]);
+      sum += p;
+      outer += p * p.transpose();
+      n++;
+    }
+    if (n < 3) return plane;
+    const Eigen::Vector3d mean = sum / n;
+    const Eigen::Matrix3d covariance = outer / n - mean * mean.transpose();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    Eigen::Vector3f normal = solver.eigenvectors().col(0).cast<float>();
+    // Same side as the hypothesis, so callers can rely on its orientation
+    if (normal.dot(plane.head<3>()) < 0.0f) normal = -normal;
+    return Eigen::Vector4f(normal.x(), normal.y(), normal.z(), -normal.dot(mean.cast<float>()));
+  }
+
+  public:
+  // pool must not be the one the caller runs on, fit() waits for it
+  explicit PlaneRansac(const PlaneRansacParams& params = {}, asio::thread_pool* pool = nullptr)
+    : m_params(params), m_pool(pool), m_rng(params.seed) {}
+
+  // points is anything with x, y and z members, eg. a pcl::PointCloud's
+  // points; points that aren't finite are skipped
+  template <typename Points>
+  std::optional<PlaneFit> fit(const Points& points) {
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    for (const auto& p : points) {
+      if (not (std::isfinite(p.x) and std::isfinite(p.y) and std::isfinite(p.z))) continue;
+      m_x.push_back(p.x);
+      m_y.push_back(p.y);
+      m_z.push_back(p.z);
+    }
+    const size_t n = m_x.size();
+    if (n < 3) return std::nullopt;
+
+    // One random subset for every hypothesis, so their scores compare
+    m_sx.clear();
+    m_sy.clear();
+    m_sz.clear();
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    const size_t subset = std::min<size_t>(n, std::max(1, m_params.preemptive_points));
+    for (size_t i = 0; i < subset; i++) {
+      const size_t j = subset == n ? i : pick(m_rng);
+      m_sx.push_back(m_x[j]);
+      m_sy.push_back(m_y[j]);
+      m_sz.push_back(m_z[j]);
+    }
+
+    std::optional<Hypothesis> best;
+    int iterations = 0, needed = m_params.max_iterations, attempts = 0;
+    std::vector<Hypothesis> batch;
+    while (iterations < needed and attempts < 100 * m_params.max_iterations) {
+      batch.clear();
+      const int size = std::min(std::max(1, m_params.batch), needed - iterations);
+      while (int(batch.size()) < size and attempts++ < 100 * m_params.max_iterations) {
+        if (auto plane = hypothesize()) {
+          batch.push_back({ *plane, count_inliers(*plane, m_params.distance_threshold, m_sx.data(), m_sy.data(),
+                                                  m_sz.data(), m_sx.size()) });
+        }
+      }
+      if (batch.empty()) break;
+      iterations += batch.size();
+      const size_t survivors = std::min<size_t>(batch.size(), std::max(1, m_params.survivors));
+      std::partial_sort(batch.begin(), batch.begin() + survivors, batch.end(),
+                        [](const auto& a, const auto& b) { return a.score > b.score; });
+      score_all(std::span(batch).first(survivors));
+      for (size_t i = 0; i < survivors; i++) {
+        if (not best or batch[i].score > best->score) best = batch[i];
+      }
+      needed = needed_iterations(double(best->score) / n);
+    }
+    if (not best) return std::nullopt;
+
+    PlaneFit fit{ best->plane, best->score, iterations };
+    if (m_params.refine) {
+      // Obstacles at the edge of the band can pull the fit off the ground,
+      // only take it if it holds at least as many points
+      const auto refined = refine(best->plane);
+      const size_t inliers = count_inliers(refined, m_params.distance_threshold, m_x.data(), m_y.data(), m_z.data(), n);
+      if (inliers >= fit.inliers) fit = { refined, inliers, iterations };
+    }
+    return fit;
+  }
+};
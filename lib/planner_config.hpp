@@ -0,0 +1,305 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <functional>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <signal.h>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+#include "expected.hpp"
+#include "obstacle_bins.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class ConfigErrc {
+  // 0 implies success
+  Unreadable = 10, // Missing file or malformed JSON
+  UnknownKey = 20, // Usually a typo
+  InvalidValue,
+};
+struct ConfigErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "PlannerConfig";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<ConfigErrc>(ev)) {
+      case ConfigErrc::Unreadable:
+      return "could not read config file as JSON";
+      case ConfigErrc::UnknownKey:
+      return "config file has an unknown key";
+      case ConfigErrc::InvalidValue:
+      return "config file has a value out of range";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const ConfigErrCategory configerrc_category;
+inline std::error_code make_error_code(ConfigErrc e) {
+  return {static_cast<int>(e), configerrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<ConfigErrc> : true_type {};
+}
+
+// Every tuning knob of the planners. Defaults come from the command line and
+// the config file overrides them. Structural knobs are only read at startup.
+struct PlannerConfig {
+  struct Perception {
+    float detection_threshold = 0.5f;
+    int vote_window = 5; // Structural: detections voted over
+    float ground_threshold = 0.3f; // m
+    float cone_direct_score = 0.85f; // Structural
+    BinParams bins;
+  } perception;
+  struct Motion {
+    float velocity = 0.1f; // m/s
+    float turning_speed = 0.1f;
+    float waypoint_threshold = 2.0f; // m
+    float waypoint_distance = 5.0f; // m
+    float servo_stop_range = 1.0f; // m
+    float servo_max_speed = 1.5f; // m/s
+  } motion;
+  struct Pipeline {
+    std::string model = "yolov8"; // Structural
+    std::string provider = "cpu"; // Structural
+    int tick_budget_ms = 100;
+    bool track_obstacles = false; // Structural
+    // Structural: ONNX Runtime's thread pools, 0 for its defaults
+    int intra_op_threads = 0;
+    int inter_op_threads = 0;
+    bool parallel_execution = false; // Structural: run independent graph branches concurrently
+  } pipeline;
+  struct Mavlink {
+    float position_rate_hz = 10.0f; // Structural: requested once at init
+    int setpoint_period_ms = 80; // Pause between ticks
+  } mavlink;
+};
+
+namespace planner_config {
+
+// One key of the config file: how to parse it into a PlannerConfig, and
+// whether it may change while the planner runs
+struct Field {
+  const char* key;
+  bool structural;
+  std::function<bool(PlannerConfig&, const std::string&)> parse;
+  std::function<bool(const PlannerConfig&)> valid; // The value in range, however it got there
+  std::function<bool(const PlannerConfig&, const PlannerConfig&)> same;
+  std::function<void(PlannerConfig&, const PlannerConfig&)> copy;
+};
+
+template <typename T>
+std::optional<T> parse_value(const std::string& value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (value == "true") return true;
+    if (value == "false") return false;
+    return std::nullopt;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return value;
+  } else {
+    T parsed;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (ec != std::errc{} or end != value.data() + value.size()) return std::nullopt;
+    return parsed;
+  }
+}
+
+template <typename Get>
+using member_t = std::remove_reference_t<std::invoke_result_t<Get, PlannerConfig&>>;
+
+// get is a generic lambda from a (const) PlannerConfig to the member
+template <typename Get>
+Field field(const char* key, Get get, std::function<bool(const member_t<Get>&)> valid = {}, bool structural = false) {
+  using T = member_t<Get>;
+  return { key, structural,
+           [=](PlannerConfig& c, const std::string& value) {
+             auto parsed = parse_value<T>(value);
+             if (not parsed or (valid and not valid(*parsed))) return false;
+             get(c) = *parsed;
+             return true;
+           },
+           [=](const PlannerConfig& c) { return not valid or valid(get(c)); },
+           [=](const PlannerConfig& a, const PlannerConfig& b) { return get(a) == get(b); },
+           [=](PlannerConfig& to, const PlannerConfig& from) { get(to) = get(from); } };
+}
+template <typename T>
+auto in_range(T lo, T hi) {
+  return [=](const T& v) { return v >= lo and v <= hi; };
+}
+constexpr bool STRUCTURAL = true;
+
+inline const std::vector<Field>& fields() {
+  static const std::vector<Field> f = {
+    field("perception.detection_threshold", [](auto& c) -> auto& { return c.perception.detection_threshold; }, in_range(0.0f, 1.0f)),
+    field("perception.vote_window", [](auto& c) -> auto& { return c.perception.vote_window; }, in_range(1, 32), STRUCTURAL),
+    field("perception.ground_threshold", [](auto& c) -> auto& { return c.perception.ground_threshold; }, in_range(0.001f, 2.0f)),
+    field("perception.cone_direct_score", [](auto& c) -> auto& { return c.perception.cone_direct_score; }, in_range(0.0f, 2.0f), STRUCTURAL),
+    field("perception.bins.count", [](auto& c) -> auto& { return c.perception.bins.bins; }, in_range<size_t>(1, 72)),
+    { "perception.bins.reducer", false,
+      [](PlannerConfig& c, const std::string& value) {
+        auto reducer = parse_bin_reducer(value);
+        if (reducer) c.perception.bins.reducer = *reducer;
+        return reducer.has_value();
+      },
+      [](const PlannerConfig&) { return true; },
+      [](const PlannerConfig& a, const PlannerConfig& b) { return a.perception.bins.reducer == b.perception.bins.reducer; },
+      [](PlannerConfig& to, const PlannerConfig& from) { to.perception.bins.reducer = from.perception.bins.reducer; } },
+    field("perception.bins.k", [](auto& c) -> auto& { return c.perception.bins.k; }, in_range<size_t>(1, 16)),
+    field("perception.bins.percentile", [](auto& c) -> auto& { return c.perception.bins.percentile; }, in_range(0.0f, 1.0f)),
+    field("perception.bins.band_low_deg", [](auto& c) -> auto& { return c.perception.bins.band_low_deg; }, in_range(-90.0f, 90.0f)),
+    field("perception.bins.band_high_deg", [](auto& c) -> auto& { return c.perception.bins.band_high_deg; }, in_range(-90.0f, 90.0f)),
+    field("motion.velocity", [](auto& c) -> auto& { return c.motion.velocity; }, in_range(0.0f, 5.0f)),
+    field("motion.turning_speed", [](auto& c) -> auto& { return c.motion.turning_speed; }, in_range(0.0f, 1.0f)),
+    field("motion.waypoint_threshold", [](auto& c) -> auto& { return c.motion.waypoint_threshold; }, in_range(0.1f, 50.0f)),
+    field("motion.waypoint_distance", [](auto& c) -> auto& { return c.motion.waypoint_distance; }, in_range(0.1f, 100.0f)),
+    field("motion.servo_stop_range", [](auto& c) -> auto& { return c.motion.servo_stop_range; }, in_range(0.1f, 10.0f)),
+    field("motion.servo_max_speed", [](auto& c) -> auto& { return c.motion.servo_max_speed; }, in_range(0.0f, 5.0f)),
+    field("pipeline.model", [](auto& c) -> auto& { return c.pipeline.model; }, {}, STRUCTURAL),
+    field("pipeline.provider", [](auto& c) -> auto& { return c.pipeline.provider; }, {}, STRUCTURAL),
+    field("pipeline.tick_budget_ms", [](auto& c) -> auto& { return c.pipeline.tick_budget_ms; }, in_range(10, 1000)),
+    field("pipeline.track_obstacles", [](auto& c) -> auto& { return c.pipeline.track_obstacles; }, {}, STRUCTURAL),
+    field("pipeline.intra_op_threads", [](auto& c) -> auto& { return c.pipeline.intra_op_threads; }, in_range(0, 256), STRUCTURAL),
+    field("pipeline.inter_op_threads", [](auto& c) -> auto& { return c.pipeline.inter_op_threads; }, in_range(0, 256), STRUCTURAL),
+    field("pipeline.parallel_execution", [](auto& c) -> auto& { return c.pipeline.parallel_execution; }, {}, STRUCTURAL),
+    field("mavlink.position_rate_hz", [](auto& c) -> auto& { return c.mavlink.position_rate_hz; }, in_range(0.1f, 50.0f), STRUCTURAL),
+    field("mavlink.setpoint_period_ms", [](auto& c) -> auto& { return c.mavlink.setpoint_period_ms; }, in_range(0, 1000)),
+  };
+  return f;
+}
+
+inline void leaves(const boost::property_tree::ptree& tree, const std::string& prefix, std::vector<std::pair<std::string, std::string>>& out) {
+  for (const auto& [key, child] : tree) {
+    const std::string path = prefix.empty() ? key : prefix + "." + key;
+    if (child.empty()) {
+      out.emplace_back(path, child.data());
+    } else {
+      leaves(child, path, out);
+    }
+  }
+}
+
+} // namespace planner_config
+
+// Every value in range and the bin band the right way up, whether it came
+// from a file or the command line. source names it in the log.
+inline tResult<void> check_planner_config(const PlannerConfig& config, const std::string& source) {
+  for (const auto& field : planner_config::fields()) {
+    if (field.valid(config)) continue;
+    spdlog::error("{}: {} is out of range", source, field.key);
+    return make_unexpected(ConfigErrc::InvalidValue);
+  }
+  if (config.perception.bins.band_low_deg >= config.perception.bins.band_high_deg) {
+    spdlog::error("{}: bins.band_low_deg must be below bins.band_high_deg", source);
+    return make_unexpected(ConfigErrc::InvalidValue);
+  }
+  return {};
+}
+
+// Reads the JSON config at path over defaults. Every key must be known and
+// every value in range, or nothing is taken.
+inline tResult<PlannerConfig> load_planner_config(const std::string& path, PlannerConfig config) {
+  namespace pt = boost::property_tree;
+  pt::ptree tree;
+  try {
+    pt::read_json(path, tree);
+  } catch (const pt::json_parser_error& e) {
+    spdlog::error("Config {}: {}", path, e.what());
+    return make_unexpected(ConfigErrc::Unreadable);
+  }
+  std::vector<std::pair<std::string, std::string>> values;
+  planner_config::leaves(tree, "", values);
+  const auto& fields = planner_config::fields();
+  for (const auto& [key, value] : values) {
+    auto field = std::find_if(fields.begin(), fields.end(), [&](const auto& f) { return key == f.key; });
+    if (field == fields.end()) {
+      spdlog::error("Config {}: unknown key {}", path, key);
+      return make_unexpected(ConfigErrc::UnknownKey);
+    }
+    if (not field->parse(config, value)) {
+      spdlog::error("Config {}: bad value {} for {}", path, value, key);
+      return make_unexpected(ConfigErrc::InvalidValue);
+    }
+  }
+  if (auto checked = check_planner_config(config, "Config " + path); not checked) return make_unexpected(checked.error());
+  return config;
+}
+
+// Keys whose values differ between two configs
+inline std::vector<std::string> changed_keys(const PlannerConfig& a, const PlannerConfig& b) {
+  std::vector<std::string> keys;
+  for (const auto& field : planner_config::fields()) {
+    if (not field.same(a, b)) keys.push_back(field.key);
+  }
+  return keys;
+}
+
+// Holds the running config and re-reads the file on SIGHUP, eg.
+// `kill -HUP $(pidof arar_planner)` after editing it in the field. A reload
+// that fails validation changes nothing; one that touches structural knobs
+// applies the rest and warns that those need a restart.
+class ConfigReloader {
+  static inline std::atomic<int> s_hangups = 0;
+  static_assert(std::atomic<int>::is_always_lock_free);
+  static void on_signal(int) { s_hangups++; }
+
+  std::string m_path;
+  PlannerConfig m_defaults;
+  PlannerConfig m_current;
+
+  ConfigReloader(std::string path, const PlannerConfig& defaults, const PlannerConfig& current)
+    : m_path(std::move(path)), m_defaults(defaults), m_current(current) {}
+
+  public:
+  // Without a path the defaults are all there is and SIGHUP is left alone.
+  // The defaults are checked like a file, they usually come from flags.
+  static tResult<ConfigReloader> open(const std::string& path, const PlannerConfig& defaults) {
+    if (auto checked = check_planner_config(defaults, "Flags"); not checked) return make_unexpected(checked.error());
+    if (path.empty()) return ConfigReloader(path, defaults, defaults);
+    auto config = load_planner_config(path, defaults);
+    if (not config) return make_unexpected(config.error());
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &sa, nullptr);
+    return ConfigReloader(path, defaults, *config);
+  }
+  static void trigger() { s_hangups++; }
+
+  const PlannerConfig& current() const { return m_current; }
+
+  // Called between ticks, so a tick never sees half a reload. The new
+  // config when a SIGHUP brought changes, empty otherwise.
+  std::optional<PlannerConfig> poll() {
+    if (m_path.empty() or s_hangups.exchange(0) == 0) return std::nullopt;
+    auto config = load_planner_config(m_path, m_defaults);
+    if (not config) {
+      spdlog::error("Keeping the running config: {}", config.error().message());
+      return std::nullopt;
+    }
+    for (const auto& field : planner_config::fields()) {
+      if (not field.structural or field.same(*config, m_current)) continue;
+      spdlog::warn("Config {} changed, restart to apply it", field.key);
+      field.copy(*config, m_current);
+    }
+    auto changed = changed_keys(m_current, *config);
+    if (changed.empty()) return std::nullopt;
+    spdlog::info("Config reloaded: {}", fmt::join(changed, ", "));
+    m_current = *config;
+    return m_current;
+  }
+};
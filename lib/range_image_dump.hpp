@@ -0,0 +1,308 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+#include "expected.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class DumpErrc {
+  // 0 implies success
+  OpenFailed = 10, // Setup error
+  MapFailed,
+  BadHeader = 20, // Not a range image dump, or a different version
+};
+struct DumpErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "RangeImageDump";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<DumpErrc>(ev)) {
+      case DumpErrc::OpenFailed:
+      return "could not open dump file";
+      case DumpErrc::MapFailed:
+      return "could not memory-map dump file";
+      case DumpErrc::BadHeader:
+      return "not a range image dump of a supported version";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const DumpErrCategory dumperrc_category;
+inline std::error_code make_error_code(DumpErrc e) {
+  return {static_cast<int>(e), dumperrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<DumpErrc> : true_type {};
+}
+
+// On-disk layout: a FileHeader, then back-to-back records of a FrameHeader
+// followed by width*height float ranges (row-major, -inf where nothing was
+// seen) and bin_count uint16_t obstacle distances in cm, padded to 8 bytes.
+namespace range_dump {
+constexpr uint32_t MAGIC = 0x44494d52; // "RMID"
+constexpr uint32_t VERSION = 1;
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+struct FrameHeader {
+  uint32_t record_size; // Including this header and padding
+  uint32_t width;
+  uint32_t height;
+  uint32_t bin_count;
+  double timestamp_ms; // Timestamp of the depth frame
+  float angular_resolution; // radians per pixel
+  float fov[2]; // radians
+  float ground_plane[4]; // ax + by + cz + d = 0
+  uint32_t reserved;
+};
+static_assert(sizeof(FrameHeader) % 8 == 0);
+
+constexpr size_t record_size(uint32_t width, uint32_t height, uint32_t bins) {
+  size_t size = sizeof(FrameHeader) + sizeof(float) * width * height + sizeof(uint16_t) * bins;
+  return (size + 7) & ~size_t(7);
+}
+}
+
+// One snapshot of the obstacle pipeline
+struct RangeFrame {
+  range_dump::FrameHeader header{};
+  std::vector<float> range;
+  std::vector<uint16_t> bins;
+};
+
+// Appends RangeFrames to a file from a background thread, so the obstacle
+// pipeline never waits on the disk. When the writer falls behind by more than
+// queue_depth frames, new frames are dropped and counted.
+class RangeImageDump {
+  int m_fd;
+  size_t m_queue_depth;
+  std::mutex m_mutex;
+  std::condition_variable_any m_cv;
+  std::deque<RangeFrame> m_queue;
+  std::atomic<size_t> m_written = 0;
+  std::atomic<size_t> m_dropped = 0;
+  std::vector<char> m_buffer;
+  std::jthread m_writer;
+
+  bool write_all(const char* data, size_t size) {
+    while (size) {
+      ssize_t n = ::write(m_fd, data, size);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      data += n;
+      size -= n;
+    }
+    return true;
+  }
+  bool write_frame(RangeFrame& frame) {
+    auto& h = frame.header;
+    if (frame.range.size() != size_t(h.width) * h.height) {
+      spdlog::warn("Range image is {} floats, expected {}x{}: not dumped", frame.range.size(), h.width, h.height);
+      return true;
+    }
+    h.bin_count = frame.bins.size();
+    h.record_size = range_dump::record_size(h.width, h.height, h.bin_count);
+    m_buffer.assign(h.record_size, 0);
+    char* out = m_buffer.data();
+    std::memcpy(out, &h, sizeof(h));
+    out += sizeof(h);
+    std::memcpy(out, frame.range.data(), sizeof(float) * h.width * h.height);
+    out += sizeof(float) * h.width * h.height;
+    std::memcpy(out, frame.bins.data(), sizeof(uint16_t) * h.bin_count);
+    return write_all(m_buffer.data(), m_buffer.size());
+  }
+  void run(std::stop_token stop) {
+    while (true) {
+      RangeFrame frame;
+      {
+        std::unique_lock lock(m_mutex);
+        // The predicate is checked first, so queued frames are drained before stopping
+        if (not m_cv.wait(lock, stop, [this] { return not m_queue.empty(); })) break;
+        frame = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      if (not write_frame(frame)) {
+        spdlog::error("Range image dump write failed: {}", std::strerror(errno));
+        break;
+      }
+      m_written++;
+    }
+  }
+  RangeImageDump(int fd, size_t queue_depth) : m_fd(fd), m_queue_depth(queue_depth) {
+    m_writer = std::jthread([this](std::stop_token stop) { run(stop); });
+  }
+
+  public:
+  static auto open(const std::string& path, size_t queue_depth = 64)
+    -> tResult<std::unique_ptr<RangeImageDump>> {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      spdlog::error("Could not open range image dump {}: {}", path, std::strerror(errno));
+      return make_unexpected(DumpErrc::OpenFailed);
+    }
+    range_dump::FileHeader header{ range_dump::MAGIC, range_dump::VERSION };
+    if (::write(fd, &header, sizeof(header)) != sizeof(header)) {
+      ::close(fd);
+      return make_unexpected(DumpErrc::OpenFailed);
+    }
+    return std::unique_ptr<RangeImageDump>(new RangeImageDump(fd, queue_depth));
+  }
+  RangeImageDump(const RangeImageDump&) = delete;
+  RangeImageDump& operator=(const RangeImageDump&) = delete;
+  ~RangeImageDump() {
+    m_writer.request_stop();
+    m_writer.join();
+    ::close(m_fd);
+  }
+
+  // Never blocks on I/O; returns false if the frame was dropped
+  bool submit(RangeFrame frame) {
+    {
+      std::lock_guard lock(m_mutex);
+      if (m_queue.size() >= m_queue_depth) {
+        m_dropped++;
+        return false;
+      }
+      m_queue.push_back(std::move(frame));
+    }
+    m_cv.notify_one();
+    return true;
+  }
+  size_t queued() {
+    std::lock_guard lock(m_mutex);
+    return m_queue.size();
+  }
+  size_t written() const { return m_written; }
+  size_t dropped() const { return m_dropped; }
+};
+
+// Decides which frames get dumped: every nth frame (0 disables sampling), plus
+// a burst of frames whenever the trigger signal arrives.
+class RangeDumpSampler {
+  static inline std::atomic<int> s_triggers = 0;
+  static_assert(std::atomic<int>::is_always_lock_free);
+  static void on_signal(int) { s_triggers++; }
+
+  size_t m_every;
+  size_t m_burst;
+  size_t m_frame = 0;
+  size_t m_burst_left = 0;
+
+  public:
+  RangeDumpSampler(size_t every, size_t burst = 30) : m_every(every), m_burst(burst) {}
+  // eg. `kill -USR1 $(pidof arar_planner)` while the rover sees something odd
+  static void install_trigger(int sig = SIGUSR1) {
+    struct sigaction sa{};
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(sig, &sa, nullptr);
+  }
+  static void trigger() { s_triggers++; }
+
+  bool sample() {
+    if (s_triggers.exchange(0) > 0) m_burst_left = m_burst;
+    bool take = m_burst_left > 0 or (m_every and m_frame % m_every == 0);
+    if (m_burst_left) m_burst_left--;
+    m_frame++;
+    return take;
+  }
+};
+
+struct RangeFrameView {
+  const range_dump::FrameHeader* header;
+  std::span<const float> range;
+  std::span<const uint16_t> bins;
+  float at(uint32_t row, uint32_t col) const { return range[row * header->width + col]; }
+};
+
+// Memory-maps a dump and indexes its frames; nothing is copied. A record cut
+// short by a crash ends the index.
+class RangeImageReader {
+  const char* m_data = nullptr;
+  size_t m_size = 0;
+  std::vector<const range_dump::FrameHeader*> m_frames;
+
+  RangeImageReader(const char* data, size_t size) : m_data(data), m_size(size) {
+    size_t offset = sizeof(range_dump::FileHeader);
+    while (offset + sizeof(range_dump::FrameHeader) <= m_size) {
+      auto header = reinterpret_cast<const range_dump::FrameHeader*>(m_data + offset);
+      if (header->record_size != range_dump::record_size(header->width, header->height, header->bin_count)
+          or offset + header->record_size > m_size) break;
+      m_frames.push_back(header);
+      offset += header->record_size;
+    }
+  }
+
+  public:
+  static auto open(const std::string& path) -> tResult<RangeImageReader> {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return make_unexpected(DumpErrc::OpenFailed);
+    struct stat st;
+    if (fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(range_dump::FileHeader)) {
+      ::close(fd);
+      return make_unexpected(DumpErrc::BadHeader);
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return make_unexpected(DumpErrc::MapFailed);
+    auto header = static_cast<const range_dump::FileHeader*>(addr);
+    if (header->magic != range_dump::MAGIC or header->version != range_dump::VERSION) {
+      munmap(addr, st.st_size);
+      return make_unexpected(DumpErrc::BadHeader);
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    return RangeImageReader(static_cast<const char*>(addr), st.st_size);
+  }
+  RangeImageReader(RangeImageReader&& o) noexcept
+    : m_data(std::exchange(o.m_data, nullptr))
+    , m_size(std::exchange(o.m_size, 0))
+    , m_frames(std::move(o.m_frames)) {}
+  RangeImageReader& operator=(RangeImageReader&& o) noexcept {
+    std::swap(m_data, o.m_data);
+    std::swap(m_size, o.m_size);
+    std::swap(m_frames, o.m_frames);
+    return *this;
+  }
+  ~RangeImageReader() {
+    if (m_data) munmap(const_cast<char*>(m_data), m_size);
+  }
+
+  size_t size() const { return m_frames.size(); }
+  RangeFrameView operator[](size_t i) const {
+    auto header = m_frames[i];
+    auto range = reinterpret_cast<const float*>(header + 1);
+    auto bins = reinterpret_cast<const uint16_t*>(range + size_t(header->width) * header->height);
+    return { header,
+             { range, size_t(header->width) * header->height },
+             { bins, header->bin_count } };
+  }
+};
@@ -2,13 +2,20 @@
 
 #include "common.hpp"
 #include "expected.hpp"
+#include "frame_view.hpp"
+#include "gravity_filter.hpp"
+#include "metrics.hpp"
 #include <asio/async_result.hpp>
 #include <asio/io_context.hpp>
 #include <asio/steady_timer.hpp>
 #include <compare>
 #include <librealsense2/h/rs_sensor.h>
 #include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
 #include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <chrono>
 #include <librealsense2/hpp/rs_frame.hpp>
@@ -17,8 +24,11 @@
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <algorithm>
 #include <ranges>
+#include <string>
 #include <system_error>
+#include <vector>
 
 #include <librealsense2/rs.hpp>
 #include <librealsense2/rsutil.h>
@@ -32,6 +42,7 @@ enum class DeviceErrc {
   // 0 imples success
   NoDeviceConnected = 10, // Setup error
   LibrsError = 20, // librealsense gave back an error
+  SimulatorError = 30, // Gazebo transport gave back an error
 };
 struct DeviceErrCategory : std::error_category {
   const char* name() const noexcept override {
@@ -43,6 +54,8 @@ struct DeviceErrCategory : std::error_category {
       return "no device connected: cannot acquire data";
       case DeviceErrc::LibrsError:
       return "failure in librealsense";
+      case DeviceErrc::SimulatorError:
+      return "could not subscribe to simulated camera";
       default:
       return "(unrecognized error)";
     }
@@ -56,7 +69,21 @@ namespace std {
   template <>
   struct is_error_code_enum<DeviceErrc> : true_type {};
 }
-auto setup_device() noexcept -> tResult<std::tuple<rs2::pipeline, float, float>> {
+// Serial numbers of the connected realsense devices
+inline auto device_serials() noexcept -> std::vector<std::string> {
+  std::vector<std::string> serials;
+  try {
+    rs2::context ctx;
+    for (auto&& device : ctx.query_devices()) {
+      serials.emplace_back(device.get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Exception listing realsense devices: {}", e.what());
+  }
+  return serials;
+}
+// The device with this serial number, or the first one found when it's empty
+auto setup_device(const std::string& serial = {}) noexcept -> tResult<std::tuple<rs2::pipeline, float, float>> {
   try{
     rs2::pipeline pipe;
     rs2::config stream_config;
@@ -65,11 +92,20 @@ auto setup_device() noexcept -> tResult<std::tuple<rs2::pipeline, float, float>>
 
     auto devices = ctx.query_devices();
     if (devices.size() == 0) return make_unexpected(DeviceErrc::NoDeviceConnected);
+    if (not serial.empty()) {
+      auto serials = device_serials();
+      if (std::ranges::find(serials, serial) == serials.end()) {
+        spdlog::error("No realsense device {}, connected: {}", serial, fmt::join(serials, ", "));
+        return make_unexpected(DeviceErrc::NoDeviceConnected);
+      }
+      stream_config.enable_device(serial);
+    }
     stream_config.enable_stream(rs2_stream::RS2_STREAM_COLOR, 0, 640, 480, rs2_format::RS2_FORMAT_BGR8, 30); // Choose resolution here
     stream_config.enable_stream(rs2_stream::RS2_STREAM_DEPTH, 0, 640, 480, rs2_format::RS2_FORMAT_Z16, 30);
     rs2::pipeline_profile selection = pipe.start(stream_config);
     auto depth_stream = selection.get_stream(RS2_STREAM_DEPTH).as<rs2::video_stream_profile>();
-    spdlog::info("Depth stream {}x{}", depth_stream.width(), depth_stream.height());
+    spdlog::info("Depth stream {}x{} from {}", depth_stream.width(), depth_stream.height(),
+                 selection.get_device().get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
     auto i = depth_stream.get_intrinsics();
     rs2_fov(&i, fov);
     fov[0] = (fov[0] * M_PI)/180.0f;
@@ -82,11 +118,75 @@ auto setup_device() noexcept -> tResult<std::tuple<rs2::pipeline, float, float>>
   }
 }
 
+// Views of a frame's pixels, valid while the frame is held
+inline DepthView depth_view(const rs2::depth_frame& depth) {
+  auto i = depth.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+  return { static_cast<const uint16_t*>(depth.get_data()), depth.get_width(), depth.get_height(),
+           depth.get_stride_in_bytes() / int(sizeof(uint16_t)), depth.get_units(),
+           { i.fx, i.fy, i.ppx, i.ppy }, depth.get_timestamp() };
+}
+inline ColorView color_view(const rs2::video_frame& color) {
+  return { static_cast<const uint8_t*>(color.get_data()), color.get_width(), color.get_height(),
+           color.get_stride_in_bytes() };
+}
+
+// Gyro and accelerometer of a D435i/D455 on a pipeline of their own, as
+// they stream far faster than the frames are polled. Samples arrive on a
+// librealsense thread and feed a GravityFilter.
+class ImuGravity {
+  rs2::pipeline m_pipe;
+  mutable std::mutex m_mutex;
+  GravityFilter m_filter;
+
+  void on_frame(const rs2::frame& frame) {
+    auto motion = frame.as<rs2::motion_frame>();
+    if (not motion) return;
+    auto v = motion.get_motion_data();
+    std::lock_guard lock(m_mutex);
+    if (motion.get_profile().stream_type() == RS2_STREAM_GYRO) {
+      m_filter.gyro(Eigen::Vector3f(v.x, v.y, v.z), motion.get_timestamp());
+    } else {
+      m_filter.accel(Eigen::Vector3f(v.x, v.y, v.z));
+    }
+  }
+
+  public:
+  // Up in the depth camera frame, which the IMU axes are aligned to
+  std::optional<Eigen::Vector3f> up() const {
+    std::lock_guard lock(m_mutex);
+    return m_filter.up();
+  }
+  // The device with this serial number, or the first one found when it's empty
+  static auto start(const std::string& serial = {}) noexcept -> tResult<std::shared_ptr<ImuGravity>> {
+    try {
+      auto serials = device_serials();
+      if (serials.empty()) return make_unexpected(DeviceErrc::NoDeviceConnected);
+      rs2::config imu_config;
+      imu_config.enable_device(serial.empty() ? serials.front() : serial);
+      imu_config.enable_stream(RS2_STREAM_ACCEL, RS2_FORMAT_MOTION_XYZ32F);
+      imu_config.enable_stream(RS2_STREAM_GYRO, RS2_FORMAT_MOTION_XYZ32F);
+      auto imu = std::make_shared<ImuGravity>();
+      imu->m_pipe.start(imu_config, [imu = imu.get()](const rs2::frame& frame) { imu->on_frame(frame); });
+      return imu;
+    } catch (const std::exception& e) {
+      spdlog::error("Exception starting IMU: {}", e.what());
+      return make_unexpected(DeviceErrc::LibrsError);
+    }
+  }
+  ~ImuGravity() {
+    try {
+      m_pipe.stop();
+    } catch (const std::exception& e) {
+      spdlog::warn("Exception stopping IMU: {}", e.what());
+    }
+  }
+};
+
 class RealsenseDevice {
   // TODO: remove io_ctx
   auto async_update() -> asio::awaitable<void> {
     asio::steady_timer timer(m_io_ctx);
-    while (not pipe.poll_for_frames(&frames)) {
+    while (not m_poll(&frames)) {
       timer.expires_after(34ms);
       co_await timer.async_wait(use_nothrow_awaitable);
       spdlog::debug("Timer expired");
@@ -94,7 +194,11 @@ class RealsenseDevice {
   }
   
   public:
-  RealsenseDevice(rs2::pipeline& pipe, asio::io_context& io_ctx) : pipe{pipe}, m_io_ctx(io_ctx) {}
+  RealsenseDevice(rs2::pipeline& pipe, asio::io_context& io_ctx)
+    : RealsenseDevice([pipe](rs2::frameset* f) { return pipe.poll_for_frames(f); }, io_ctx) {}
+  // Any other source of framesets, eg. a software_device behind an rs2::syncer
+  RealsenseDevice(std::function<bool(rs2::frameset*)> poll, asio::io_context& io_ctx)
+    : m_poll(std::move(poll)), m_io_ctx(io_ctx) {}
   auto async_get_rgb_frame() -> asio::awaitable<rs2::frame> {
     rs2::frame rgb_frame = frames.first_or_default(RS2_STREAM_COLOR);
     do {
@@ -110,6 +214,7 @@ class RealsenseDevice {
       co_await async_update();
       depth = frames.get_depth_frame();
     } while (not depth);
+    count_frame(depth.get_frame_number());
     // Decimation > Spatial > Temporal > Threshold
     depth = temp_filter.process(depth);
     spdlog::debug("Depth Frame# {}", depth.get_frame_number());
@@ -120,9 +225,19 @@ class RealsenseDevice {
     co_return pc.calculate(depth);
   }
   private:
-  rs2::pipeline pipe;
+  std::function<bool(rs2::frameset*)> m_poll;
   asio::io_context& m_io_ctx;
   rs2::frameset frames;
+  unsigned long long m_last_frame = 0;
+  // Summed over all cameras
+  Counter& m_frames = metrics().counter("michi_camera_frames_total", "Depth frames processed");
+  Counter& m_skipped = metrics().counter("michi_camera_frames_skipped_total", "Depth frames the camera delivered that were never processed");
+
+  void count_frame(unsigned long long number) {
+    m_frames.inc();
+    if (m_last_frame and number > m_last_frame + 1) m_skipped.inc(number - m_last_frame - 1);
+    m_last_frame = number;
+  }
 
   rs2::temporal_filter temp_filter;
   rs2::pointcloud pc;
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ranges.h>
+#include "expected.hpp"
+
+template <typename T>
+using tResult = tl::expected<T, std::error_code>;
+using tl::make_unexpected;
+
+enum class RealtimeErrc {
+  // 0 implies success
+  LockFailed = 10, // Usually RLIMIT_MEMLOCK, see ulimit -l
+  ReserveFailed,
+  AffinityFailed = 20,
+  SchedulingFailed, // Needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+};
+struct RealtimeErrCategory : std::error_category {
+  const char* name() const noexcept override {
+    return "Realtime";
+  }
+  std::string message(int ev) const override {
+    switch (static_cast<RealtimeErrc>(ev)) {
+      case RealtimeErrc::LockFailed:
+      return "could not lock process memory";
+      case RealtimeErrc::ReserveFailed:
+      return "could not reserve heap";
+      case RealtimeErrc::AffinityFailed:
+      return "could not pin thread to cpus";
+      case RealtimeErrc::SchedulingFailed:
+      return "could not set realtime scheduling";
+      default:
+      return "(unrecognized error)";
+    }
+  }
+};
+inline const RealtimeErrCategory realtimeerrc_category;
+inline std::error_code make_error_code(RealtimeErrc e) {
+  return {static_cast<int>(e), realtimeerrc_category};
+}
+namespace std {
+  template <>
+  struct is_error_code_enum<RealtimeErrc> : true_type {};
+}
+
+struct RealtimeConfig {
+  std::vector<int> cpus; // Empty leaves the affinity alone
+  int priority = 50; // SCHED_FIFO priority, 0 leaves the scheduler alone
+  size_t heap_reserve = 64 << 20; // Bytes faulted in and kept by malloc
+  size_t stack_prefault = 512 << 10; // Bytes of the calling thread's stack
+};
+
+// "2,3" or "0-3,6"; empty on a malformed list
+inline std::vector<int> parse_cpu_list(std::string_view list) {
+  std::vector<int> cpus;
+  while (not list.empty()) {
+    auto comma = list.find(',');
+    auto item = list.substr(0, comma);
+    list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    auto dash = item.find('-');
+    std::string first(item.substr(0, dash));
+    std::string last(dash == std::string_view::npos ? item : item.substr(dash + 1));
+    char* end;
+    long from = std::strtol(first.c_str(), &end, 10);
+    if (first.empty() or *end) return {};
+    long to = std::strtol(last.c_str(), &end, 10);
+    if (last.empty() or *end or from < 0 or to < from or to >= CPU_SETSIZE) return {};
+    for (long cpu = from; cpu <= to; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Defined by the AddressSanitizer runtime when it is linked in
+extern "C" [[gnu::weak]] void __asan_init();
+
+namespace realtime_detail {
+  // Not inlined so the frame really is this deep below the caller
+  [[gnu::noinline]] inline void touch_stack(size_t bytes) {
+    volatile char* frame = static_cast<volatile char*>(alloca(bytes));
+    const long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += page) frame[i] = 0;
+  }
+}
+
+// True if the AddressSanitizer runtime is in the process. Checked at run time
+// rather than with __SANITIZE_ADDRESS__, since the planners only pass
+// -fsanitize=address when linking.
+inline bool under_address_sanitizer() {
+  return __asan_init != nullptr;
+}
+
+// Locks current and future pages in memory, then faults in a heap reserve
+// that malloc keeps instead of returning it to the kernel, and the top of the
+// calling thread's stack. After this, allocations up to the reserve on the
+// main arena and stack growth up to stack_prefault do not page fault. Other
+// threads' stacks are locked, and so populated, as they are mapped.
+inline auto lock_memory(const RealtimeConfig& config) -> tResult<void> {
+  if (under_address_sanitizer()) {
+    // Locking would populate terabytes of shadow memory
+    spdlog::error("Memory cannot be locked under AddressSanitizer");
+    return make_unexpected(RealtimeErrc::LockFailed);
+  }
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    spdlog::error("mlockall failed: {}", std::strerror(errno));
+    return make_unexpected(RealtimeErrc::LockFailed);
+  }
+  // Freed memory stays in the heap, and large blocks come from it too
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  if (config.heap_reserve) {
+    auto* reserve = static_cast<char*>(std::malloc(config.heap_reserve));
+    if (not reserve) return make_unexpected(RealtimeErrc::ReserveFailed);
+    const long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < config.heap_reserve; i += page) reserve[i] = 0;
+    std::free(reserve);
+  }
+  if (config.stack_prefault) realtime_detail::touch_stack(config.stack_prefault);
+  return {};
+}
+
+// Pins the calling thread and makes it SCHED_FIFO. Threads it creates later
+// inherit the affinity but not the priority (SCHED_RESET_ON_FORK), so worker
+// pools spawned from it cannot starve it.
+inline auto pin_current_thread(const RealtimeConfig& config) -> tResult<void> {
+  if (not config.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : config.cpus) CPU_SET(cpu, &set);
+    if (int e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); e != 0) {
+      spdlog::error("Could not pin to cpus {}: {}", config.cpus, std::strerror(e));
+      return make_unexpected(RealtimeErrc::AffinityFailed);
+    }
+  }
+  if (config.priority > 0) {
+    sched_param param{};
+    param.sched_priority = config.priority;
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) != 0) {
+      spdlog::error("Could not set SCHED_FIFO priority {}: {}", config.priority, std::strerror(errno));
+      return make_unexpected(RealtimeErrc::SchedulingFailed);
+    }
+  }
+  return {};
+}
+
+// Page faults of the process and context switches of the calling thread, as
+// rates since the previous sample
+class RusageSampler {
+  public:
+  using clock = std::chrono::steady_clock;
+  struct Rates {
+    double minor_faults = 0; // Per second
+    double major_faults = 0;
+    double voluntary_switches = 0;
+    double involuntary_switches = 0;
+  };
+
+  private:
+  rusage m_process;
+  rusage m_thread;
+  clock::time_point m_at;
+
+  void take(rusage& process, rusage& thread) {
+    getrusage(RUSAGE_SELF, &process);
+    getrusage(RUSAGE_THREAD, &thread);
+  }
+
+  public:
+  RusageSampler() {
+    take(m_process, m_thread);
+    m_at = clock::now();
+  }
+  Rates sample() {
+    rusage process, thread;
+    take(process, thread);
+    auto now = clock::now();
+    const double seconds = std::max(std::chrono::duration<double>(now - m_at).count(), 1e-6);
+    Rates r{ (process.ru_minflt - m_process.ru_minflt) / seconds, (process.ru_majflt - m_process.ru_majflt) / seconds,
+             (thread.ru_nvcsw - m_thread.ru_nvcsw) / seconds, (thread.ru_nivcsw - m_thread.ru_nivcsw) / seconds };
+    m_process = process;
+    m_thread = thread;
+    m_at = now;
+    return r;
+  }
+};
+
+// Startup self-check: allocates and touches half the heap reserve and counts
+// the page faults that caused, then reports fault and switch rates over the
+// rest of the window. Returns false if the reserve did not hold.
+inline bool realtime_self_check(const RealtimeConfig& config, std::chrono::milliseconds window = std::chrono::milliseconds(500)) {
+  rusage before, after;
+  getrusage(RUSAGE_SELF, &before);
+  if (size_t probe = config.heap_reserve / 2) {
+    auto* block = static_cast<volatile char*>(std::malloc(probe));
+    const long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; block and i < probe; i += page) block[i] = 1;
+    std::free(const_cast<char*>(block));
+  }
+  getrusage(RUSAGE_SELF, &after);
+  const long probe_faults = (after.ru_minflt - before.ru_minflt) + (after.ru_majflt - before.ru_majflt);
+  RusageSampler sampler;
+  usleep(std::chrono::duration_cast<std::chrono::microseconds>(window).count());
+  auto r = sampler.sample();
+  spdlog::info("Realtime self-check: {} faults allocating {} MiB, then {:.1f} minor {:.1f} major faults/s, "
+               "{:.1f} voluntary {:.1f} involuntary switches/s",
+               probe_faults, (config.heap_reserve / 2) >> 20, r.minor_faults, r.major_faults,
+               r.voluntary_switches, r.involuntary_switches);
+  // A handful of faults for malloc's own bookkeeping is expected
+  const bool held = probe_faults <= 8;
+  if (not held) spdlog::warn("Heap reserve did not hold, allocations are still page faulting");
+  return held;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/ranges.h>
+
+// Deadline-aware planning of the stages of one mission tick. Stages are
+// registered in the order they run, each with degradation levels given as
+// the fraction of the full cost they take (1.0 first, cheapest last). Before
+// a stage runs, plan() picks the best level whose predicted cost still leaves
+// room for the cheapest level of every later stage within the tick budget, so
+// the last stages (obstacle and setpoint output) are never squeezed out.
+// Costs are learnt as a moving average of the full-cost equivalent of each run.
+class TickScheduler {
+  public:
+  using clock = std::chrono::steady_clock;
+  using duration = std::chrono::nanoseconds;
+
+  struct StageStats {
+    uint64_t runs = 0;
+    std::vector<uint64_t> at_level; // Runs per degradation level
+    duration worst{ 0 };
+    duration last{ 0 };
+  };
+
+  private:
+  struct Stage {
+    std::string name;
+    std::vector<float> level_cost;
+    float full_cost_ns; // Moving average of cost / level_cost
+    StageStats stats;
+    int level = 0;
+    clock::time_point started;
+  };
+  duration m_budget;
+  float m_smoothing;
+  std::vector<Stage> m_stages;
+  clock::time_point m_tick_start;
+  uint64_t m_ticks = 0;
+  uint64_t m_overruns = 0;
+
+  float predicted_ns(const Stage& s, int level) const { return s.full_cost_ns * s.level_cost[level]; }
+
+  public:
+  explicit TickScheduler(duration budget, float smoothing = 0.2f) : m_budget(budget), m_smoothing(smoothing) {}
+  // Takes effect from the next tick
+  void set_budget(duration budget) { m_budget = budget; }
+
+  // Returns the id to plan and finish the stage with; expected is a first
+  // guess at the full cost until the stage has run
+  int add_stage(std::string name, duration expected, std::vector<float> level_cost = { 1.0f }) {
+    StageStats stats;
+    stats.at_level.assign(level_cost.size(), 0);
+    Stage s{ .name = std::move(name), .level_cost = std::move(level_cost), .full_cost_ns = float(expected.count()),
+             .stats = std::move(stats), .level = 0, .started = {} };
+    m_stages.push_back(std::move(s));
+    return m_stages.size() - 1;
+  }
+
+  void begin_tick(clock::time_point now = clock::now()) {
+    m_tick_start = now;
+    m_ticks++;
+  }
+  // Returns true if the tick ran over its budget
+  bool end_tick(clock::time_point now = clock::now()) {
+    bool over = now - m_tick_start > m_budget;
+    m_overruns += over;
+    return over;
+  }
+
+  int plan(int id, clock::time_point now = clock::now()) {
+    auto& s = m_stages[id];
+    float reserve_ns = 0.0f;
+    for (size_t i = id + 1; i < m_stages.size(); i++) {
+      reserve_ns += predicted_ns(m_stages[i], m_stages[i].level_cost.size() - 1);
+    }
+    const float left_ns = (m_budget - (now - m_tick_start)).count() - reserve_ns;
+    s.level = s.level_cost.size() - 1;
+    for (size_t l = 0; l < s.level_cost.size(); l++) {
+      if (predicted_ns(s, l) <= left_ns) {
+        s.level = l;
+        break;
+      }
+    }
+    s.started = now;
+    return s.level;
+  }
+  void finish(int id, clock::time_point now = clock::now()) {
+    auto& s = m_stages[id];
+    duration cost = now - s.started;
+    if (s.level_cost[s.level] > 0.0f) {
+      float full = cost.count() / s.level_cost[s.level];
+      s.full_cost_ns += m_smoothing * (full - s.full_cost_ns);
+    }
+    s.stats.runs++;
+    s.stats.at_level[s.level]++;
+    s.stats.worst = std::max(s.stats.worst, cost);
+    s.stats.last = cost;
+  }
+
+  // Plans a stage on construction and finishes it on destruction
+  class Run {
+    TickScheduler& m_scheduler;
+    int m_id;
+
+    public:
+    const int level;
+    Run(TickScheduler& scheduler, int id) : m_scheduler(scheduler), m_id(id), level(scheduler.plan(id)) {}
+    Run(const Run&) = delete;
+    ~Run() { m_scheduler.finish(m_id); }
+  };
+  Run run(int id) { return Run(*this, id); }
+
+  const StageStats& stats(int id) const { return m_stages[id].stats; }
+  uint64_t ticks() const { return m_ticks; }
+  uint64_t overruns() const { return m_overruns; }
+
+  // One line: overruns, then per stage the runs at each level and the worst cost
+  std::string summary() const {
+    std::string out = fmt::format("{} ticks, {} over {} ms", m_ticks, m_overruns,
+                                  std::chrono::duration<float, std::milli>(m_budget).count());
+    for (const auto& s : m_stages) {
+      out += fmt::format("; {} levels [{}] worst {:.1f} ms", s.name, fmt::join(s.stats.at_level, " "),
+                         std::chrono::duration<float, std::milli>(s.stats.worst).count());
+    }
+    return out;
+  }
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
+
+struct ServoParams {
+  float stop_range = 1.0f; // m, the servo closes to this range and stops
+  float speed_gain = 0.6f; // m/s per m of range beyond stop_range
+  float yaw_gain = 1.5f; // rad/s per rad of bearing error
+  float max_speed = 1.5f; // m/s
+  float max_yaw_rate = 1.0f; // rad/s
+  float max_accel = 1.0f; // m/s², how fast the speed setpoint may change
+  float max_yaw_accel = 3.0f; // rad/s²
+  float slow_bearing = 0.35f; // rad, speed fades to zero at twice this bearing error
+  std::chrono::milliseconds lost_timeout{ 400 };
+};
+
+// Body frame setpoint; yaw rate is positive clockwise seen from above, as in NED
+struct ServoCommand {
+  float forward;
+  float yaw_rate;
+};
+
+// Angle of a pixel column off the optical axis, positive to the right
+inline float pixel_bearing(float x, int image_width, float hfov_rad) {
+  const float focal = image_width / (2.0f * std::tan(hfov_rad / 2.0f));
+  return std::atan((x - image_width / 2.0f) / focal);
+}
+
+// Proportional controller from where the target is in the image to velocity
+// and yaw rate setpoints, run every frame. Setpoints are clamped and slew
+// limited. While the target is briefly lost the servo stops turning and
+// holds speed; after lost_timeout it disengages and the caller should fall
+// back to the position target.
+class VisualServo {
+  public:
+  using clock = std::chrono::steady_clock;
+  struct Sighting {
+    float bearing; // rad, positive to the right
+    float range; // m
+  };
+
+  private:
+  ServoParams m_params;
+  ServoCommand m_command{ 0.0f, 0.0f };
+  std::optional<clock::time_point> m_last_seen;
+  clock::time_point m_last_update;
+
+  static float slew(float from, float to, float max_step) {
+    return from + std::clamp(to - from, -max_step, max_step);
+  }
+
+  public:
+  explicit VisualServo(const ServoParams& params = {}) : m_params(params) {}
+  // Limits change on the next update; the current setpoint slews to them
+  void set_params(const ServoParams& params) { m_params = params; }
+
+  bool engaged() const { return m_last_seen.has_value(); }
+  void reset() { m_last_seen.reset(); }
+
+  // Empty while disengaged: before the first sighting and once the target
+  // has been out of sight for longer than lost_timeout
+  std::optional<ServoCommand> update(std::optional<Sighting> sighting, clock::time_point now) {
+    if (not sighting and (not m_last_seen or now - *m_last_seen > m_params.lost_timeout)) {
+      m_last_seen.reset();
+      return std::nullopt;
+    }
+    ServoCommand desired{ m_command.forward, 0.0f };
+    if (sighting) {
+      const float range_error = std::max(0.0f, sighting->range - m_params.stop_range);
+      const float alignment = std::max(0.0f, 1.0f - std::abs(sighting->bearing) / (2.0f * m_params.slow_bearing));
+      desired.forward = std::min(m_params.speed_gain * range_error, m_params.max_speed) * alignment;
+      desired.yaw_rate = std::clamp(m_params.yaw_gain * sighting->bearing, -m_params.max_yaw_rate, m_params.max_yaw_rate);
+    }
+    if (not m_last_seen) {
+      // The vehicle is already moving towards the target, so only the turn ramps in
+      m_command = { desired.forward, 0.0f };
+    } else {
+      const float dt = std::min(std::chrono::duration<float>(now - m_last_update).count(), 0.2f);
+      m_command.forward = slew(m_command.forward, desired.forward, m_params.max_accel * dt);
+      m_command.yaw_rate = slew(m_command.yaw_rate, desired.yaw_rate, m_params.max_yaw_accel * dt);
+    }
+    if (sighting or not m_last_seen) m_last_seen = now;
+    m_last_update = now;
+    return m_command;
+  }
+};
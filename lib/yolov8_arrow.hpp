@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
 
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
@@ -11,6 +12,7 @@
 #include <spdlog/spdlog.h>
 
 #include "classification_model.hpp"
+#include "ort_session.hpp"
 
 int calculate_product(const std::vector<std::int64_t>& v) {
   int total = 1;
@@ -46,13 +48,13 @@ const Yolov8Params MOHNISH7 {
 };
 
 class Yolov8ArrowClassifier {
-  Ort::Env m_env;
-  Ort::SessionOptions m_session_options;
-  Ort::Session m_session;
+  std::shared_ptr<Ort::Session> m_session; // Run() is thread safe, replicas share it
 
   Ort::AllocatorWithDefaultOptions m_allocator;
   std::array<Ort::Value, 1> m_input_tensor;
   std::optional<cv::Rect> m_output_bounding_box;
+  float m_confidence = 0.0f;
+  StageTimings m_timings;
   const Yolov8Params& m_params;
 
   void scaleCoords(const cv::Size& imageShape,
@@ -147,38 +149,49 @@ void preprocessing(cv::Mat &image, float*& blob, std::vector<int64_t>& inputTens
 
   public:
     Yolov8ArrowClassifier(const std::string& model_path,
+                          const Yolov8Params& params,
+                          const SessionConfig& config = {})
+      : Yolov8ArrowClassifier(
+          std::make_shared<Ort::Session>(OrtRuntime::instance(config).make_session(model_path, config)),
+          params)
+    {
+      spdlog::info("Initialized and loaded YOLOv8Arrow ONNX session");
+    }
+    Yolov8ArrowClassifier(std::shared_ptr<Ort::Session> session,
                           const Yolov8Params& params)
-      : m_env(ORT_LOGGING_LEVEL_WARNING, "Yolov8ArrowClassifier")
-      , m_session(m_env, model_path.c_str(), m_session_options)
+      : m_session(std::move(session))
       , m_input_tensor{ Ort::Value::CreateTensor<float>(
           m_allocator,
           params.input_shape.data(),
           params.input_shape.size()) }
       , m_params(params)
     {
-      spdlog::info("Initialized and loaded YOLOv8Arrow ONNX session");
     }
     static Yolov8ArrowClassifier make_mohnish7_model(
-      const std::string& model_path)
+      const std::string& model_path,
+      const SessionConfig& config = {})
     {
-      return Yolov8ArrowClassifier(model_path, MOHNISH7);
+      return Yolov8ArrowClassifier(model_path, MOHNISH7, config);
     }
     friend ClassificationModel::Detection model_classify(
       Yolov8ArrowClassifier & yac, cv::Mat & image, float threshold = 0.8f)
     {
       yac.m_output_bounding_box.reset();
+      StageClock clock(yac.m_timings);
       cv::Size original_img_shape = image.size();
       float* blob_ptr = yac.m_input_tensor[0].GetTensorMutableData<float>();
       std::vector<int64_t> preprocessed_input_shape{1,3,-1,-1};
       yac.preprocessing(image, blob_ptr, preprocessed_input_shape);
+      clock.lap();
 
       assert(yac.m_input_tensor[0].IsTensor() && yac.m_input_tensor[0].GetTensorTypeAndShapeInfo().GetShape() == preprocessed_input_shape);
-      auto output_tensors = yac.m_session.Run(Ort::RunOptions{ nullptr },
+      auto output_tensors = yac.m_session->Run(Ort::RunOptions{ nullptr },
                                         yac.m_params.input_names.data(),
                                         yac.m_input_tensor.data(),
                                         yac.m_params.input_names.size(),
                                         yac.m_params.output_names.data(),
                                         yac.m_params.output_names.size());
+      clock.lap();
 
     const std::vector<int64_t> output_shape = output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
 
@@ -227,6 +240,7 @@ void preprocessing(cv::Mat &image, float*& blob, std::vector<int64_t>& inputTens
         boxes[nms_indices.front()],
         original_img_shape);
       yac.m_output_bounding_box.emplace(boxes[nms_indices.front()]);
+      yac.m_confidence = confs[nms_indices.front()];
       return yac.m_params.class_to_detection_map[class_ids[nms_indices.front()]];
     }
 
@@ -239,4 +253,16 @@ void preprocessing(cv::Mat &image, float*& blob, std::vector<int64_t>& inputTens
       // std::array<float, 4> bb{bb_mat.tl().x, bb_mat.tl().y, bb_mat.br().x, bb_mat.br().y};
       // return yac.m_output_bounding_box->tl()
     }
+    friend float model_get_confidence(const Yolov8ArrowClassifier& yac)
+    {
+      return yac.m_confidence;
+    }
+    friend StageTimings model_get_timings(const Yolov8ArrowClassifier& yac)
+    {
+      return yac.m_timings;
+    }
+    friend Yolov8ArrowClassifier model_replicate(const Yolov8ArrowClassifier& yac)
+    {
+      return Yolov8ArrowClassifier(yac.m_session, yac.m_params);
+    }
   };
@@ -1,13 +1,45 @@
 using GLMakie
+using Mmap
 
-range_image_file = "range_image.dat"
-f = open(range_image_file, "r")
-values = strip(read(f, String))
-close(f)
+# Layout written by RangeImageDump in lib/range_image_dump.hpp
+struct FrameHeader
+    record_size::UInt32
+    width::UInt32
+    height::UInt32
+    bin_count::UInt32
+    timestamp_ms::Float64
+    angular_resolution::Float32
+    fov::NTuple{2,Float32}
+    ground_plane::NTuple{4,Float32}
+    reserved::UInt32
+end
 
-parsed_values = reshape(collect(Iterators.map(s -> parse(Float64, s), split(values, " "))), 88, 58)
-println(size(parsed_values))
+function read_frames(path)
+    data = Mmap.mmap(path)
+    reinterpret(UInt32, data[1:8]) == [0x44494d52, 1] || error("$path is not a version 1 range image dump")
+    frames = []
+    offset = 8
+    while offset + sizeof(FrameHeader) <= length(data)
+        h = GC.@preserve data unsafe_load(Ptr{FrameHeader}(pointer(data, offset + 1)))
+        offset + h.record_size <= length(data) || break # cut short by a crash
+        n = Int(h.width) * Int(h.height)
+        range_start = offset + sizeof(FrameHeader)
+        range = reshape(reinterpret(Float32, view(data, range_start+1:range_start+4n)), Int(h.width), Int(h.height))
+        bins_start = range_start + 4n
+        bins = reinterpret(UInt16, view(data, bins_start+1:bins_start+2*Int(h.bin_count)))
+        push!(frames, (header=h, range=range, bins=bins))
+        offset += h.record_size
+    end
+    frames
+end
 
-fig, ax, hm = heatmap(parsed_values)
-Colorbar(fig[:, end+1], hm)
+frames = read_frames(get(ARGS, 1, "range_image.rimg"))
+println("$(length(frames)) frames")
+
+fig = Figure()
+sl = Slider(fig[3, 1], range=1:length(frames), startvalue=1)
+ax = Axis(fig[1, 1], title=lift(i -> "t = $(frames[i].header.timestamp_ms) ms", sl.value))
+hm = heatmap!(ax, lift(i -> replace(x -> isinf(x) ? NaN32 : x, frames[i].range), sl.value))
+Colorbar(fig[1, 2], hm)
+barplot(fig[2, 1], lift(i -> Float32.(frames[i].bins), sl.value), axis=(ylabel="obstacle distance (cm)",))
 fig
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cstring>
+#include <memory>
+#include "arrow_state_machine.hpp"
+#include "frame_view.hpp"
+#include "geodetic.hpp"
+
+const DepthIntrinsics K = DepthIntrinsics::from_fov(640, 480, 1.5f, 1.0f);
+const tLatLonAlt HOME{ -353632610, 1491652300, 584000 };
+
+// Sees a left arrow wherever the test puts it, nothing for an empty box
+struct FixedDetector {
+  std::shared_ptr<cv::Rect> box;
+
+  friend ClassificationModel::Detection model_classify(FixedDetector& d, cv::Mat&, float) {
+    return d.box->empty() ? ClassificationModel::Detection::NONE : ClassificationModel::Detection::ARROW_LEFT;
+  }
+  friend cv::Rect model_get_bounding_box(const FixedDetector& d) { return *d.box; }
+  friend float model_get_confidence(const FixedDetector&) { return 1.0f; }
+};
+
+// The rover standing still while the autopilot reports it against origin
+struct Rover {
+  std::array<float, 3> xyz{ 0.0f, 0.0f, 0.0f };
+  tLatLonAlt lla = HOME;
+  tLatLonAlt origin = HOME;
+
+  ImpureInterface io() { return ImpureInterface(std::span(xyz), 0.0f, std::span(lla), std::span(origin)); }
+};
+
+// Sights an arrow 3 m north of the rover
+void sight_arrow(ArrowStateMachine& sm, Rover& rover, std::shared_ptr<cv::Rect> box) {
+  *box = cv::Rect(300, 200, 40, 40);
+  SyntheticDepth depth(640, 480, K);
+  depth.fill(*box, 3.0f);
+  cv::Mat image;
+  for (int i = 0; i < 4; i++) {
+    auto io = rover.io();
+    sm.next(io, image, depth.view());
+  }
+  *box = cv::Rect();
+}
+
+TEST(ArrowStateMachineTest, ObjectivesKeepTheirPlaceAcrossAnOriginReset) {
+  auto box = std::make_shared<cv::Rect>();
+  ClassificationModel detector(FixedDetector{ box });
+  ArrowStateMachine sm(detector);
+  Rover rover;
+  sight_arrow(sm, rover, box);
+  auto before = sm.snapshot();
+  ASSERT_EQ(before.objective_count, 1u);
+  ASSERT_TRUE(before.objectives[0].has_global);
+  EXPECT_NEAR(before.objectives[0].location[0], 3.0f, 0.1f);
+
+  // The EKF moves its origin 10 m north; the rover hasn't moved, so its
+  // local position is now 10 m south of the origin
+  const LocalTangentPlane plane(HOME);
+  rover.origin = plane.to_global(Eigen::Vector3f(10.0f, 0.0f, 0.0f));
+  rover.xyz = { -10.0f, 0.0f, 0.0f };
+  SyntheticDepth empty(640, 480, K);
+  cv::Mat image;
+  auto io = rover.io();
+  sm.next(io, image, empty.view());
+  auto after = sm.snapshot();
+  ASSERT_EQ(after.objective_count, 1u);
+  EXPECT_EQ(after.objectives[0].global, before.objectives[0].global);
+  EXPECT_NEAR(after.objectives[0].location[0], before.objectives[0].location[0] - 10.0f, 0.05f);
+  EXPECT_NEAR(after.objectives[0].location[1], before.objectives[0].location[1], 0.05f);
+  // The autopilot is sent where the objective now is in its frame
+  EXPECT_NEAR(io.output.target_xyz_pos_local.x(), after.objectives[0].location[0], 1e-4f);
+}
+
+TEST(ArrowStateMachineTest, GpsAltitudeAloneIsNotAnOriginReset) {
+  auto box = std::make_shared<cv::Rect>();
+  ClassificationModel detector(FixedDetector{ box });
+  ArrowStateMachine sm(detector);
+  Rover rover;
+  rover.origin = {}; // Not reported yet
+  sight_arrow(sm, rover, box);
+  auto before = sm.snapshot();
+  ASSERT_EQ(before.objective_count, 1u);
+
+  // GPS altitude wanders by metres while the rover stands still
+  rover.lla[2] += 5000;
+  SyntheticDepth empty(640, 480, K);
+  cv::Mat image;
+  auto io = rover.io();
+  sm.next(io, image, empty.view());
+  auto after = sm.snapshot();
+  EXPECT_EQ(after.objectives[0].location, before.objectives[0].location);
+}
+
+TEST(ArrowStateMachineTest, RestoredMachineResumesWhereTheSnapshotLeftOff) {
+  auto box = std::make_shared<cv::Rect>();
+  ClassificationModel detector(FixedDetector{ box });
+  ArrowStateMachine sm(detector);
+  Rover rover;
+  sight_arrow(sm, rover, box);
+  const auto saved = sm.snapshot();
+  ASSERT_EQ(saved.objective_count, 1u);
+  ASSERT_EQ(saved.current_objective, 0);
+
+  auto resumed_box = std::make_shared<cv::Rect>();
+  ClassificationModel resumed_detector(FixedDetector{ resumed_box });
+  ArrowStateMachine resumed(resumed_detector);
+  resumed.restore(saved);
+  const auto restored = resumed.snapshot();
+  EXPECT_EQ(std::memcmp(&restored, &saved, sizeof(saved)), 0);
+
+  // The target is sent again, the autopilot may have lost it in the crash
+  SyntheticDepth empty(640, 480, K);
+  cv::Mat image;
+  auto resumed_io = rover.io();
+  resumed.next(resumed_io, image, empty.view());
+  // and it is placed again from its stored global position
+  EXPECT_NEAR(resumed_io.output.target_xyz_pos_local.x(), saved.objectives[0].location[0], 0.05f);
+  EXPECT_NEAR(resumed_io.output.target_xyz_pos_local.y(), saved.objectives[0].location[1], 0.05f);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <opencv4/opencv2/opencv.hpp>
+#include "cone_detector.hpp"
+
+const cv::Scalar CONE_ORANGE(0, 100, 255); // BGR
+const cv::Scalar BACKGROUND(90, 100, 110);
+
+// Upright triangle with a white reflective band across it
+cv::Mat frame_with_cone(cv::Point apex, int height) {
+  cv::Mat frame(480, 640, CV_8UC3, BACKGROUND);
+  std::vector<cv::Point> cone{ apex, { apex.x - height * 3 / 10, apex.y + height }, { apex.x + height * 3 / 10, apex.y + height } };
+  cv::fillConvexPoly(frame, cone, CONE_ORANGE);
+  cv::rectangle(frame, { apex.x - height / 4, apex.y + height / 2 }, { apex.x + height / 4, apex.y + height / 2 + height / 10 },
+                cv::Scalar(255, 255, 255), cv::FILLED);
+  return frame;
+}
+
+TEST(ConeColorDetectorTest, FindsConeAcrossItsBand) {
+  ConeColorDetector detector;
+  auto candidates = detector.propose(frame_with_cone({ 320, 200 }, 130));
+  ASSERT_EQ(candidates.size(), 1);
+  const cv::Rect& box = candidates.front().box;
+  EXPECT_NEAR(box.x, 320 - 39, 8);
+  EXPECT_NEAR(box.y, 200, 8);
+  EXPECT_NEAR(box.height, 130, 8);
+  EXPECT_GE(candidates.front().score, detector.params().direct_score);
+}
+
+TEST(ConeColorDetectorTest, DistantConeIsNotObvious) {
+  ConeColorDetector detector;
+  auto candidates = detector.propose(frame_with_cone({ 500, 240 }, 24));
+  ASSERT_EQ(candidates.size(), 1);
+  EXPECT_LT(candidates.front().score, detector.params().direct_score);
+}
+
+TEST(ConeColorDetectorTest, IgnoresOtherShapesAndColours) {
+  ConeColorDetector detector;
+  cv::Mat frame(480, 640, CV_8UC3, BACKGROUND);
+  cv::rectangle(frame, { 20, 20 }, { 300, 50 }, CONE_ORANGE, cv::FILLED); // Lying flat
+  cv::rectangle(frame, { 400, 100 }, { 402, 102 }, CONE_ORANGE, cv::FILLED); // Speck
+  std::vector<cv::Point> blue{ { 200, 200 }, { 160, 330 }, { 240, 330 } };
+  cv::fillConvexPoly(frame, blue, cv::Scalar(255, 80, 0));
+  EXPECT_TRUE(detector.propose(frame).empty());
+}
+
+TEST(ConeColorDetectorTest, BestCandidateFirst) {
+  ConeColorDetector detector;
+  cv::Mat frame = frame_with_cone({ 450, 150 }, 150);
+  std::vector<cv::Point> small{ { 100, 300 }, { 91, 330 }, { 109, 330 } };
+  cv::fillConvexPoly(frame, small, CONE_ORANGE);
+  auto candidates = detector.propose(frame);
+  ASSERT_EQ(candidates.size(), 2);
+  EXPECT_GT(candidates[0].box.x, 300);
+  EXPECT_GT(candidates[0].score, candidates[1].score);
+}
+
+TEST(ConeColorDetectorTest, FollowsOnlyTheConeBeingApproached) {
+  ConeColorParams params;
+  const cv::Rect last(300, 200, 40, 60);
+  std::vector<ConeCandidate> candidates{ { cv::Rect(40, 200, 40, 60), 0.95f }, // Other side of the frame
+                                         { cv::Rect(310, 205, 42, 62), 0.3f }, // Too faint
+                                         { cv::Rect(315, 210, 44, 64), 0.6f } };
+  auto cone = follow_cone(candidates, last, 640, params);
+  ASSERT_TRUE(cone.has_value());
+  EXPECT_EQ(cone->box, candidates[2].box);
+
+  candidates.pop_back();
+  EXPECT_FALSE(follow_cone(candidates, last, 640, params).has_value());
+  // Nothing to follow yet: only an obvious cone, wherever it is
+  cone = follow_cone(candidates, std::nullopt, 640, params);
+  ASSERT_TRUE(cone.has_value());
+  EXPECT_EQ(cone->box, candidates[0].box);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "detection_metrics.hpp"
+
+TEST(DetectionMetricsTest, IntersectionOverUnion) {
+  EXPECT_FLOAT_EQ(iou({ 0, 0, 10, 10 }, { 0, 0, 10, 10 }), 1.0f);
+  EXPECT_FLOAT_EQ(iou({ 0, 0, 10, 10 }, { 5, 0, 10, 10 }), 50.0f / 150.0f);
+  EXPECT_FLOAT_EQ(iou({ 0, 0, 10, 10 }, { 20, 20, 5, 5 }), 0.0f);
+  EXPECT_FLOAT_EQ(iou({ 0, 0, 0, 0 }, { 0, 0, 0, 0 }), 0.0f);
+}
+
+TEST(DetectionMetricsTest, ParsesYoloLabels) {
+  std::istringstream in("1 0.5 0.5 0.25 0.5\n\n2 0.1 0.2 0.2 0.2\n");
+  auto labels = parse_yolo_labels(in, 640, 480);
+  ASSERT_EQ(labels.size(), 2);
+  EXPECT_EQ(labels[0].cls, 1);
+  EXPECT_FLOAT_EQ(labels[0].box.x, 240.0f);
+  EXPECT_FLOAT_EQ(labels[0].box.y, 120.0f);
+  EXPECT_FLOAT_EQ(labels[0].box.width, 160.0f);
+  EXPECT_FLOAT_EQ(labels[0].box.height, 240.0f);
+  EXPECT_EQ(labels[1].cls, 2);
+}
+
+TEST(DetectionMetricsTest, PerfectDetectorHasUnitAP) {
+  DetectionEvaluator eval(2);
+  for (size_t i = 0; i < 10; i++) {
+    LabeledBox truth{ int(i % 2), { 10.0f * i, 0, 50, 50 } };
+    ScoredBox pred{ truth.cls, 0.9f, truth.box };
+    eval.add_image(i, std::span(&truth, 1), std::span(&pred, 1));
+  }
+  auto m = eval.evaluate();
+  for (const auto& c : m) {
+    EXPECT_EQ(c.ground_truths, 5);
+    EXPECT_EQ(c.true_positives, 5);
+    EXPECT_FLOAT_EQ(c.precision, 1.0f);
+    EXPECT_FLOAT_EQ(c.recall, 1.0f);
+    EXPECT_FLOAT_EQ(c.average_precision, 1.0f);
+    EXPECT_FLOAT_EQ(c.mean_iou, 1.0f);
+  }
+  EXPECT_FLOAT_EQ(DetectionEvaluator::mean_average_precision(m), 1.0f);
+}
+
+TEST(DetectionMetricsTest, RanksByScoreAndPenalizesMisses) {
+  DetectionEvaluator eval(1);
+  LabeledBox a{ 0, { 0, 0, 10, 10 } }, b{ 0, { 100, 100, 10, 10 } };
+  // Confident false positive, then a hit; second object missed entirely
+  ScoredBox fp{ 0, 0.9f, { 50, 50, 10, 10 } }, tp{ 0, 0.8f, { 1, 0, 10, 10 } };
+  std::vector<LabeledBox> truths{ a };
+  std::vector<ScoredBox> preds{ fp, tp };
+  eval.add_image(0, truths, preds);
+  eval.add_image(1, std::span(&b, 1), {});
+  // Wrong class never matches
+  ScoredBox other{ 1, 0.99f, b.box };
+  DetectionEvaluator two_classes(2);
+  two_classes.add_image(0, std::span(&b, 1), std::span(&other, 1));
+
+  auto m = eval.evaluate()[0];
+  EXPECT_EQ(m.ground_truths, 2);
+  EXPECT_EQ(m.true_positives, 1);
+  EXPECT_EQ(m.false_positives, 1);
+  EXPECT_FLOAT_EQ(m.precision, 0.5f);
+  EXPECT_FLOAT_EQ(m.recall, 0.5f);
+  // PR points (0, 0) then (0.5, 0.5): envelope gives 0.5 over recall 0.5
+  EXPECT_FLOAT_EQ(m.average_precision, 0.25f);
+  EXPECT_NEAR(m.mean_iou, 90.0f / 110.0f, 1e-6);
+
+  auto m2 = two_classes.evaluate();
+  EXPECT_EQ(m2[0].true_positives, 0);
+  EXPECT_EQ(m2[1].false_positives, 1);
+  EXPECT_FLOAT_EQ(DetectionEvaluator::mean_average_precision(m2), 0.0f);
+}
+
+TEST(DetectionMetricsTest, EachTruthMatchesOnce) {
+  DetectionEvaluator eval(1);
+  LabeledBox truth{ 0, { 0, 0, 10, 10 } };
+  std::vector<ScoredBox> preds{ { 0, 0.9f, truth.box }, { 0, 0.8f, truth.box } };
+  eval.add_image(0, std::span(&truth, 1), preds);
+  auto m = eval.evaluate()[0];
+  EXPECT_EQ(m.true_positives, 1);
+  EXPECT_EQ(m.false_positives, 1);
+  EXPECT_FLOAT_EQ(m.average_precision, 1.0f);
+}
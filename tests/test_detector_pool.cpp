@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include "detector_pool.hpp"
+
+// Detects a cone in frames with an even row count; sleeps to stand in for
+// inference, and counts replicas and how many of them ran at once
+struct FakeDetector {
+  struct Shared {
+    std::atomic<int> running = 0;
+    std::atomic<int> max_running = 0;
+    std::atomic<int> replicas = 1;
+  };
+  std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+  int last_rows = 0;
+
+  friend ClassificationModel::Detection model_classify(FakeDetector& fd, cv::Mat& image, float threshold) {
+    if (image.rows < 0) throw std::runtime_error("bad frame");
+    int now = ++fd.shared->running;
+    for (int seen = fd.shared->max_running; now > seen and not fd.shared->max_running.compare_exchange_weak(seen, now);) {}
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    fd.shared->running--;
+    fd.last_rows = image.rows;
+    return image.rows % 2 == 0 ? ClassificationModel::Detection::CONE : ClassificationModel::Detection::NONE;
+  }
+  friend cv::Rect model_get_bounding_box(const FakeDetector& fd) {
+    return { 0, 0, fd.last_rows, 1 };
+  }
+  friend float model_get_confidence(const FakeDetector& fd) {
+    return 0.9f;
+  }
+  friend FakeDetector model_replicate(const FakeDetector& fd) {
+    fd.shared->replicas++;
+    return FakeDetector{ fd.shared };
+  }
+};
+
+cv::Mat frame_with_rows(int rows) {
+  cv::Mat m;
+  m.rows = rows;
+  return m;
+}
+
+TEST(DetectorPoolTest, ResultsMatchTheirFrames) {
+  DetectorPool pool(ClassificationModel(FakeDetector{}), 4);
+  EXPECT_EQ(pool.size(), 4);
+  std::vector<std::future<DetectionResult>> results;
+  for (int i = 1; i <= 40; i++) results.push_back(pool.submit(frame_with_rows(i), 0.5f));
+  for (int i = 1; i <= 40; i++) {
+    auto r = results[i - 1].get();
+    if (i % 2 == 0) {
+      EXPECT_EQ(r.detection, ClassificationModel::Detection::CONE);
+      EXPECT_EQ(r.box.width, i);
+      EXPECT_FLOAT_EQ(r.confidence, 0.9f);
+    } else {
+      EXPECT_EQ(r.detection, ClassificationModel::Detection::NONE);
+    }
+  }
+}
+
+TEST(DetectorPoolTest, ReplicasRunConcurrently) {
+  FakeDetector model;
+  auto shared = model.shared;
+  {
+    DetectorPool pool(ClassificationModel(std::move(model)), 4);
+    std::vector<std::future<DetectionResult>> results;
+    for (int i = 0; i < 32; i++) results.push_back(pool.submit(frame_with_rows(i), 0.5f));
+    for (auto& r : results) r.get();
+  }
+  EXPECT_EQ(shared->replicas, 4);
+  EXPECT_GT(shared->max_running, 1);
+  EXPECT_LE(shared->max_running, 4);
+}
+
+TEST(DetectorPoolTest, ExceptionsReachTheCaller) {
+  DetectorPool pool(ClassificationModel(FakeDetector{}), 2);
+  auto bad = pool.submit(frame_with_rows(-1), 0.5f);
+  auto good = pool.submit(frame_with_rows(2), 0.5f);
+  EXPECT_THROW(bad.get(), std::runtime_error);
+  EXPECT_EQ(good.get().detection, ClassificationModel::Detection::CONE);
+}
+
+TEST(DetectorPoolTest, DestructorFinishesQueuedFrames) {
+  std::vector<std::future<DetectionResult>> results;
+  {
+    DetectorPool pool(ClassificationModel(FakeDetector{}), 2, 16);
+    for (int i = 0; i < 16; i++) results.push_back(pool.submit(frame_with_rows(2), 0.5f));
+  }
+  for (auto& r : results) EXPECT_EQ(r.get().detection, ClassificationModel::Detection::CONE);
+}
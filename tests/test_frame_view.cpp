@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cmath>
+#include <random>
+#include "arrow_state_machine.hpp"
+#include "frame_view.hpp"
+
+const DepthIntrinsics K = DepthIntrinsics::from_fov(640, 480, 1.5f, 1.0f);
+
+TEST(FrameViewTest, SyntheticDepthIsZ16) {
+  SyntheticDepth depth(640, 480, K);
+  depth.fill(cv::Rect(-10, -10, 20, 20), 2.5f).nearest(cv::Rect(5, 5, 10, 10), 1.0f).nearest(cv::Rect(0, 0, 8, 8), 4.0f);
+  auto view = depth.view(12.5);
+  EXPECT_EQ(view.width, 640);
+  EXPECT_EQ(view.stride, 640);
+  EXPECT_EQ(view.timestamp_ms, 12.5);
+  EXPECT_EQ(view.raw(0, 0), 2500); // Clipped to the frame, nearer than 4 m
+  EXPECT_EQ(view.raw(7, 7), 1000);
+  EXPECT_EQ(view.raw(12, 12), 1000);
+  EXPECT_EQ(view.raw(10, 0), 0); // No data
+  EXPECT_FLOAT_EQ(view.get_distance(0, 0), 2.5f);
+}
+
+TEST(FrameViewTest, GroundIsLevel) {
+  SyntheticDepth depth(640, 480, K);
+  depth.ground(0.5f);
+  auto view = depth.view();
+  EXPECT_EQ(view.raw(320, 100), 0); // Above the horizon
+  for (int y : { 250, 300, 479 }) {
+    const float z = view.get_distance(320, y);
+    EXPECT_NEAR((y - K.ppy) / K.fy * z, 0.5f, 0.005f);
+  }
+}
+
+TEST(FrameViewTest, DropoutIsSeeded) {
+  SyntheticDepth a(640, 480, K), b(640, 480, K), c(640, 480, K);
+  a.fill(3.0f).dropout(0.3f, 1);
+  b.fill(3.0f).dropout(0.3f, 1);
+  c.fill(3.0f).dropout(0.3f, 2);
+  auto va = a.view(), vb = b.view(), vc = c.view();
+  int dropped = 0;
+  bool same = true, differ = false;
+  for (int y = 0; y < 480; y++) {
+    for (int x = 0; x < 640; x++) {
+      dropped += va.raw(x, y) == 0;
+      same = same and va.raw(x, y) == vb.raw(x, y);
+      differ = differ or va.raw(x, y) != vc.raw(x, y);
+    }
+  }
+  EXPECT_TRUE(same);
+  EXPECT_TRUE(differ);
+  EXPECT_NEAR(dropped / (640.0 * 480.0), 0.3, 0.01);
+}
+
+// Sees a left arrow wherever the test puts it
+struct FixedDetector {
+  std::shared_ptr<cv::Rect> box;
+
+  friend ClassificationModel::Detection model_classify(FixedDetector& d, cv::Mat&, float) {
+    return d.box->empty() ? ClassificationModel::Detection::NONE : ClassificationModel::Detection::ARROW_LEFT;
+  }
+  friend cv::Rect model_get_bounding_box(const FixedDetector& d) { return *d.box; }
+  friend float model_get_confidence(const FixedDetector&) { return 1.0f; }
+};
+
+TEST(FrameViewTest, StateMachineRangesFromSyntheticDepth) {
+  auto box = std::make_shared<cv::Rect>(300, 200, 40, 40);
+  ClassificationModel detector(FixedDetector{ box });
+  ArrowStateMachine sm(detector);
+  SyntheticDepth depth(640, 480, K);
+  depth.fill(*box, 3.0f).dropout(*box, 0.2f);
+  cv::Mat image;
+  std::array<float, 3> xyz{ 0.0f, 0.0f, 0.0f };
+  ImpureInterface io{ std::span(xyz), 0.0f };
+  for (int i = 0; i < 4; i++) sm.next(io, image, depth.view());
+  ASSERT_EQ(sm.snapshot().objective_count, 1u);
+  // No data is averaged in, as it always has been
+  EXPECT_NEAR(io.output.target_xyz_pos_local.x(), 3.0f * 0.8f, 0.1f);
+  EXPECT_NEAR(io.output.target_xyz_pos_local.y(), 0.0f, 1e-4f);
+
+  // Mostly holes: no lock, so nothing is kept
+  // The machine takes the model over
+  ClassificationModel detector2(FixedDetector{ box });
+  ArrowStateMachine sm2(detector2);
+  SyntheticDepth holes(640, 480, K);
+  holes.fill(*box, 3.0f).dropout(*box, 0.7f);
+  for (int i = 0; i < 4; i++) sm2.next(io, image, holes.view());
+  EXPECT_EQ(sm2.snapshot().objective_count, 0u);
+}
+
+TEST(FrameViewTest, StateMachineSurvivesRandomFrames) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> coord(-100, 700), size(0, 200), pick(0, 3);
+  std::uniform_real_distribution<float> range(0.0f, 70.0f), fraction(0.0f, 1.0f);
+  auto box = std::make_shared<cv::Rect>();
+  ClassificationModel detector(FixedDetector{ box });
+  ArrowStateMachine sm(detector);
+  cv::Mat image;
+  std::array<float, 3> xyz{ 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 200; i++) {
+    *box = pick(rng) == 0 ? cv::Rect() : cv::Rect(coord(rng), coord(rng), size(rng), size(rng));
+    SyntheticDepth depth(640, 480, K);
+    depth.fill(cv::Rect(coord(rng), coord(rng), size(rng), size(rng)), range(rng)).ground(0.5f).dropout(fraction(rng), i);
+    ImpureInterface io{ std::span(xyz), 360.0f * fraction(rng) };
+    sm.next(io, image, depth.view());
+    EXPECT_TRUE(io.output.target_xyz_pos_local.allFinite());
+    xyz = { io.output.target_xyz_pos_local.x(), io.output.target_xyz_pos_local.y(), 0.0f };
+  }
+}
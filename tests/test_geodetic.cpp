@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "geodetic.hpp"
+
+TEST(GeodeticTest, OriginMapsToZero) {
+  LocalTangentPlane ltp({ 129'770'000, 795'130'000, 512'000 });
+  auto ned = ltp.to_ned(ltp.origin());
+  EXPECT_FLOAT_EQ(ned.norm(), 0.0f);
+}
+
+TEST(GeodeticTest, MetresPerDegreeAtEquator) {
+  LocalTangentPlane ltp({ 0, 0, 0 });
+  // 1e-3° of latitude/longitude at the equator
+  auto ned = ltp.to_ned({ 10'000, 10'000, -2'000 });
+  EXPECT_NEAR(ned[0], 110.574, 0.01);
+  EXPECT_NEAR(ned[1], 111.319, 0.01);
+  EXPECT_NEAR(ned[2], 2.0, 1e-6);
+}
+
+TEST(GeodeticTest, RoundTripsWithinCourse) {
+  LocalTangentPlane ltp({ 129'770'000, 795'130'000, 512'000 });
+  Eigen::Vector3f ned(-350.25f, 812.5f, -1.5f);
+  auto lla = ltp.to_global(ned);
+  auto back = ltp.to_ned(lla);
+  // degE7 quantization is ~1cm
+  EXPECT_NEAR((back - ned).norm(), 0.0f, 0.02f);
+}
+
+TEST(GeodeticTest, WrapsAntimeridian) {
+  LocalTangentPlane ltp({ 0, 1'799'999'000, 0 });
+  auto ned = ltp.to_ned({ 0, -1'799'999'000, 0 });
+  EXPECT_NEAR(ned[1], 2 * 11.1319, 0.01);
+  auto lla = ltp.to_global(Eigen::Vector3f(0.0f, 22.26f, 0.0f));
+  EXPECT_LT(lla[1], 0);
+}
+
+TEST(GeodeticTest, GlobalFixRequiresNonZeroPosition) {
+  EXPECT_FALSE(has_global_fix({ 0, 0, 1000 }));
+  EXPECT_TRUE(has_global_fix({ 1, 0, 0 }));
+}
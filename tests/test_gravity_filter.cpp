@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "gravity_filter.hpp"
+
+// Realsense camera axes: x right, y down, z forward. Level and at rest the
+// accelerometer reads 1 g upwards, along -y.
+const Eigen::Vector3f AT_REST(0.0f, -9.81f, 0.0f);
+
+float angle_between(const Eigen::Vector3f& a, const Eigen::Vector3f& b) {
+  return std::acos(std::clamp(a.normalized().dot(b.normalized()), -1.0f, 1.0f));
+}
+
+TEST(GravityFilterTest, EmptyUntilAccelerometer) {
+  GravityFilter filter;
+  filter.gyro(Eigen::Vector3f(0.1f, 0.0f, 0.0f), 0.0);
+  EXPECT_FALSE(filter.up());
+  filter.accel(AT_REST);
+  ASSERT_TRUE(filter.up());
+  EXPECT_NEAR(angle_between(*filter.up(), -Eigen::Vector3f::UnitY()), 0.0f, 1e-5);
+}
+
+TEST(GravityFilterTest, GyroTracksPitch) {
+  GravityFilter filter;
+  filter.accel(AT_REST);
+  // Nose down by 0.3 rad over one second at 200 Hz: pitch is about the x axis
+  const float rate = 0.3f;
+  for (int i = 0; i <= 200; i++) filter.gyro(Eigen::Vector3f(rate, 0.0f, 0.0f), i * 5.0);
+  Eigen::Vector3f expected = Eigen::AngleAxisf(-0.3f, Eigen::Vector3f::UnitX()) * -Eigen::Vector3f::UnitY();
+  EXPECT_NEAR(angle_between(*filter.up(), expected), 0.0f, 1e-3);
+}
+
+TEST(GravityFilterTest, AccelerometerCorrectsDrift) {
+  GravityFilter filter;
+  filter.accel(Eigen::Vector3f(2.0f, -9.6f, 0.0f)); // A bad first sample, 12° off
+  for (int i = 0; i < 300; i++) filter.accel(AT_REST);
+  EXPECT_LT(angle_between(*filter.up(), -Eigen::Vector3f::UnitY()), 0.01f);
+}
+
+TEST(GravityFilterTest, IgnoresManoeuvres) {
+  GravityFilter filter;
+  filter.accel(AT_REST);
+  // Braking hard: 5 m/s² along the camera axis on top of gravity
+  for (int i = 0; i < 100; i++) filter.accel(AT_REST + Eigen::Vector3f(0.0f, 0.0f, -5.0f));
+  EXPECT_NEAR(angle_between(*filter.up(), -Eigen::Vector3f::UnitY()), 0.0f, 1e-5);
+}
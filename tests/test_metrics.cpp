@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+
+TEST(MetricsTest, RendersPrometheusText) {
+  MetricsRegistry registry;
+  registry.counter("michi_frames_total", "Frames processed").inc(3);
+  registry.gauge("michi_queue_depth", "Frames waiting").set(2);
+  auto& latency = registry.histogram("michi_inference_seconds", "Inference latency", { 0.01, 0.1 });
+  latency.observe(0.005);
+  latency.observe(std::chrono::milliseconds(50));
+  latency.observe(2.0);
+  EXPECT_EQ(registry.render(),
+            "# HELP michi_frames_total Frames processed\n"
+            "# TYPE michi_frames_total counter\n"
+            "michi_frames_total 3\n"
+            "# HELP michi_inference_seconds Inference latency\n"
+            "# TYPE michi_inference_seconds histogram\n"
+            "michi_inference_seconds_bucket{le=\"0.01\"} 1\n"
+            "michi_inference_seconds_bucket{le=\"0.1\"} 2\n"
+            "michi_inference_seconds_bucket{le=\"+Inf\"} 3\n"
+            "michi_inference_seconds_sum 2.055\n"
+            "michi_inference_seconds_count 3\n"
+            "# HELP michi_queue_depth Frames waiting\n"
+            "# TYPE michi_queue_depth gauge\n"
+            "michi_queue_depth 2\n");
+}
+
+TEST(MetricsTest, SameNameSameMetric) {
+  MetricsRegistry registry;
+  auto& a = registry.counter("michi_mavlink_rx_messages_total", "Messages received");
+  auto& b = registry.counter("michi_mavlink_rx_messages_total", "Messages received");
+  EXPECT_EQ(&a, &b);
+  a.inc();
+  b.inc();
+  EXPECT_EQ(a.value(), 2u);
+}
+
+TEST(MetricsTest, BoundaryLandsInItsBucket) {
+  Histogram h({ 0.1, 0.2 });
+  h.observe(0.1); // le is inclusive
+  EXPECT_EQ(h.bucket(0), 1u);
+  EXPECT_EQ(h.bucket(1), 0u);
+}
+
+TEST(MetricsTest, ConcurrentUpdatesAreNotLost) {
+  MetricsRegistry registry;
+  auto& counter = registry.counter("c", "c");
+  auto& histogram = registry.histogram("h", "h", { 1.0 });
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10000; i++) {
+        counter.inc();
+        histogram.observe(0.5);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  EXPECT_EQ(counter.value(), 40000u);
+  EXPECT_EQ(histogram.count(), 40000u);
+  EXPECT_DOUBLE_EQ(histogram.sum(), 20000.0);
+}
+
+TEST(MetricsTest, CollectorsRunPerScrape) {
+  MetricsRegistry registry;
+  register_process_metrics(registry);
+  auto rendered = registry.render();
+  EXPECT_NE(rendered.find("michi_resident_memory_bytes "), std::string::npos);
+  EXPECT_GT(registry.gauge("michi_resident_memory_bytes", "").value(), 0.0);
+}
+
+int connect_to(unsigned short port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  return connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 ? fd : -1;
+}
+
+std::string scrape(int fd) {
+  const std::string request = "GET /metrics HTTP/1.1\r\nHost: rover\r\n\r\n";
+  if (write(fd, request.data(), request.size()) != ssize_t(request.size())) return {};
+  std::string response;
+  char buffer[512];
+  for (ssize_t n; (n = read(fd, buffer, sizeof(buffer))) > 0;) response.append(buffer, n);
+  return response;
+}
+
+TEST(MetricsTest, ServesOverHttp) {
+  MetricsRegistry registry;
+  registry.counter("michi_frames_total", "Frames processed").inc(7);
+  EXPECT_FALSE(MetricsServer::start("localhost", registry));
+  EXPECT_FALSE(MetricsServer::start("127.0.0.1:http", registry));
+  auto server = MetricsServer::start("127.0.0.1:0", registry);
+  ASSERT_TRUE(server.has_value());
+
+  int fd = connect_to((*server)->port());
+  ASSERT_GE(fd, 0);
+  const std::string response = scrape(fd);
+  close(fd);
+  EXPECT_TRUE(response.starts_with("HTTP/1.0 200 OK\r\n"));
+  EXPECT_NE(response.find("\r\n\r\n# HELP michi_frames_total"), std::string::npos);
+  EXPECT_NE(response.find("michi_frames_total 7\n"), std::string::npos);
+}
+
+TEST(MetricsTest, SilentClientDoesNotBlockScrapes) {
+  MetricsRegistry registry;
+  registry.counter("michi_frames_total", "Frames processed").inc(7);
+  auto server = MetricsServer::start("127.0.0.1:0", registry);
+  ASSERT_TRUE(server.has_value());
+  int silent = connect_to((*server)->port());
+  ASSERT_GE(silent, 0);
+  int fd = connect_to((*server)->port());
+  ASSERT_GE(fd, 0);
+  const std::string response = scrape(fd);
+  close(fd);
+  close(silent);
+  EXPECT_NE(response.find("michi_frames_total 7\n"), std::string::npos);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "mission_checkpoint.hpp"
+
+class MissionCheckpointTest : public ::testing::Test {
+  protected:
+  std::string m_path = "test_mission_checkpoint.ckpt";
+  void SetUp() override { std::remove(m_path.c_str()); }
+  void TearDown() override { std::remove(m_path.c_str()); }
+
+  static MissionSnapshot make_snapshot(uint32_t objectives, int32_t current) {
+    MissionSnapshot s{};
+    s.objective_count = objectives;
+    s.current_objective = current;
+    for (uint32_t i = 0; i < objectives; i++) {
+      s.objectives[i].type = i % 4;
+      s.objectives[i].location = { float(i), 2.0f * i, 0.0f };
+    }
+    return s;
+  }
+};
+
+TEST_F(MissionCheckpointTest, EmptyFileHasNothingToResume) {
+  auto ckpt = MissionCheckpoint::open(m_path);
+  ASSERT_TRUE(ckpt.has_value());
+  auto snapshot = ckpt->load();
+  ASSERT_FALSE(snapshot.has_value());
+  EXPECT_EQ(snapshot.error(), CheckpointErrc::NoValidSnapshot);
+}
+
+TEST_F(MissionCheckpointTest, ResumesLatestSnapshotAfterReopen) {
+  {
+    auto ckpt = MissionCheckpoint::open(m_path);
+    ASSERT_TRUE(ckpt.has_value());
+    EXPECT_TRUE(ckpt->save(make_snapshot(3, 1)));
+    EXPECT_TRUE(ckpt->save(make_snapshot(5, 4)));
+    EXPECT_FALSE(ckpt->save(make_snapshot(5, 4)));
+  }
+  auto ckpt = MissionCheckpoint::open(m_path);
+  ASSERT_TRUE(ckpt.has_value());
+  auto snapshot = ckpt->load();
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->objective_count, 5);
+  EXPECT_EQ(snapshot->current_objective, 4);
+  EXPECT_FLOAT_EQ(snapshot->objectives[4].location[1], 8.0f);
+}
+
+TEST_F(MissionCheckpointTest, TornWriteFallsBackToPreviousSnapshot) {
+  {
+    auto ckpt = MissionCheckpoint::open(m_path);
+    ASSERT_TRUE(ckpt.has_value());
+    ckpt->save(make_snapshot(3, 1));
+    ckpt->save(make_snapshot(5, 4));
+  }
+  // Corrupt one byte of the newest snapshot's payload (sequence 2 lands in the
+  // first slot), as a crash mid-write would
+  FILE* f = std::fopen(m_path.c_str(), "r+b");
+  ASSERT_NE(f, nullptr);
+  std::fseek(f, 8 + 16 + 4, SEEK_SET);
+  std::fputc(0x7f, f);
+  std::fclose(f);
+
+  auto ckpt = MissionCheckpoint::open(m_path);
+  ASSERT_TRUE(ckpt.has_value());
+  auto snapshot = ckpt->load();
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->objective_count, 3);
+  EXPECT_EQ(snapshot->current_objective, 1);
+}
+
+TEST_F(MissionCheckpointTest, ClearedCheckpointHasNothingToResume) {
+  {
+    auto ckpt = MissionCheckpoint::open(m_path);
+    ASSERT_TRUE(ckpt.has_value());
+    ckpt->save(make_snapshot(3, 1));
+    ckpt->save(make_snapshot(5, 4));
+    ckpt->clear();
+    EXPECT_FALSE(ckpt->load().has_value());
+  }
+  auto ckpt = MissionCheckpoint::open(m_path);
+  ASSERT_TRUE(ckpt.has_value());
+  EXPECT_FALSE(ckpt->load().has_value());
+  // A new mission checkpoints into the cleared file as usual
+  EXPECT_TRUE(ckpt->save(make_snapshot(2, 0)));
+  auto snapshot = ckpt->load();
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->objective_count, 2);
+}
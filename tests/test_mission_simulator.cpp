@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include "arrow_state_machine.hpp"
+#include "frame_view.hpp"
+#include "mission_simulator.hpp"
+
+const DepthIntrinsics K = DepthIntrinsics::from_fov(640, 480, 1.5f, 1.0f);
+const cv::Rect ARROW(300, 200, 40, 40);
+
+// Sees a left arrow wherever the test puts it, nothing for an empty box
+struct FixedDetector {
+  std::shared_ptr<cv::Rect> box;
+
+  friend ClassificationModel::Detection model_classify(FixedDetector& d, cv::Mat&, float) {
+    return d.box->empty() ? ClassificationModel::Detection::NONE : ClassificationModel::Detection::ARROW_LEFT;
+  }
+  friend cv::Rect model_get_bounding_box(const FixedDetector& d) { return *d.box; }
+  friend float model_get_confidence(const FixedDetector&) { return 1.0f; }
+};
+
+class MissionSimulatorTest : public ::testing::Test {
+  protected:
+  std::shared_ptr<cv::Rect> m_box = std::make_shared<cv::Rect>();
+  ClassificationModel m_detector{ FixedDetector{ m_box } };
+  ArrowStateMachine m_sm{ m_detector };
+  SyntheticDepth m_depth{ 640, 480, K };
+  cv::Mat m_image;
+  std::array<float, 3> m_xyz{ 0.0f, 0.0f, 0.0f };
+
+  ImpureInterface step(float heading_deg, bool arrow) {
+    *m_box = arrow ? ARROW : cv::Rect();
+    ImpureInterface io{ std::span(m_xyz), heading_deg };
+    m_sm.next(io, m_image, m_depth.view());
+    return io;
+  }
+  // Votes a left arrow 3 m ahead into an objective
+  void sight_arrow(float heading_deg) {
+    m_depth.fill(ARROW, 3.0f);
+    for (int i = 0; i < 4; i++) step(heading_deg, true);
+    ASSERT_EQ(m_sm.snapshot().objective_count, 1u);
+  }
+  // Drives onto the current objective
+  ImpureInterface reach_objective(float heading_deg) {
+    auto s = m_sm.snapshot();
+    m_xyz = s.objectives[s.current_objective].location;
+    return step(heading_deg, false);
+  }
+};
+
+TEST_F(MissionSimulatorTest, ReachingAnObjectiveTurnsWithoutTouchingIt) {
+  sight_arrow(0.0f);
+  auto io = reach_objective(0.0f);
+  ASSERT_TRUE(io.output.yaw.has_value());
+  EXPECT_FLOAT_EQ(*io.output.yaw, -90.0f);
+  EXPECT_EQ(io.output.delay_sec, 10);
+  EXPECT_EQ(m_sm.snapshot().current_objective, -1);
+}
+
+TEST_F(MissionSimulatorTest, VotesDontCarryOverToTheNextObjective) {
+  sight_arrow(0.0f);
+  EXPECT_EQ(m_sm.snapshot().detection_count, 0u);
+  reach_objective(0.0f);
+  // One sighting of whatever comes next is not enough to place it
+  step(-90.0f, true);
+  EXPECT_EQ(m_sm.snapshot().objective_count, 1u);
+}
+
+TEST_F(MissionSimulatorTest, NorthIsATurn) {
+  // A left arrow seen facing east sends the rover north
+  sight_arrow(90.0f);
+  auto io = reach_objective(90.0f);
+  ASSERT_TRUE(io.output.yaw.has_value());
+  EXPECT_FLOAT_EQ(*io.output.yaw, 0.0f);
+}
+
+TEST(MissionSimulatorRunTest, MostSeededCoursesSucceed) {
+  spdlog::set_level(spdlog::level::off); // Every tick logs
+  SimParams p;
+  p.servo = true; // As mission2 --servo flies the approach
+  auto results = run_missions(p, 10, 1, 4);
+  ASSERT_EQ(results.size(), 10u);
+  const auto successes = std::count_if(results.begin(), results.end(), [](const auto& r) {
+    return r.outcome == SimResult::Outcome::SUCCESS;
+  });
+  EXPECT_GE(successes, 8);
+  // The seed alone decides a course, whichever worker runs it
+  EXPECT_EQ(run_mission(p, 1 + 3).ticks, results[3].ticks);
+}
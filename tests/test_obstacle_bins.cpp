@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "obstacle_bins.hpp"
+
+// A range image like the obstacle pipeline's: 1° per pixel over 87x58°
+constexpr size_t WIDTH = 87, HEIGHT = 58;
+constexpr float VFOV = 58.0f * M_PI / 180.0f;
+
+std::vector<float> empty_image() { return std::vector<float>(WIDTH * HEIGHT, -INFINITY); }
+void fill_columns(std::vector<float>& image, size_t from, size_t to, float range, size_t top = 0, size_t bottom = HEIGHT) {
+  for (size_t row = top; row < bottom; row++) {
+    for (size_t c = from; c < to; c++) image[row * WIDTH + c] = range;
+  }
+}
+
+TEST(ObstacleBinsTest, EveryColumnLandsInABin) {
+  auto image = empty_image();
+  fill_columns(image, 0, WIDTH, 2.0f);
+  ObstacleBinner binner;
+  std::array<uint16_t, 72> distances;
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  for (auto d : distances) EXPECT_EQ(d, 200);
+  // A post one column wide shows up in one bin only
+  image = empty_image();
+  fill_columns(image, 40, 41, 1.5f);
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  EXPECT_EQ(std::count(distances.begin(), distances.end(), 150), 1);
+  EXPECT_EQ(std::count(distances.begin(), distances.end(), UINT16_MAX), 71);
+}
+
+TEST(ObstacleBinsTest, RobustReducersIgnoreFlyingPixels) {
+  auto image = empty_image();
+  fill_columns(image, 0, WIDTH, 3.0f);
+  image[20 * WIDTH + 10] = 0.5f;
+  std::array<uint16_t, 72> distances;
+  const size_t bin = 10 * 72 / WIDTH;
+  for (auto reducer : { BinReducer::MIN, BinReducer::KTH_MIN, BinReducer::PERCENTILE, BinReducer::MIN_OF_CLUSTERS }) {
+    BinParams params;
+    params.reducer = reducer;
+    ObstacleBinner binner(params);
+    binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+    EXPECT_EQ(distances[bin], reducer == BinReducer::MIN ? 50 : 300) << "reducer " << int(reducer);
+  }
+}
+
+TEST(ObstacleBinsTest, ClustersNeedEnoughReturns) {
+  BinParams params;
+  params.reducer = BinReducer::MIN_OF_CLUSTERS;
+  params.bins = 1;
+  ObstacleBinner binner(params);
+  auto image = empty_image();
+  fill_columns(image, 0, WIDTH, 2.0f, 30, 40);
+  fill_columns(image, 0, 3, 1.0f, 5, 6); // Three returns
+  std::array<uint16_t, 72> distances;
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  EXPECT_EQ(distances[0], 200);
+  EXPECT_EQ(distances[1], UINT16_MAX);
+  fill_columns(image, 0, 5, 1.0f, 5, 6); // Five
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  EXPECT_EQ(distances[0], 100);
+}
+
+TEST(ObstacleBinsTest, BandLimitsRows) {
+  BinParams params;
+  params.reducer = BinReducer::MIN;
+  params.band_low_deg = -10.0f;
+  params.band_high_deg = 10.0f;
+  ObstacleBinner binner(params);
+  auto image = empty_image();
+  fill_columns(image, 0, WIDTH, 4.0f, 19, 39); // Elevation -10 to 10°
+  fill_columns(image, 0, WIDTH, 1.0f, 0, 10); // An overhang 19 to 29° up
+  std::array<uint16_t, 72> distances;
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  for (auto d : distances) EXPECT_EQ(d, 400);
+}
+
+TEST(ObstacleBinsTest, FewerBinsThanSlots) {
+  BinParams params;
+  params.bins = 36;
+  ObstacleBinner binner(params);
+  auto image = empty_image();
+  fill_columns(image, 0, WIDTH, 2.5f);
+  std::array<uint16_t, 72> distances;
+  binner.reduce(image, WIDTH, HEIGHT, VFOV, distances);
+  EXPECT_EQ(std::count(distances.begin(), distances.begin() + 36, 250), 36);
+  EXPECT_EQ(std::count(distances.begin() + 36, distances.end(), UINT16_MAX), 36);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "obstacle_clusters.hpp"
+
+// A filled rectangle of points 2 cm apart, like a voxelized obstacle face
+void add_box(std::vector<GroundPoint>& points, float x0, float y0, float x1, float y1) {
+  for (float x = x0; x <= x1 + 1e-4f; x += 0.02f) {
+    for (float y = y0; y <= y1 + 1e-4f; y += 0.02f) points.push_back({ x, y });
+  }
+}
+
+TEST(ObstacleClustersTest, SeparatesPostFromWall) {
+  std::vector<GroundPoint> points;
+  add_box(points, 2.0f, -0.05f, 2.1f, 0.05f); // A post dead ahead
+  add_box(points, 4.0f, -2.0f, 4.04f, 2.0f); // A wall behind it
+  GridClusterer clusterer;
+  auto clusters = clusterer.cluster(points);
+  ASSERT_EQ(clusters.size(), 2u);
+  std::vector<ObstacleCluster> sorted(clusters.begin(), clusters.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.centroid_x < b.centroid_x; });
+  EXPECT_NEAR(sorted[0].width(), 0.1f, 1e-3);
+  EXPECT_NEAR(sorted[0].centroid_y, 0.0f, 1e-3);
+  EXPECT_NEAR(sorted[1].width(), 4.0f, 1e-3);
+  EXPECT_NEAR(sorted[1].min_x, 4.0f, 1e-3);
+  EXPECT_EQ(sorted[0].points + sorted[1].points, points.size());
+}
+
+TEST(ObstacleClustersTest, DiagonalCellsJoinAndStrayPointsDrop) {
+  std::vector<GroundPoint> points;
+  // A diagonal line of points one cell apart along each axis
+  for (int i = 0; i < 10; i++) points.push_back({ 1.0f + i * 0.1f + 0.05f, i * 0.1f + 0.05f });
+  points.push_back({ 3.0f, -1.0f }); // A flying pixel on its own
+  points.push_back({ NAN, 0.0f });
+  points.push_back({ 10.0f, 0.0f }); // Beyond max_range
+  GridClusterer clusterer;
+  auto clusters = clusterer.cluster(points);
+  ASSERT_EQ(clusters.size(), 1u);
+  EXPECT_EQ(clusters[0].points, 10u);
+  EXPECT_NEAR(clusters[0].length(), 0.9f, 1e-4);
+}
+
+TEST(ObstacleClustersTest, MountMovesPointsToBody) {
+  // Straight out of a camera facing right, 0.5 m aft of the body origin
+  auto p = to_body({ 1.0f, 0.0f }, { 90.0f, -0.5f, 0.0f });
+  EXPECT_NEAR(p.x, -0.5f, 1e-5);
+  EXPECT_NEAR(p.y, 1.0f, 1e-5);
+}
+
+TEST(ObstacleClustersTest, TrackerKeepsIdsAndEstimatesVelocity) {
+  ObstacleTracker tracker;
+  GridClusterer clusterer;
+  for (int frame = 0; frame < 10; frame++) {
+    std::vector<GroundPoint> points;
+    // A person crossing left to right at 1 m/s, and a fixed post
+    const float y = -1.0f + frame * 0.1f;
+    add_box(points, 3.0f, y - 0.1f, 3.1f, y + 0.1f);
+    add_box(points, 2.0f, 1.5f, 2.06f, 1.56f);
+    tracker.update(clusterer.cluster(points), frame * 0.1);
+  }
+  auto tracks = tracker.tracks();
+  ASSERT_EQ(tracks.size(), 2u);
+  for (const auto& track : tracks) {
+    EXPECT_EQ(track.age, 10u);
+    EXPECT_LT(track.id, 2u);
+    const bool moving = track.cluster.centroid_x > 2.5f;
+    EXPECT_NEAR(track.velocity_x, 0.0f, 1e-3);
+    EXPECT_NEAR(track.velocity_y, moving ? 1.0f : 0.0f, 1e-3);
+  }
+}
+
+TEST(ObstacleClustersTest, TrackerDropsLostObstacles) {
+  ObstacleTracker tracker;
+  ObstacleCluster post{ 1.0f, 0.0f, 1.1f, 0.1f, 1.05f, 0.05f, 20 };
+  tracker.update(std::span(&post, 1), 0.0);
+  for (int frame = 1; frame <= 3; frame++) {
+    tracker.update({}, frame * 0.1);
+    ASSERT_EQ(tracker.tracks().size(), 1u);
+    EXPECT_EQ(tracker.tracks()[0].missed, uint32_t(frame));
+  }
+  tracker.update({}, 0.4);
+  EXPECT_TRUE(tracker.tracks().empty());
+  // Coming back, it is a new obstacle
+  tracker.update(std::span(&post, 1), 0.5);
+  ASSERT_EQ(tracker.tracks().size(), 1u);
+  EXPECT_EQ(tracker.tracks()[0].id, 1u);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "obstacle_merge.hpp"
+
+// 72 bins of 1.2° across an 86.4° wide camera, as locate_obstacles sends them
+std::vector<uint16_t> empty_camera() { return std::vector<uint16_t>(72, UINT16_MAX); }
+constexpr float INCREMENT = 1.2f;
+constexpr float OFFSET = -43.2f;
+
+TEST(ObstacleMergeTest, ParsesCameraSpecs) {
+  auto front = parse_camera_spec("123622270348");
+  ASSERT_TRUE(front);
+  EXPECT_EQ(front->serial, "123622270348");
+  EXPECT_FLOAT_EQ(front->extrinsics.yaw_deg, 0.0f);
+  auto rear = parse_camera_spec("944122071212:180:-0.3:0.05");
+  ASSERT_TRUE(rear);
+  EXPECT_FLOAT_EQ(rear->extrinsics.yaw_deg, 180.0f);
+  EXPECT_FLOAT_EQ(rear->extrinsics.x, -0.3f);
+  EXPECT_FLOAT_EQ(rear->extrinsics.y, 0.05f);
+  EXPECT_FALSE(parse_camera_spec(""));
+  EXPECT_FALSE(parse_camera_spec(":90"));
+  EXPECT_FALSE(parse_camera_spec("1234:left"));
+  EXPECT_FALSE(parse_camera_spec("1234:0:0:0:0"));
+}
+
+TEST(ObstacleMergeTest, UnseenBinsStayUnknown) {
+  auto front = empty_camera();
+  ObstacleSector sectors[] = { { front, INCREMENT, OFFSET, {} } };
+  auto merged = merge_obstacle_sectors(sectors);
+  for (auto d : merged) EXPECT_EQ(d, UINT16_MAX);
+}
+
+TEST(ObstacleMergeTest, FrontAndRearCoverOppositeBins) {
+  auto front = empty_camera(), rear = empty_camera();
+  front[36] = 200; // Dead ahead of each camera
+  rear[36] = 150;
+  ObstacleSector sectors[] = { { front, INCREMENT, OFFSET, { 0.0f, 0.0f, 0.0f } },
+                               { rear, INCREMENT, OFFSET, { 180.0f, 0.0f, 0.0f } } };
+  auto merged = merge_obstacle_sectors(sectors);
+  EXPECT_EQ(merged[0], 200);
+  EXPECT_EQ(merged[36], 150);
+  EXPECT_EQ(std::count(merged.begin(), merged.end(), UINT16_MAX), 70);
+}
+
+TEST(ObstacleMergeTest, MountOffsetMovesReadingsToBodyOrigin) {
+  auto side = empty_camera();
+  side[36] = 100; // 1 m straight out of a camera on the right, 0.5 m aft
+  ObstacleSector sectors[] = { { side, INCREMENT, OFFSET, { 90.0f, -0.5f, 0.2f } } };
+  auto merged = merge_obstacle_sectors(sectors);
+  // The point is at (-0.5, 1.2) in the body frame
+  const float bearing = std::atan2(1.2f, -0.5f) * 180.0f / M_PI;
+  const size_t bin = std::lround(bearing / MERGED_OBSTACLE_INCREMENT_DEG);
+  EXPECT_EQ(merged[bin], 130);
+}
+
+TEST(ObstacleMergeTest, OverlapKeepsClosest) {
+  auto front = empty_camera(), left = empty_camera();
+  ObstacleSector sectors[] = { { front, INCREMENT, OFFSET, {} }, { left, INCREMENT, OFFSET, { -45.0f, 0.0f, 0.0f } } };
+  // Both cameras see around 40° left of the nose
+  front[3] = 400; // -43.2 + 3 * 1.2 = -39.6°
+  left[40] = 250; // -45 - 43.2 + 40 * 1.2 = -40.2°
+  auto merged = merge_obstacle_sectors(sectors);
+  EXPECT_EQ(merged[72 - 8], 250);
+  left[40] = UINT16_MAX;
+  left[3] = 300; // -84.6°, only the left camera sees there
+  merged = merge_obstacle_sectors(sectors);
+  EXPECT_EQ(merged[72 - 8], 400);
+  EXPECT_EQ(merged[72 - 17], 300);
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+#include "perf_baseline.hpp"
+
+TEST(PerfBaselineTest, Percentiles) {
+  std::vector<double> samples(100);
+  std::iota(samples.begin(), samples.end(), 1.0); // 1 to 100 ms
+  std::swap(samples[3], samples[97]);
+  auto s = summarize_latency(samples);
+  EXPECT_EQ(s.samples, 100u);
+  EXPECT_DOUBLE_EQ(s.p50_ms, 51.0);
+  EXPECT_DOUBLE_EQ(s.p99_ms, 100.0);
+  EXPECT_TRUE(std::isnan(summarize_latency({}).p50_ms));
+}
+
+TEST(PerfBaselineTest, FlagsOnlySignificantRegressions) {
+  PerfReport baseline{ { "obstacles", { 20.0, 30.0, 100 } }, { "binner", { 0.1, 0.2, 100 } } };
+  PerfReport now = baseline;
+  now["obstacles"].p50_ms = 24.0; // Within 25%
+  now["binner"].p50_ms = 0.25; // 150% slower but under the floor
+  EXPECT_FALSE(any_regressed(compare_latency(now, baseline)));
+
+  now["obstacles"].p50_ms = 26.0;
+  auto diffs = compare_latency(now, baseline);
+  EXPECT_TRUE(any_regressed(diffs));
+  auto obstacles = std::find_if(diffs.begin(), diffs.end(), [](const auto& d) { return d.stage == "obstacles"; });
+  EXPECT_TRUE(obstacles->regressed);
+
+  now["obstacles"].p50_ms = 20.0;
+  now["obstacles"].p99_ms = 46.0; // The tail alone
+  EXPECT_TRUE(any_regressed(compare_latency(now, baseline)));
+}
+
+TEST(PerfBaselineTest, NewAndMissingStagesDontFail) {
+  PerfReport baseline{ { "inference", { 30.0, 40.0, 100 } } };
+  PerfReport now{ { "clusters", { 1.0, 2.0, 100 } } };
+  auto diffs = compare_latency(now, baseline);
+  ASSERT_EQ(diffs.size(), 2u);
+  EXPECT_FALSE(any_regressed(diffs));
+  auto table = latency_diff_table(diffs);
+  EXPECT_NE(table.find("clusters"), std::string::npos);
+  EXPECT_NE(table.find("inference"), std::string::npos);
+}
+
+TEST(PerfBaselineTest, ReportRoundTrips) {
+  const std::string path = "/tmp/test_perf_baseline.json";
+  PerfReport report{ { "obstacles", { 20.5, 31.25, 90 } }, { "mavlink", { 0.05, 0.5, 90 } } };
+  ASSERT_TRUE(write_perf_report(path, report, compare_latency(report, report)));
+  auto read = read_perf_report(path);
+  std::remove(path.c_str());
+  ASSERT_TRUE(read.has_value());
+  ASSERT_EQ(read->size(), 2u);
+  EXPECT_DOUBLE_EQ(read->at("obstacles").p50_ms, 20.5);
+  EXPECT_DOUBLE_EQ(read->at("obstacles").p99_ms, 31.25);
+  EXPECT_EQ(read->at("mavlink").samples, 90u);
+  EXPECT_EQ(read_perf_report("/nonexistent/perf.json").error(), PerfErrc::Unreadable);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "pipeline_queue.hpp"
+
+TEST(BoundedQueueTest, DrainsAfterClose) {
+  BoundedQueue<int> q(4);
+  EXPECT_TRUE(q.push(1));
+  EXPECT_TRUE(q.push(2));
+  q.close();
+  EXPECT_FALSE(q.push(3));
+  EXPECT_EQ(q.pop(), 1);
+  EXPECT_EQ(q.pop(), 2);
+  EXPECT_EQ(q.pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, ProducerWaitsWhileFull) {
+  BoundedQueue<int> q(2);
+  std::atomic<int> pushed = 0;
+  std::jthread producer([&] {
+    for (int i = 0; i < 10; i++) {
+      q.push(i);
+      pushed++;
+    }
+    q.close();
+  });
+  while (pushed < 2) std::this_thread::yield();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_LE(pushed, 3);
+  int expected = 0;
+  while (auto i = q.pop()) EXPECT_EQ(*i, expected++);
+  EXPECT_EQ(expected, 10);
+}
+
+TEST(OrderedQueueTest, RestoresOrderAcrossWorkers) {
+  BoundedQueue<size_t> in(8);
+  OrderedQueue<size_t> out(8);
+  const size_t n = 2000;
+  std::vector<std::jthread> workers;
+  for (int w = 0; w < 4; w++) {
+    workers.emplace_back([&, w] {
+      std::mt19937 rng(w);
+      while (auto seq = in.pop()) {
+        if (rng() % 4 == 0) std::this_thread::yield();
+        out.push(*seq, *seq * 3);
+      }
+    });
+  }
+  std::jthread decoder([&] {
+    for (size_t i = 0; i < n; i++) in.push(i);
+    in.close();
+  });
+  for (size_t i = 0; i < n; i++) {
+    auto item = out.pop();
+    ASSERT_TRUE(item.has_value());
+    EXPECT_EQ(*item, i * 3);
+  }
+  decoder.join();
+  for (auto& w : workers) w.join();
+  out.close();
+  EXPECT_EQ(out.pop(), std::nullopt);
+}
+
+TEST(OrderedQueueTest, SkipsGapsOnceClosed) {
+  OrderedQueue<int> q(4);
+  q.push(0, 10);
+  q.push(2, 12);
+  EXPECT_EQ(q.pop(), 10);
+  q.close();
+  EXPECT_EQ(q.pop(), 12);
+  EXPECT_EQ(q.pop(), std::nullopt);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <pcl/ModelCoefficients.h>
+#include <pcl/point_types.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+#include "plane_ransac.hpp"
+
+struct Point {
+  float x, y, z;
+};
+
+// What the depth camera sees: ground 0.5 m below (camera y points down) out
+// to 8 m, boxes standing on it, a wall, stray points and dropouts
+std::vector<Point> scene(int ground, int obstacles, int wall, uint32_t seed = 1) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> across(-3.0f, 3.0f), ahead(0.5f, 8.0f), up(0.0f, 1.2f);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  std::vector<Point> points;
+  for (int i = 0; i < ground; i++) points.push_back({ across(rng), 0.5f + noise(rng), ahead(rng) });
+  for (int i = 0; i < obstacles; i++) {
+    const float x = std::round(across(rng)), z = std::round(ahead(rng));
+    points.push_back({ x + 0.1f * across(rng), 0.5f - up(rng), z + noise(rng) });
+  }
+  for (int i = 0; i < wall; i++) points.push_back({ across(rng), 0.5f - 2.0f * up(rng), 6.0f + noise(rng) });
+  for (int i = 0; i < 50; i++) points.push_back({ NAN, NAN, NAN });
+  std::shuffle(points.begin(), points.end(), rng);
+  return points;
+}
+
+float normal_angle(const Eigen::Vector4f& plane, const Eigen::Vector3f& normal) {
+  return std::acos(std::min(1.0f, std::abs(plane.head<3>().normalized().dot(normal))));
+}
+
+const Eigen::Vector3f UP(0.0f, -1.0f, 0.0f);
+
+TEST(PlaneRansacTest, FindsGroundAmongObstacles) {
+  auto points = scene(30000, 12000, 0);
+  PlaneRansacParams params;
+  params.distance_threshold = 0.05f;
+  auto fit = PlaneRansac(params).fit(points);
+  ASSERT_TRUE(fit.has_value());
+  EXPECT_LT(normal_angle(fit->plane, UP), 0.01f);
+  // Distance of the camera from the ground
+  EXPECT_NEAR(std::abs(fit->plane[3]), 0.5f, 0.01f);
+  EXPECT_GT(fit->inliers, 29000u);
+  EXPECT_NEAR(fit->plane.head<3>().norm(), 1.0f, 1e-5f);
+}
+
+TEST(PlaneRansacTest, StopsOnceConfident) {
+  auto points = scene(20000, 500, 0);
+  PlaneRansacParams params;
+  params.distance_threshold = 0.05f;
+  params.max_iterations = 1000;
+  auto fit = PlaneRansac(params).fit(points);
+  ASSERT_TRUE(fit.has_value());
+  EXPECT_LT(fit->iterations, 50);
+  EXPECT_LT(normal_angle(fit->plane, UP), 0.01f);
+}
+
+TEST(PlaneRansacTest, AxisKeepsWallsOut) {
+  auto points = scene(8000, 0, 20000);
+  PlaneRansacParams params;
+  params.distance_threshold = 0.05f;
+  auto wall = PlaneRansac(params).fit(points);
+  ASSERT_TRUE(wall.has_value());
+  EXPECT_LT(normal_angle(wall->plane, Eigen::Vector3f::UnitZ()), 0.01f);
+
+  params.axis = UP;
+  params.max_tilt = 10.0f * M_PI / 180.0f;
+  auto ground = PlaneRansac(params).fit(points);
+  ASSERT_TRUE(ground.has_value());
+  EXPECT_LT(normal_angle(ground->plane, UP), 0.01f);
+}
+
+TEST(PlaneRansacTest, SameSeedSameAnswer) {
+  auto points = scene(30000, 12000, 5000);
+  PlaneRansacParams params;
+  params.distance_threshold = 0.05f;
+  auto one = PlaneRansac(params).fit(points);
+  auto two = PlaneRansac(params).fit(points);
+  ASSERT_TRUE(one and two);
+  EXPECT_EQ(one->inliers, two->inliers);
+  EXPECT_EQ(one->iterations, two->iterations);
+  EXPECT_TRUE(one->plane.isApprox(two->plane));
+}
+
+TEST(PlaneRansacTest, PoolDoesntChangeTheAnswer) {
+  auto points = scene(30000, 12000, 5000);
+  PlaneRansacParams params;
+  params.distance_threshold = 0.05f;
+  auto serial = PlaneRansac(params).fit(points);
+  asio::thread_pool pool(3);
+  params.threads = 4;
+  params.min_points_per_thread = 1000;
+  auto parallel = PlaneRansac(params, &pool).fit(points);
+  ASSERT_TRUE(serial and parallel);
+  EXPECT_EQ(serial->inliers, parallel->inliers);
+  EXPECT_EQ(serial->iterations, parallel->iterations);
+  EXPECT_TRUE(serial->plane.isApprox(parallel->plane));
+}
+
+TEST(PlaneRansacTest, TooFewPoints) {
+  std::vector<Point> points{ { 0.0f, 0.5f, 1.0f }, { 1.0f, 0.5f, 1.0f }, { NAN, 0.5f, 2.0f } };
+  EXPECT_FALSE(PlaneRansac().fit(points).has_value());
+  points.push_back({ 0.0f, 0.5f, 2.0f });
+  EXPECT_TRUE(PlaneRansac().fit(points).has_value());
+}
+
+// The pipeline used to fit the ground with PCL, it must do at least as well
+TEST(PlaneRansacTest, MatchesPcl) {
+  for (uint32_t seed : { 1, 2, 3 }) {
+    auto points = scene(25000, 15000, 8000, seed);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (const auto& p : points) cloud->points.push_back({ p.x, p.y, p.z });
+    cloud->width = cloud->points.size();
+    cloud->height = 1;
+    cloud->is_dense = false;
+
+    pcl::SACSegmentation<pcl::PointXYZ> seg;
+    pcl::ModelCoefficients coefficients;
+    pcl::PointIndices inliers;
+    seg.setOptimizeCoefficients(true);
+    seg.setModelType(pcl::SACMODEL_PLANE);
+    seg.setMethodType(pcl::SAC_RANSAC);
+    seg.setDistanceThreshold(0.05f);
+    seg.setMaxIterations(50);
+    seg.setInputCloud(cloud);
+    seg.segment(inliers, coefficients);
+    ASSERT_EQ(coefficients.values.size(), 4u);
+
+    PlaneRansacParams params;
+    params.distance_threshold = 0.05f;
+    auto fit = PlaneRansac(params).fit(cloud->points);
+    ASSERT_TRUE(fit.has_value());
+    const Eigen::Vector3f pcl_normal(coefficients.values[0], coefficients.values[1], coefficients.values[2]);
+    EXPECT_LT(normal_angle(fit->plane, pcl_normal.normalized()), 1.0f * M_PI / 180.0f);
+    EXPECT_GE(fit->inliers, inliers.indices.size() * 98 / 100);
+  }
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "planner_config.hpp"
+
+class PlannerConfigTest : public ::testing::Test {
+  protected:
+  std::string m_path = "/tmp/test_planner_config.json";
+  void write(const std::string& json) {
+    std::ofstream(m_path, std::ios::trunc) << json;
+  }
+  void TearDown() override { std::remove(m_path.c_str()); }
+};
+
+TEST_F(PlannerConfigTest, FileOverridesDefaults) {
+  write(R"({
+    "perception": { "detection_threshold": 0.7, "vote_window": 7, "bins": { "count": 36, "reducer": "kth" } },
+    "motion": { "velocity": 0.4 },
+    "pipeline": { "model": "mobilenet", "track_obstacles": true, "intra_op_threads": 2, "parallel_execution": true },
+    "mavlink": { "position_rate_hz": 20 }
+  })");
+  PlannerConfig defaults;
+  defaults.motion.turning_speed = 0.2f; // From the command line
+  auto config = load_planner_config(m_path, defaults);
+  ASSERT_TRUE(config.has_value());
+  EXPECT_FLOAT_EQ(config->perception.detection_threshold, 0.7f);
+  EXPECT_EQ(config->perception.vote_window, 7);
+  EXPECT_EQ(config->perception.bins.bins, 36u);
+  EXPECT_EQ(config->perception.bins.reducer, BinReducer::KTH_MIN);
+  EXPECT_FLOAT_EQ(config->motion.velocity, 0.4f);
+  EXPECT_FLOAT_EQ(config->motion.turning_speed, 0.2f);
+  EXPECT_EQ(config->pipeline.model, "mobilenet");
+  EXPECT_TRUE(config->pipeline.track_obstacles);
+  EXPECT_EQ(config->pipeline.intra_op_threads, 2);
+  EXPECT_EQ(config->pipeline.inter_op_threads, 0);
+  EXPECT_TRUE(config->pipeline.parallel_execution);
+  EXPECT_FLOAT_EQ(config->mavlink.position_rate_hz, 20.0f);
+  EXPECT_EQ(changed_keys(defaults, *config).size(), 10u);
+}
+
+TEST_F(PlannerConfigTest, RejectsBadFiles) {
+  write(R"({ "motion": { "velocity": 0.4 )");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::Unreadable);
+  EXPECT_EQ(load_planner_config("/nonexistent/config.json", {}).error(), ConfigErrc::Unreadable);
+  write(R"({ "motion": { "velocty": 0.4 } })");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::UnknownKey);
+  write(R"({ "perception": { "detection_threshold": 1.5 } })");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::InvalidValue);
+  write(R"({ "perception": { "bins": { "count": 73 } } })");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::InvalidValue);
+  write(R"({ "motion": { "velocity": "fast" } })");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::InvalidValue);
+  write(R"({ "perception": { "bins": { "band_low_deg": 10, "band_high_deg": -10 } } })");
+  EXPECT_EQ(load_planner_config(m_path, {}).error(), ConfigErrc::InvalidValue);
+}
+
+TEST_F(PlannerConfigTest, ReloadsOnHangupKeepingStructuralKnobs) {
+  write(R"({ "motion": { "velocity": 0.4 }, "pipeline": { "model": "yolov8" } })");
+  auto reloader = ConfigReloader::open(m_path, {});
+  ASSERT_TRUE(reloader.has_value());
+  EXPECT_FALSE(reloader->poll());
+
+  write(R"({ "motion": { "velocity": 0.6 }, "pipeline": { "model": "mobilenet", "tick_budget_ms": 150 } })");
+  EXPECT_FALSE(reloader->poll()); // Nothing until SIGHUP
+  raise(SIGHUP);
+  auto config = reloader->poll();
+  ASSERT_TRUE(config.has_value());
+  EXPECT_FLOAT_EQ(config->motion.velocity, 0.6f);
+  EXPECT_EQ(config->pipeline.tick_budget_ms, 150);
+  EXPECT_EQ(config->pipeline.model, "yolov8");
+  EXPECT_FLOAT_EQ(reloader->current().motion.velocity, 0.6f);
+}
+
+TEST_F(PlannerConfigTest, BadReloadChangesNothing) {
+  write(R"({ "motion": { "velocity": 0.4 } })");
+  auto reloader = ConfigReloader::open(m_path, {});
+  ASSERT_TRUE(reloader.has_value());
+  write(R"({ "motion": { "velocity": 0.6, "turning_speed": 3 } })");
+  ConfigReloader::trigger();
+  EXPECT_FALSE(reloader->poll());
+  EXPECT_FLOAT_EQ(reloader->current().motion.velocity, 0.4f);
+  EXPECT_FLOAT_EQ(reloader->current().motion.turning_speed, PlannerConfig{}.motion.turning_speed);
+}
+
+TEST_F(PlannerConfigTest, NoPathMeansDefaults) {
+  PlannerConfig defaults;
+  defaults.motion.velocity = 0.3f;
+  auto reloader = ConfigReloader::open("", defaults);
+  ASSERT_TRUE(reloader.has_value());
+  ConfigReloader::trigger();
+  EXPECT_FALSE(reloader->poll());
+  EXPECT_FLOAT_EQ(reloader->current().motion.velocity, 0.3f);
+}
+
+TEST_F(PlannerConfigTest, FlagsAreCheckedToo) {
+  PlannerConfig defaults;
+  defaults.perception.bins.band_low_deg = 10.0f;
+  defaults.perception.bins.band_high_deg = -10.0f;
+  EXPECT_EQ(ConfigReloader::open("", defaults).error(), ConfigErrc::InvalidValue);
+  defaults = {};
+  defaults.perception.detection_threshold = 1.5f;
+  EXPECT_EQ(ConfigReloader::open("", defaults).error(), ConfigErrc::InvalidValue);
+  defaults = {};
+  defaults.pipeline.inter_op_threads = -1;
+  EXPECT_EQ(ConfigReloader::open("", defaults).error(), ConfigErrc::InvalidValue);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include "range_image_dump.hpp"
+
+class RangeImageDumpTest : public ::testing::Test {
+  protected:
+  std::string m_path = "test_range_image_dump.rimg";
+  void SetUp() override { std::remove(m_path.c_str()); }
+  void TearDown() override { std::remove(m_path.c_str()); }
+
+  static RangeFrame make_frame(uint32_t width, uint32_t height, double timestamp) {
+    RangeFrame frame;
+    frame.header.width = width;
+    frame.header.height = height;
+    frame.header.timestamp_ms = timestamp;
+    frame.header.angular_resolution = M_PI / 180.0f;
+    frame.header.ground_plane[1] = -1.0f;
+    frame.range.resize(width * height);
+    for (uint32_t i = 0; i < width * height; i++) frame.range[i] = i ? float(i) : -INFINITY;
+    frame.bins.assign(72, uint16_t(timestamp));
+    return frame;
+  }
+};
+
+TEST_F(RangeImageDumpTest, ReadsBackWrittenFrames) {
+  {
+    auto dump = RangeImageDump::open(m_path);
+    ASSERT_TRUE(dump.has_value());
+    // Range images change size with the cloud's extent
+    for (uint32_t i = 0; i < 100; i++) {
+      while (not (*dump)->submit(make_frame(88 + i % 3, 58, i))) std::this_thread::yield();
+    }
+  }
+  auto reader = RangeImageReader::open(m_path);
+  ASSERT_TRUE(reader.has_value());
+  ASSERT_EQ(reader->size(), 100);
+  for (uint32_t i = 0; i < 100; i++) {
+    auto frame = (*reader)[i];
+    EXPECT_EQ(frame.header->width, 88 + i % 3);
+    EXPECT_EQ(frame.header->height, 58);
+    EXPECT_EQ(frame.header->timestamp_ms, i);
+    EXPECT_FLOAT_EQ(frame.header->ground_plane[1], -1.0f);
+    EXPECT_TRUE(std::isinf(frame.at(0, 0)));
+    EXPECT_FLOAT_EQ(frame.at(1, 2), float(frame.header->width + 2));
+    ASSERT_EQ(frame.bins.size(), 72);
+    EXPECT_EQ(frame.bins[71], i);
+  }
+}
+
+TEST_F(RangeImageDumpTest, TruncatedRecordEndsIndex) {
+  {
+    auto dump = RangeImageDump::open(m_path);
+    ASSERT_TRUE(dump.has_value());
+    (*dump)->submit(make_frame(10, 10, 1));
+    (*dump)->submit(make_frame(10, 10, 2));
+  }
+  auto size = std::filesystem::file_size(m_path);
+  std::filesystem::resize_file(m_path, size - 16);
+  auto reader = RangeImageReader::open(m_path);
+  ASSERT_TRUE(reader.has_value());
+  EXPECT_EQ(reader->size(), 1);
+}
+
+TEST_F(RangeImageDumpTest, RejectsForeignFiles) {
+  FILE* f = std::fopen(m_path.c_str(), "w");
+  std::fputs("-inf -inf -inf 1.5", f);
+  std::fclose(f);
+  auto reader = RangeImageReader::open(m_path);
+  ASSERT_FALSE(reader.has_value());
+  EXPECT_EQ(reader.error(), DumpErrc::BadHeader);
+}
+
+TEST(RangeDumpSamplerTest, SamplesEveryNthFrameAndBurstsOnTrigger) {
+  RangeDumpSampler sampler(10, 3);
+  int taken = 0;
+  for (int i = 0; i < 100; i++) taken += sampler.sample();
+  EXPECT_EQ(taken, 10);
+  RangeDumpSampler::trigger();
+  EXPECT_TRUE(sampler.sample()); // frame 100, also a sampled frame
+  EXPECT_TRUE(sampler.sample());
+  EXPECT_TRUE(sampler.sample());
+  EXPECT_FALSE(sampler.sample());
+
+  RangeDumpSampler off(0, 2);
+  EXPECT_FALSE(off.sample());
+  RangeDumpSampler::install_trigger();
+  raise(SIGUSR1);
+  EXPECT_TRUE(off.sample());
+  EXPECT_TRUE(off.sample());
+  EXPECT_FALSE(off.sample());
+}
@@ -1,6 +1,8 @@
+#include <array>
 #include <exception>
 #include <gtest/gtest.h>
 #include "realsense_generator.hpp"
+#include <librealsense2/hpp/rs_internal.hpp>
 #include <librealsense2/hpp/rs_pipeline.hpp>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
@@ -72,3 +74,42 @@ TEST(RealsenseGeneratorTest, ReturnNonTrivialPointAndFrame) {
 
   io_ctx.run_for(60s);
 }
+
+// Needs no camera, a software device hands over the frame
+TEST(RealsenseGeneratorTest, DepthViewOfSoftwareFrame) {
+  std::array<uint16_t, 8> pixels{ 0, 1000, 2000, 3000, 4000, 5000, 6000, 7000 };
+  rs2::software_device dev;
+  auto sensor = dev.add_sensor("Depth");
+  rs2_intrinsics intrinsics{ 4, 2, 2.0f, 1.0f, 3.0f, 3.5f, RS2_DISTORTION_NONE, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } };
+  auto profile = sensor.add_video_stream({ RS2_STREAM_DEPTH, 0, 0, 4, 2, 30, 2, RS2_FORMAT_Z16, intrinsics });
+  sensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, 0.001f);
+  rs2::syncer sync;
+  sensor.open(profile);
+  sensor.start(sync);
+
+  rs2_software_video_frame frame{};
+  frame.pixels = pixels.data();
+  frame.deleter = [](void*) {};
+  frame.stride = 4 * sizeof(uint16_t);
+  frame.bpp = 2;
+  frame.timestamp = 42.0;
+  frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+  frame.frame_number = 1;
+  frame.profile = profile.get();
+  sensor.on_video_frame(frame);
+  {
+    rs2::depth_frame depth = sync.wait_for_frames(1000).get_depth_frame();
+    ASSERT_TRUE(depth);
+    auto view = depth_view(depth);
+    EXPECT_EQ(view.width, 4);
+    EXPECT_EQ(view.height, 2);
+    EXPECT_EQ(view.stride, 4);
+    EXPECT_FLOAT_EQ(view.units, 0.001f);
+    EXPECT_FLOAT_EQ(view.intrinsics.fy, 3.5f);
+    EXPECT_DOUBLE_EQ(view.timestamp_ms, 42.0);
+    EXPECT_EQ(view.raw(1, 1), 5000);
+    EXPECT_FLOAT_EQ(view.get_distance(1, 1), depth.get_distance(1, 1));
+  }
+  sensor.stop();
+  sensor.close();
+}
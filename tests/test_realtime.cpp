@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include "realtime.hpp"
+
+TEST(RealtimeTest, ParsesCpuLists) {
+  EXPECT_EQ(parse_cpu_list("2"), std::vector<int>({ 2 }));
+  EXPECT_EQ(parse_cpu_list("2,3"), std::vector<int>({ 2, 3 }));
+  EXPECT_EQ(parse_cpu_list("0-2,6"), std::vector<int>({ 0, 1, 2, 6 }));
+  EXPECT_TRUE(parse_cpu_list("").empty());
+  EXPECT_TRUE(parse_cpu_list("a").empty());
+  EXPECT_TRUE(parse_cpu_list("3-1").empty());
+  EXPECT_TRUE(parse_cpu_list("1,,2").empty());
+}
+
+TEST(RealtimeTest, SamplerCountsFaults) {
+  RusageSampler sampler;
+  const size_t size = 16 << 20;
+  // Fresh anonymous pages fault on first touch
+  auto* block = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  ASSERT_NE(block, MAP_FAILED);
+  for (size_t i = 0; i < size; i += 4096) block[i] = 1;
+  munmap(block, size);
+  auto rates = sampler.sample();
+  EXPECT_GT(rates.minor_faults, 0.0);
+  EXPECT_GE(rates.voluntary_switches, 0.0);
+}
+
+TEST(RealtimeTest, FailsCleanlyWithoutPrivileges) {
+  // Only checks the error surface: CI may or may not allow realtime scheduling
+  RealtimeConfig config;
+  config.cpus = { 0 };
+  config.priority = 1;
+  auto pinned = pin_current_thread(config);
+  if (not pinned) {
+    EXPECT_EQ(pinned.error().category().name(), std::string("Realtime"));
+  } else {
+    sched_param param{};
+    sched_setscheduler(0, SCHED_OTHER, &param);
+  }
+}
+
+TEST(RealtimeTest, SeesSanitizerLinkedIn) {
+  // Linked with -fsanitize=address but not compiled with it, as the planners are
+  ASSERT_TRUE(under_address_sanitizer());
+  auto locked = lock_memory(RealtimeConfig{});
+  ASSERT_FALSE(locked.has_value());
+  EXPECT_EQ(locked.error(), RealtimeErrc::LockFailed);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include "tick_scheduler.hpp"
+
+using namespace std::chrono_literals;
+using clock_type = TickScheduler::clock;
+
+const clock_type::time_point T0{};
+
+TEST(TickSchedulerTest, FullQualityWhenThereIsTime) {
+  TickScheduler s(100ms);
+  int obstacles = s.add_stage("obstacles", 30ms, { 1.0f, 0.5f, 0.25f });
+  int output = s.add_stage("output", 1ms);
+  s.begin_tick(T0);
+  EXPECT_EQ(s.plan(obstacles, T0), 0);
+  s.finish(obstacles, T0 + 30ms);
+  EXPECT_EQ(s.plan(output, T0 + 30ms), 0);
+  s.finish(output, T0 + 31ms);
+  EXPECT_FALSE(s.end_tick(T0 + 31ms));
+  EXPECT_EQ(s.stats(obstacles).at_level[0], 1);
+}
+
+TEST(TickSchedulerTest, DegradesToKeepRoomForLaterStages) {
+  TickScheduler s(100ms);
+  int inference = s.add_stage("inference", 60ms, { 1.0f, 0.1f });
+  int obstacles = s.add_stage("obstacles", 40ms, { 1.0f, 0.5f, 0.25f });
+  int output = s.add_stage("output", 2ms);
+  s.begin_tick(T0);
+  // A slow frame grab leaves 70 ms: full inference would not leave room for
+  // the cheapest obstacle pass and the output
+  auto t = T0 + 30ms;
+  EXPECT_EQ(s.plan(inference, t), 1);
+  s.finish(inference, t += 6ms);
+  // 64 ms left, 2 ms reserved: full obstacles fit
+  EXPECT_EQ(s.plan(obstacles, t), 0);
+  s.finish(obstacles, t += 40ms);
+  EXPECT_EQ(s.plan(output, t), 0);
+  EXPECT_EQ(s.stats(inference).at_level[1], 1);
+}
+
+TEST(TickSchedulerTest, LastResortIsTheCheapestLevel) {
+  TickScheduler s(50ms);
+  int obstacles = s.add_stage("obstacles", 40ms, { 1.0f, 0.5f, 0.25f });
+  s.begin_tick(T0);
+  EXPECT_EQ(s.plan(obstacles, T0 + 45ms), 2);
+  s.finish(obstacles, T0 + 55ms);
+  EXPECT_TRUE(s.end_tick(T0 + 55ms));
+  EXPECT_EQ(s.overruns(), 1);
+}
+
+TEST(TickSchedulerTest, LearnsCostsAndRecovers) {
+  TickScheduler s(100ms, 0.5f);
+  int obstacles = s.add_stage("obstacles", 20ms, { 1.0f, 0.5f, 0.25f });
+  // Each run takes its level's share of the full cost of the current scene
+  auto tick = [&](clock_type::time_point start, std::chrono::milliseconds full_cost) {
+    const std::vector<float> share{ 1.0f, 0.5f, 0.25f };
+    s.begin_tick(start);
+    int level = s.plan(obstacles, start);
+    auto cost = std::chrono::duration_cast<clock_type::duration>(full_cost * share[level]);
+    s.finish(obstacles, start + cost);
+    s.end_tick(start + cost);
+    return level;
+  };
+  auto t = T0;
+  // A cluttered scene makes the full pass take 300 ms
+  for (int i = 0; i < 6; i++, t += 1s) tick(t, 300ms);
+  EXPECT_EQ(tick(t, 300ms), 2);
+  // Once the scene clears the cheap passes are fast and quality comes back
+  int level = 2;
+  for (int i = 0; i < 10; i++, t += 1s) level = tick(t, 20ms);
+  EXPECT_EQ(level, 0);
+  EXPECT_GT(s.stats(obstacles).at_level[2], 0);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "visual_servo.hpp"
+
+using namespace std::chrono_literals;
+
+const VisualServo::clock::time_point T0{};
+
+TEST(VisualServoTest, PixelBearing) {
+  EXPECT_FLOAT_EQ(pixel_bearing(320.0f, 640, 1.2f), 0.0f);
+  EXPECT_NEAR(pixel_bearing(640.0f, 640, 1.2f), 0.6f, 1e-5);
+  EXPECT_NEAR(pixel_bearing(0.0f, 640, 1.2f), -0.6f, 1e-5);
+}
+
+TEST(VisualServoTest, DisengagedUntilSighted) {
+  VisualServo servo;
+  EXPECT_FALSE(servo.update(std::nullopt, T0));
+  EXPECT_FALSE(servo.engaged());
+  auto command = servo.update(VisualServo::Sighting{ 0.0f, 3.0f }, T0);
+  ASSERT_TRUE(command);
+  EXPECT_TRUE(servo.engaged());
+  EXPECT_NEAR(command->forward, ServoParams{}.speed_gain * 2.0f, 1e-5);
+  EXPECT_FLOAT_EQ(command->yaw_rate, 0.0f);
+}
+
+TEST(VisualServoTest, TurnsTowardsTargetWithinRateLimits) {
+  ServoParams p;
+  VisualServo servo(p);
+  servo.update(VisualServo::Sighting{ 0.5f, 5.0f }, T0);
+  float last_rate = 0.0f;
+  for (int i = 1; i <= 30; i++) {
+    auto command = servo.update(VisualServo::Sighting{ 0.5f, 5.0f }, T0 + i * 33ms);
+    ASSERT_TRUE(command);
+    EXPECT_GT(command->yaw_rate, 0.0f);
+    EXPECT_LE(command->yaw_rate - last_rate, p.max_yaw_accel * 0.033f + 1e-4);
+    EXPECT_LE(command->yaw_rate, p.max_yaw_rate);
+    last_rate = command->yaw_rate;
+  }
+  EXPECT_FLOAT_EQ(last_rate, std::min(p.max_yaw_rate, p.yaw_gain * 0.5f));
+}
+
+TEST(VisualServoTest, SlowsForBearingAndStopsAtRange) {
+  ServoParams p;
+  VisualServo servo(p);
+  // Far off axis: turn in place
+  auto command = servo.update(VisualServo::Sighting{ 2.0f * p.slow_bearing, 10.0f }, T0);
+  EXPECT_FLOAT_EQ(command->forward, 0.0f);
+  servo.reset();
+  // Far away: capped; at the stop range: stopped
+  command = servo.update(VisualServo::Sighting{ 0.0f, 50.0f }, T0);
+  EXPECT_FLOAT_EQ(command->forward, p.max_speed);
+  for (int i = 1; i <= 100; i++) command = servo.update(VisualServo::Sighting{ 0.0f, p.stop_range }, T0 + i * 33ms);
+  EXPECT_FLOAT_EQ(command->forward, 0.0f);
+}
+
+TEST(VisualServoTest, CoastsThenFallsBackWhenLost) {
+  ServoParams p;
+  VisualServo servo(p);
+  for (int i = 0; i < 30; i++) servo.update(VisualServo::Sighting{ 0.3f, 4.0f }, T0 + i * 33ms);
+  auto seen_at = T0 + 29 * 33ms;
+  auto coasting = servo.update(std::nullopt, seen_at + 100ms);
+  ASSERT_TRUE(coasting);
+  EXPECT_GT(coasting->forward, 0.0f);
+  EXPECT_LT(coasting->yaw_rate, std::min(p.max_yaw_rate, p.yaw_gain * 0.3f)); // Unwinding the turn
+  EXPECT_TRUE(servo.update(std::nullopt, seen_at + p.lost_timeout - 10ms));
+  EXPECT_FALSE(servo.update(std::nullopt, seen_at + p.lost_timeout + 10ms));
+  EXPECT_FALSE(servo.engaged());
+}